@@ -0,0 +1,683 @@
+#ifndef MRS_UAV_TRACKERS_MOTION_PROFILES_H
+#define MRS_UAV_TRACKERS_MOTION_PROFILES_H
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+namespace mrs_uav_trackers
+{
+
+/* ProfileSample_t //{ */
+
+struct ProfileSample_t
+{
+  double position     = 0;
+  double velocity     = 0;
+  double acceleration = 0;
+  double jerk         = 0;
+};
+
+//}
+
+/* class SCurveProfile //{ */
+
+/**
+ * @brief jerk-limited 1D motion with piecewise-constant jerk
+ *
+ * The profile is parametrized by the time since its start and evaluated in closed
+ * form, so it does not depend on the rate of sampling. The acceleration is continuous,
+ * so it can be passed to the controllers as a feed-forward together with the jerk.
+ */
+class SCurveProfile {
+
+public:
+  /**
+   * @brief standstill at the given position
+   */
+  explicit SCurveProfile(const double position = 0.0) {
+
+    initial_.position = position;
+    final_            = initial_;
+  }
+
+  /**
+   * @brief decelerate from the current velocity and acceleration to a standstill
+   */
+  static SCurveProfile stop(const double position, const double velocity, const double acceleration, const double max_acceleration, const double max_jerk) {
+
+    SCurveProfile profile(position, velocity, acceleration);
+
+    // first, bring the acceleration to zero
+    if (fabs(acceleration) > 0 && max_jerk > 0) {
+      profile.addPhase(fabs(acceleration) / max_jerk, acceleration > 0 ? -max_jerk : max_jerk);
+    }
+
+    profile.final_.acceleration = 0;
+
+    profile.addVelocityChange(-profile.final_.velocity, max_acceleration, max_jerk);
+
+    profile.final_.velocity = 0;
+
+    return profile;
+  }
+
+  /**
+   * @brief time-optimal rest-to-rest motion between two positions
+   */
+  static SCurveProfile restToRest(const double from, const double to, const double speed, const double acceleration, const double jerk) {
+
+    SCurveProfile profile(from);
+
+    const double distance = fabs(to - from);
+
+    if (distance < 1e-6 || speed <= 0 || acceleration <= 0 || jerk <= 0) {
+      profile.final_.position = to;
+      return profile;
+    }
+
+    const double dir = to > from ? 1.0 : -1.0;
+
+    // the peak velocity, limited by the distance if the speed can not be reached
+    double peak_velocity = speed;
+
+    if (distance < speed * accelerationTime(speed, acceleration, jerk)) {
+
+      // first, assume the acceleration limit is reached
+      peak_velocity = acceleration * (-acceleration / jerk + sqrt(pow(acceleration / jerk, 2) + 4.0 * distance / acceleration)) / 2.0;
+
+      if (peak_velocity * jerk < pow(acceleration, 2)) {
+        peak_velocity = pow(distance * sqrt(jerk) / 2.0, 2.0 / 3.0);
+      }
+    }
+
+    profile.addVelocityChange(dir * peak_velocity, acceleration, jerk);
+
+    const double cruise_distance = distance - peak_velocity * accelerationTime(peak_velocity, acceleration, jerk);
+
+    if (cruise_distance > 0) {
+      profile.addPhase(cruise_distance / peak_velocity, 0.0);
+    }
+
+    profile.addVelocityChange(-dir * peak_velocity, acceleration, jerk);
+
+    // remove the numerical residuum
+    profile.final_.position     = to;
+    profile.final_.velocity     = 0;
+    profile.final_.acceleration = 0;
+
+    return profile;
+  }
+
+  /**
+   * @brief reaches the desired velocity from the current velocity and acceleration and keeps it indefinitely
+   */
+  static SCurveProfile toVelocity(const double position, const double velocity, const double acceleration, const double desired_velocity,
+                                  const double max_acceleration, const double max_jerk) {
+
+    SCurveProfile profile(position, velocity, acceleration);
+
+    // first, bring the acceleration to zero
+    if (fabs(acceleration) > 0 && max_jerk > 0) {
+      profile.addPhase(fabs(acceleration) / max_jerk, acceleration > 0 ? -max_jerk : max_jerk);
+    }
+
+    profile.final_.acceleration = 0;
+
+    profile.addVelocityChange(desired_velocity - profile.final_.velocity, max_acceleration, max_jerk);
+
+    profile.final_.velocity = desired_velocity;
+
+    profile.addPhase(std::numeric_limits<double>::infinity(), 0.0);
+
+    return profile;
+  }
+
+  /**
+   * @brief time-optimal motion between two positions, starting and finishing with the given velocities
+   *
+   * The velocities are non-negative speeds in the direction of the motion and they have to be
+   * reachable within the distance, see reachableVelocity().
+   */
+  static SCurveProfile transition(const double from, const double to, const double initial_velocity, const double final_velocity, const double speed,
+                                  const double acceleration, const double jerk) {
+
+    const double distance = fabs(to - from);
+    const double dir      = to >= from ? 1.0 : -1.0;
+
+    SCurveProfile profile(from, dir * initial_velocity, 0.0);
+
+    if (distance < 1e-6 || speed <= 0 || acceleration <= 0 || jerk <= 0) {
+      profile.final_.position = to;
+      profile.final_.velocity = dir * final_velocity;
+      return profile;
+    }
+
+    auto peak_distance = [&](const double peak_velocity) {
+      return transitionDistance(initial_velocity, peak_velocity, acceleration, jerk) + transitionDistance(peak_velocity, final_velocity, acceleration, jerk);
+    };
+
+    // the highest peak velocity which fits within the distance
+    double low  = std::max(initial_velocity, final_velocity);
+    double high = std::max(speed, low);
+
+    if (peak_distance(high) <= distance) {
+      low = high;
+    } else {
+      for (int i = 0; i < BISECTION_ITERATIONS; i++) {
+
+        const double mid = (low + high) / 2.0;
+
+        if (peak_distance(mid) <= distance) {
+          low = mid;
+        } else {
+          high = mid;
+        }
+      }
+    }
+
+    const double peak_velocity = low;
+
+    profile.addVelocityChange(dir * (peak_velocity - initial_velocity), acceleration, jerk);
+
+    const double cruise_distance = distance - peak_distance(peak_velocity);
+
+    if (cruise_distance > 0 && peak_velocity > 0) {
+      profile.addPhase(cruise_distance / peak_velocity, 0.0);
+    }
+
+    profile.addVelocityChange(dir * (final_velocity - peak_velocity), acceleration, jerk);
+
+    // remove the numerical residuum
+    profile.final_.position     = to;
+    profile.final_.velocity     = dir * final_velocity;
+    profile.final_.acceleration = 0;
+
+    return profile;
+  }
+
+  /**
+   * @brief changes the velocity to the desired one, starting and ending with zero acceleration
+   */
+  static SCurveProfile velocityChange(const double position, const double velocity, const double desired_velocity, const double acceleration,
+                                      const double jerk) {
+
+    SCurveProfile profile(position, velocity, 0.0);
+
+    profile.addVelocityChange(desired_velocity - velocity, acceleration, jerk);
+
+    profile.final_.velocity = desired_velocity;
+
+    return profile;
+  }
+
+  /**
+   * @brief moves with a constant velocity for the given time [s]
+   */
+  static SCurveProfile cruise(const double position, const double velocity, const double duration) {
+
+    SCurveProfile profile(position, velocity, 0.0);
+
+    profile.addPhase(duration, 0.0);
+
+    return profile;
+  }
+
+  /**
+   * @brief reaches the position from a standstill with the final speed and keeps moving with it indefinitely
+   */
+  static SCurveProfile approach(const double from, const double to, const double final_velocity, const double speed, const double acceleration,
+                                const double jerk) {
+
+    SCurveProfile profile = transition(from, to, 0.0, final_velocity, speed, acceleration, jerk);
+
+    profile.addPhase(std::numeric_limits<double>::infinity(), 0.0);
+
+    return profile;
+  }
+
+  /**
+   * @brief the distance travelled while changing the velocity from zero acceleration to zero acceleration
+   */
+  static double transitionDistance(const double initial_velocity, const double final_velocity, const double acceleration, const double jerk) {
+
+    // the acceleration profile is symmetric, so the mean velocity lies in the middle
+    return fabs((initial_velocity + final_velocity) / 2.0 * accelerationTime(final_velocity - initial_velocity, acceleration, jerk));
+  }
+
+  /**
+   * @brief the highest velocity (up to the speed) reachable from the initial velocity within the distance
+   *
+   * The change is symmetric, so it also gives the highest initial velocity from which the final one is reachable.
+   */
+  static double reachableVelocity(const double initial_velocity, const double distance, const double speed, const double acceleration, const double jerk) {
+
+    if (speed <= initial_velocity) {
+      return speed;
+    }
+
+    if (transitionDistance(initial_velocity, speed, acceleration, jerk) <= distance) {
+      return speed;
+    }
+
+    double low  = initial_velocity;
+    double high = speed;
+
+    for (int i = 0; i < BISECTION_ITERATIONS; i++) {
+
+      const double mid = (low + high) / 2.0;
+
+      if (transitionDistance(initial_velocity, mid, acceleration, jerk) <= distance) {
+        low = mid;
+      } else {
+        high = mid;
+      }
+    }
+
+    return low;
+  }
+
+  /**
+   * @brief the time [s] needed to reach the velocity change from zero acceleration to zero acceleration
+   */
+  static double accelerationTime(const double velocity_change, const double acceleration, const double jerk) {
+
+    const double dv = fabs(velocity_change);
+
+    if (dv * jerk >= pow(acceleration, 2)) {
+      return acceleration / jerk + dv / acceleration;
+    } else {
+      return 2.0 * sqrt(dv / jerk);
+    }
+  }
+
+  /**
+   * @brief evaluates the profile at the time [s] since its start
+   */
+  ProfileSample_t sample(const double t) const {
+
+    if (t <= 0 || n_phases_ == 0) {
+      return t <= 0 ? initial_ : final_;
+    }
+
+    for (int i = 0; i < n_phases_; i++) {
+
+      const Phase_t& phase = phases_[i];
+
+      if (t < phase.start + phase.duration) {
+        return integrate(phase.initial, t - phase.start);
+      }
+    }
+
+    return final_;
+  }
+
+  /**
+   * @brief shifts the whole profile in space, e.g., after an odometry switch
+   */
+  void translate(const double offset) {
+
+    initial_.position += offset;
+    final_.position += offset;
+
+    for (int i = 0; i < n_phases_; i++) {
+      phases_[i].initial.position += offset;
+    }
+  }
+
+  double duration(void) const {
+    return duration_;
+  }
+
+  const ProfileSample_t& finalState(void) const {
+    return final_;
+  }
+
+private:
+  struct Phase_t
+  {
+    double          start    = 0;
+    double          duration = 0;
+    ProfileSample_t initial;
+  };
+
+  // zeroing the acceleration + velocity change + cruise + velocity change
+  static const int MAX_PHASES = 8;
+
+  static const int BISECTION_ITERATIONS = 50;
+
+  std::array<Phase_t, MAX_PHASES> phases_;
+  int                             n_phases_ = 0;
+
+  ProfileSample_t initial_;
+  ProfileSample_t final_;
+  double          duration_ = 0;
+
+  SCurveProfile(const double position, const double velocity, const double acceleration) {
+
+    initial_.position     = position;
+    initial_.velocity     = velocity;
+    initial_.acceleration = acceleration;
+    final_                = initial_;
+  }
+
+  static ProfileSample_t integrate(const ProfileSample_t& initial, const double t) {
+
+    ProfileSample_t sample;
+
+    sample.position     = initial.position + initial.velocity * t + initial.acceleration * t * t / 2.0 + initial.jerk * t * t * t / 6.0;
+    sample.velocity     = initial.velocity + initial.acceleration * t + initial.jerk * t * t / 2.0;
+    sample.acceleration = initial.acceleration + initial.jerk * t;
+    sample.jerk         = initial.jerk;
+
+    return sample;
+  }
+
+  // changes the velocity by the given amount, starting and ending with zero acceleration
+  void addVelocityChange(const double velocity_change, const double acceleration, const double jerk) {
+
+    const double dv = fabs(velocity_change);
+
+    if (dv < 1e-9 || acceleration <= 0 || jerk <= 0) {
+      return;
+    }
+
+    const double dir = velocity_change > 0 ? 1.0 : -1.0;
+
+    if (dv * jerk >= pow(acceleration, 2)) {
+
+      addPhase(acceleration / jerk, dir * jerk);
+      addPhase(dv / acceleration - acceleration / jerk, 0.0);
+      addPhase(acceleration / jerk, -dir * jerk);
+
+    } else {
+
+      const double t_jerk = sqrt(dv / jerk);
+
+      addPhase(t_jerk, dir * jerk);
+      addPhase(t_jerk, -dir * jerk);
+    }
+
+    final_.acceleration = 0;
+  }
+
+  void addPhase(const double duration, const double jerk) {
+
+    if (n_phases_ >= MAX_PHASES || !(duration > 0)) {
+      return;
+    }
+
+    Phase_t& phase = phases_[n_phases_++];
+
+    phase.start        = duration_;
+    phase.duration     = duration;
+    phase.initial      = final_;
+    phase.initial.jerk = jerk;
+
+    duration_ += duration;
+
+    if (std::isfinite(duration)) {
+      final_ = integrate(phase.initial, duration);
+    }
+
+    final_.jerk = 0;
+  }
+};
+
+//}
+
+/* class HeadingProfile //{ */
+
+/**
+ * @brief closed-form solution of the rate-saturated proportional heading law
+ *
+ * Equivalent to integrating heading_rate = sat(gain * (goal - heading), max_rate),
+ * which the trackers used to do on a fixed-rate timer.
+ */
+class HeadingProfile {
+
+public:
+  explicit HeadingProfile(const double heading = 0.0) : from_(heading), goal_(heading) {
+  }
+
+  HeadingProfile(const double from, const double to, const double gain, const double max_rate) : from_(from), goal_(to), gain_(gain), max_rate_(max_rate) {
+
+    const double error = fabs(goal_ - from_);
+
+    if (error < SETTLED_ERROR || gain_ <= 0 || max_rate_ <= 0) {
+      from_ = goal_;
+      return;
+    }
+
+    // the rate is saturated while the error is above this value
+    const double saturation_error = max_rate_ / gain_;
+
+    t_saturated_ = error > saturation_error ? (error - saturation_error) / max_rate_ : 0.0;
+    error_exp_   = std::min(error, saturation_error);
+    duration_    = t_saturated_ + (error_exp_ > SETTLED_ERROR ? log(error_exp_ / SETTLED_ERROR) / gain_ : 0.0);
+  }
+
+  /**
+   * @brief evaluates the heading and heading rate at the time [s] since the start
+   */
+  void sample(const double t, double& heading, double& heading_rate) const {
+
+    if (t >= duration_) {
+      heading      = goal_;
+      heading_rate = 0;
+      return;
+    }
+
+    const double dir = goal_ > from_ ? 1.0 : -1.0;
+
+    if (t <= 0) {
+      heading      = from_;
+      heading_rate = 0;
+      return;
+    }
+
+    double error;
+
+    if (t < t_saturated_) {
+      error        = fabs(goal_ - from_) - max_rate_ * t;
+      heading_rate = dir * max_rate_;
+    } else {
+      error        = error_exp_ * exp(-gain_ * (t - t_saturated_));
+      heading_rate = dir * gain_ * error;
+    }
+
+    heading = goal_ - dir * error;
+  }
+
+  void translate(const double offset) {
+
+    from_ += offset;
+    goal_ += offset;
+  }
+
+  double duration(void) const {
+    return duration_;
+  }
+
+  double goal(void) const {
+    return goal_;
+  }
+
+private:
+  static constexpr double SETTLED_ERROR = 1e-3;
+
+  double from_;
+  double goal_;
+  double gain_        = 0;
+  double max_rate_    = 0;
+  double t_saturated_ = 0;
+  double error_exp_   = 0;
+  double duration_    = 0;
+};
+
+//}
+
+/* class CubicSpline //{ */
+
+/**
+ * @brief natural or periodic (C2) cubic spline through uniformly spaced knots
+ *
+ * The second derivatives at the knots are solved for once in the constructor,
+ * the evaluation is then a constant-time lookup of the segment. Out of the knot
+ * span, the end points of the natural spline are held, the periodic one repeats.
+ */
+class CubicSpline {
+
+public:
+  /**
+   * @param periodic the last knot continues to the first one after dt, the spline repeats with the period of (number of knots) * dt
+   */
+  CubicSpline(const std::vector<double>& knots, const double dt, const bool periodic = false)
+      : knots_(knots), second_derivatives_(knots.size(), 0.0), dt_(dt), periodic_(periodic) {
+
+    const int n = int(knots_.size());
+
+    if (n < 3 || dt_ <= 0) {
+      return;
+    }
+
+    // the tridiagonal system "M_{i-1} + 4 M_i + M_{i+1} = 6 / dt^2 (y_{i+1} - 2 y_i + y_{i-1})",
+    // with M_0 = M_{n-1} = 0 for the natural spline, cyclic for the periodic one
+    auto rhs = [&](const int i) { return 6.0 * (knots_[(i + 1) % n] - 2.0 * knots_[i] + knots_[(i + n - 1) % n]) / (dt_ * dt_); };
+
+    if (!periodic_) {
+
+      std::vector<double> r(n - 2);
+
+      for (int i = 1; i < n - 1; i++) {
+        r[i - 1] = rhs(i);
+      }
+
+      const std::vector<double> m = solveTridiagonal(std::vector<double>(n - 2, 4.0), r);
+
+      std::copy(m.begin(), m.end(), second_derivatives_.begin() + 1);
+
+      return;
+    }
+
+    // the cyclic system is solved by the Sherman-Morrison formula, as a tridiagonal one corrected by a rank-one update
+    const double gamma = -4.0;
+
+    std::vector<double> diagonal(n, 4.0);
+    std::vector<double> r(n);
+    std::vector<double> u(n, 0.0);
+
+    diagonal[0] -= gamma;
+    diagonal[n - 1] -= 1.0 / gamma;
+
+    for (int i = 0; i < n; i++) {
+      r[i] = rhs(i);
+    }
+
+    u[0]     = gamma;
+    u[n - 1] = 1.0;
+
+    const std::vector<double> x = solveTridiagonal(diagonal, r);
+    const std::vector<double> z = solveTridiagonal(diagonal, u);
+
+    const double factor = (x[0] + x[n - 1] / gamma) / (1.0 + z[0] + z[n - 1] / gamma);
+
+    for (int i = 0; i < n; i++) {
+      second_derivatives_[i] = x[i] - factor * z[i];
+    }
+  }
+
+  /**
+   * @brief evaluates the spline at the time [s] since the first knot
+   */
+  ProfileSample_t sample(const double t) const {
+
+    ProfileSample_t sample;
+
+    const int n = int(knots_.size());
+
+    if (n == 0) {
+      return sample;
+    }
+
+    if (n == 1 || (!periodic_ && t < 0)) {
+      sample.position = knots_.front();
+      return sample;
+    }
+
+    if (!periodic_ && t > duration()) {
+      sample.position = knots_.back();
+      return sample;
+    }
+
+    const double local_t = periodic_ ? t - floor(t / duration()) * duration() : t;
+
+    const int    i = std::min(int(local_t / dt_), periodic_ ? n - 1 : n - 2);
+    const int    j = (i + 1) % n;
+    const double s = local_t - i * dt_;
+
+    const double m0 = second_derivatives_[i];
+    const double m1 = second_derivatives_[j];
+
+    const double b = (knots_[j] - knots_[i]) / dt_ - dt_ * (2.0 * m0 + m1) / 6.0;
+    const double c = m0 / 2.0;
+    const double d = (m1 - m0) / (6.0 * dt_);
+
+    sample.position     = knots_[i] + s * (b + s * (c + s * d));
+    sample.velocity     = b + s * (2.0 * c + 3.0 * d * s);
+    sample.acceleration = 2.0 * c + 6.0 * d * s;
+    sample.jerk         = 6.0 * d;
+
+    return sample;
+  }
+
+  /**
+   * @brief the time span of the knots, the period of the periodic spline
+   */
+  double duration(void) const {
+
+    if (knots_.empty()) {
+      return 0.0;
+    }
+
+    return (periodic_ ? knots_.size() : knots_.size() - 1) * dt_;
+  }
+
+private:
+  std::vector<double> knots_;
+  std::vector<double> second_derivatives_;
+  double              dt_;
+  bool                periodic_;
+
+  // the Thomas algorithm for a tridiagonal system with unit off-diagonals
+  static std::vector<double> solveTridiagonal(const std::vector<double>& diagonal, const std::vector<double>& rhs) {
+
+    const int n = int(diagonal.size());
+
+    std::vector<double> c_prime(n, 0.0);
+    std::vector<double> d_prime(n, 0.0);
+    std::vector<double> x(n, 0.0);
+
+    for (int i = 0; i < n; i++) {
+
+      const double denom = diagonal[i] - (i > 0 ? c_prime[i - 1] : 0.0);
+
+      c_prime[i] = 1.0 / denom;
+      d_prime[i] = (rhs[i] - (i > 0 ? d_prime[i - 1] : 0.0)) / denom;
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+      x[i] = d_prime[i] - (i < n - 1 ? c_prime[i] * x[i + 1] : 0.0);
+    }
+
+    return x;
+  }
+};
+
+//}
+
+}  // namespace mrs_uav_trackers
+
+#endif
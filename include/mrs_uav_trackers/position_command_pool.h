@@ -0,0 +1,44 @@
+#ifndef MRS_UAV_TRACKERS_POSITION_COMMAND_POOL_H
+#define MRS_UAV_TRACKERS_POSITION_COMMAND_POOL_H
+
+#include <memory>
+
+#include <mrs_msgs/PositionCommand.h>
+
+namespace mrs_uav_trackers
+{
+
+/* class PositionCommandPool //{ */
+
+/**
+ * @brief reusable PositionCommand instances for the output of the trackers
+ *
+ * The commands are allocated once and handed out as boost::shared_ptr with a custom deleter,
+ * which returns them to the pool when the last reference is dropped. The shared_ptr control
+ * blocks come from the pool as well, so a command costs no heap allocation once the pool
+ * is warmed up. The pool grows when all its commands are in use. The commands may outlive
+ * the pool object.
+ */
+class PositionCommandPool {
+public:
+  /**
+   * @param size the number of the preallocated commands
+   */
+  explicit PositionCommandPool(const size_t size = 8);
+
+  /**
+   * @brief returns a default-initialized command to be filled in place
+   */
+  mrs_msgs::PositionCommand::Ptr acquire(void);
+
+  struct Storage_t;
+
+private:
+  std::shared_ptr<Storage_t> storage_;
+};
+
+//}
+
+}  // namespace mrs_uav_trackers
+
+#endif  // MRS_UAV_TRACKERS_POSITION_COMMAND_POOL_H
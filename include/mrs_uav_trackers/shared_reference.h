@@ -0,0 +1,187 @@
+#ifndef MRS_UAV_TRACKERS_SHARED_REFERENCE_H
+#define MRS_UAV_TRACKERS_SHARED_REFERENCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mrs_uav_trackers
+{
+
+/* SharedReference_t //{ */
+
+/**
+ * @brief a single reference sample passed through the shared memory
+ *
+ * The stamp is in nanoseconds of the ROS clock used by the tracker, the positions
+ * are in the frame of the currently used odometry.
+ */
+struct SharedReference_t
+{
+  uint64_t stamp;
+
+  double position[3];
+  double velocity[3];
+  double acceleration[3];
+
+  double heading;
+  double heading_rate;
+
+  // x, y, z, w
+  double orientation[4];
+};
+
+//}
+
+/* class SharedReferenceBuffer //{ */
+
+/**
+ * @brief lock-free single-producer/single-consumer ring buffer of references, placed in a shared memory segment
+ *
+ * The producer (an external reference generator running on the same machine) writes the samples
+ * with push(), the consumer (the tracker) reads the newest one with latest(). Each slot is guarded
+ * by a sequence counter, so a sample being overwritten while it is read is detected and retried
+ * instead of returned torn. Neither side ever blocks.
+ */
+class SharedReferenceBuffer {
+public:
+  static constexpr uint64_t MAGIC    = 0x4d52535245463031;  // "MRSREF01"
+  static constexpr uint32_t CAPACITY = 16;
+
+  // unmaps the segment when the owning pointer is destroyed
+  struct Unmap_t
+  {
+    void operator()(SharedReferenceBuffer* buffer) const {
+      munmap(buffer, sizeof(SharedReferenceBuffer));
+    }
+  };
+
+  using Ptr = std::unique_ptr<SharedReferenceBuffer, Unmap_t>;
+
+  /**
+   * @brief maps the segment, creates and initializes it when it does not exist yet
+   *
+   * The segment is created accessible only by its owner, the producer has to run under the same user.
+   *
+   * @param name of the POSIX shared memory object, e.g., "/uav1_matlab_tracker"
+   *
+   * @return the mapped buffer, unmapped when the pointer is destroyed, nullptr on failure
+   */
+  static Ptr open(const std::string& name) {
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+
+    if (fd < 0) {
+      return nullptr;
+    }
+
+    if (ftruncate(fd, sizeof(SharedReferenceBuffer)) != 0) {
+      ::close(fd);
+      return nullptr;
+    }
+
+    void* ptr = mmap(nullptr, sizeof(SharedReferenceBuffer), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (ptr == MAP_FAILED) {
+      return nullptr;
+    }
+
+    Ptr buffer(static_cast<SharedReferenceBuffer*>(ptr));
+
+    // a freshly created segment is zeroed
+    uint64_t expected = 0;
+
+    if (buffer->magic_.compare_exchange_strong(expected, MAGIC)) {
+      buffer->head_.store(0, std::memory_order_release);
+    } else if (expected != MAGIC) {
+      return nullptr;
+    }
+
+    return buffer;
+  }
+
+  /**
+   * @brief writes a new sample, only a single producer may call this
+   */
+  void push(const SharedReference_t& reference) {
+
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot_t&  slot = slots_[head % CAPACITY];
+
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+
+    // odd sequence marks a slot being written
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(&slot.reference, &reference, sizeof(SharedReference_t));
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief reads the newest sample
+   *
+   * @return false if nothing was written yet or the producer kept overwriting the slot
+   */
+  bool latest(SharedReference_t& reference) const {
+
+    for (int attempt = 0; attempt < 3; attempt++) {
+
+      uint64_t head = head_.load(std::memory_order_acquire);
+
+      if (head == 0) {
+        return false;
+      }
+
+      const Slot_t& slot = slots_[(head - 1) % CAPACITY];
+
+      uint64_t seq_before = slot.seq.load(std::memory_order_acquire);
+
+      if (seq_before % 2 == 1) {
+        continue;
+      }
+
+      std::memcpy(&reference, &slot.reference, sizeof(SharedReference_t));
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (slot.seq.load(std::memory_order_relaxed) == seq_before) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  SharedReferenceBuffer() = delete;
+
+  struct Slot_t
+  {
+    std::atomic<uint64_t> seq;
+    SharedReference_t     reference;
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared memory buffer requires lock-free 64 bit atomics");
+
+  std::atomic<uint64_t> magic_;
+  std::atomic<uint64_t> head_;
+  Slot_t                slots_[CAPACITY];
+};
+
+//}
+
+}  // namespace mrs_uav_trackers
+
+#endif  // MRS_UAV_TRACKERS_SHARED_REFERENCE_H
@@ -0,0 +1,170 @@
+#include <mrs_uav_trackers/position_command_pool.h>
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace mrs_uav_trackers
+{
+
+// the shared_ptr control blocks (holding the deleter and the allocator) fit in here
+#define CONTROL_BLOCK_SIZE 128
+
+/* Storage_t //{ */
+
+struct PositionCommandPool::Storage_t
+{
+  std::mutex mutex;
+
+  // owns all the commands and all the control blocks
+  std::vector<std::unique_ptr<mrs_msgs::PositionCommand>> commands;
+  std::vector<std::unique_ptr<std::max_align_t[]>>        blocks;
+
+  std::vector<mrs_msgs::PositionCommand *> free_commands;
+  std::vector<void *>                      free_blocks;
+
+  mrs_msgs::PositionCommand *getCommand(void) {
+
+    std::scoped_lock lock(mutex);
+
+    if (free_commands.empty()) {
+      commands.emplace_back(new mrs_msgs::PositionCommand());
+      return commands.back().get();
+    }
+
+    mrs_msgs::PositionCommand *command = free_commands.back();
+    free_commands.pop_back();
+
+    return command;
+  }
+
+  void returnCommand(mrs_msgs::PositionCommand *command) {
+
+    std::scoped_lock lock(mutex);
+
+    free_commands.push_back(command);
+  }
+
+  void *getBlock(const size_t size) {
+
+    if (size > CONTROL_BLOCK_SIZE) {
+      return ::operator new(size);
+    }
+
+    std::scoped_lock lock(mutex);
+
+    if (free_blocks.empty()) {
+      blocks.emplace_back(new std::max_align_t[CONTROL_BLOCK_SIZE / sizeof(std::max_align_t) + 1]);
+      return blocks.back().get();
+    }
+
+    void *block = free_blocks.back();
+    free_blocks.pop_back();
+
+    return block;
+  }
+
+  void returnBlock(void *block, const size_t size) {
+
+    if (size > CONTROL_BLOCK_SIZE) {
+      ::operator delete(block);
+      return;
+    }
+
+    std::scoped_lock lock(mutex);
+
+    free_blocks.push_back(block);
+  }
+};
+
+//}
+
+/* Deleter, BlockAllocator //{ */
+
+namespace
+{
+
+struct Deleter
+{
+  std::shared_ptr<PositionCommandPool::Storage_t> storage;
+
+  void operator()(mrs_msgs::PositionCommand *command) {
+    storage->returnCommand(command);
+  }
+};
+
+template <class T>
+struct BlockAllocator
+{
+  using value_type = T;
+
+  std::shared_ptr<PositionCommandPool::Storage_t> storage;
+
+  explicit BlockAllocator(const std::shared_ptr<PositionCommandPool::Storage_t> &storage) : storage(storage) {
+  }
+
+  template <class U>
+  BlockAllocator(const BlockAllocator<U> &other) : storage(other.storage) {
+  }
+
+  T *allocate(const size_t n) {
+    return static_cast<T *>(storage->getBlock(n * sizeof(T)));
+  }
+
+  void deallocate(T *block, const size_t n) {
+    storage->returnBlock(block, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const BlockAllocator<U> &other) const {
+    return storage == other.storage;
+  }
+
+  template <class U>
+  bool operator!=(const BlockAllocator<U> &other) const {
+    return storage != other.storage;
+  }
+};
+
+}  // namespace
+
+//}
+
+/* PositionCommandPool() //{ */
+
+PositionCommandPool::PositionCommandPool(const size_t size) : storage_(std::make_shared<Storage_t>()) {
+
+  storage_->commands.reserve(size);
+  storage_->free_commands.reserve(size);
+  storage_->blocks.reserve(size);
+  storage_->free_blocks.reserve(size);
+
+  for (size_t i = 0; i < size; i++) {
+
+    storage_->commands.emplace_back(new mrs_msgs::PositionCommand());
+    storage_->free_commands.push_back(storage_->commands.back().get());
+
+    storage_->blocks.emplace_back(new std::max_align_t[CONTROL_BLOCK_SIZE / sizeof(std::max_align_t) + 1]);
+    storage_->free_blocks.push_back(storage_->blocks.back().get());
+  }
+}
+
+//}
+
+/* acquire() //{ */
+
+mrs_msgs::PositionCommand::Ptr PositionCommandPool::acquire(void) {
+
+  static const mrs_msgs::PositionCommand empty;
+
+  mrs_msgs::PositionCommand::Ptr command(storage_->getCommand(), Deleter{storage_}, BlockAllocator<char>(storage_));
+
+  // clear the values of its previous use, assigning into the reused instance keeps the capacity of its strings
+  *command = empty;
+
+  return command;
+}
+
+//}
+
+}  // namespace mrs_uav_trackers
@@ -7,8 +7,13 @@
 
 #include <ros/ros.h>
 
+#include <fstream>
+#include <iomanip>
+
 #include <mrs_uav_managers/tracker.h>
 
+#include <mrs_uav_trackers/position_command_pool.h>
+
 #include <mrs_lib/param_loader.h>
 #include <mrs_lib/profiler.h>
 #include <mrs_lib/mutex.h>
@@ -125,35 +130,92 @@ private:
   double _activation_max_acceleration_;
   double _activation_max_heading_rate_;
 
-  double z_acceleration_acc_;
-  /* double z_pos_lost_by_flipping_; */
-  double z_vel_gained_by_flipping_;
-  double z_acceleration_duration_;
-
   double _recovery_duration_;
 
-  double _innertia_timeout_factor_;
-  double _innertia_timeout_;
-
   double _pulse_timeout_factor_;
-  double _pulse_timeout_;
+  double _innertia_timeout_factor_;
 
   // | ------------------------ flipping ------------------------ |
 
   mrs_msgs::PositionCommand activation_cmd_;
-  ros::Time                 state_change_time_;
 
-  States_t   current_state_ = STATE_IDLE;
-  std::mutex mutex_current_state_;
+  States_t current_state_ = STATE_IDLE;
 
   double initial_heading_;
 
-  ros::Time inertia_time_started_;
+  // the whole maneuver, precomputed when the flip is requested, the references are evaluated
+  // at the time since the start of the phase, the phases are switched by the measured state
+  struct FlipPlan_t
+  {
+    double z_acceleration;
+    double z_velocity;  // gained by the end of the acceleration phase
+    double z_jerk;      // during the initial rampup of the acceleration
+
+    double rampup_end;
+    double acceleration_end;
+
+    // the expected durations of the phases
+    double pulse_duration;
+    double inertia_duration;
+
+    // the phases are aborted to the recovery after these [s]
+    double acceleration_timeout;
+    double pulse_timeout;
+    double inertia_timeout;
+
+    vec3_t attitude_rate;  // during the pulse
+    double hover_thrust;
+  };
+
+  FlipPlan_t plan_;
+  ros::Time  flip_start_time_;
+  ros::Time  phase_start_time_;
+  std::mutex mutex_current_state_;  // guards the plan as well
+
+  FlipPlan_t planFlip(const mrs_uav_trackers::flip_trackerConfig &drs_params, const double z_acceleration);
+  States_t   nextPhase(const FlipPlan_t &plan, const States_t phase, const double phase_time, const double tilt_angle, const double z_velocity);
+
+  // | ------------------------ telemetry ----------------------- |
+
+  // one record per update() during the flip
+  struct TelemetrySample_t
+  {
+    double  time;  // since the start of the flip
+    int32_t state;
+    double  tilt_angle;
+    double  attitude_rate[3];  // commanded
+    double  thrust;            // commanded
+    double  velocity[3];
+    double  angular_velocity[3];
+    double  height;
+  };
+
+  bool        _telemetry_enabled_;
+  int         _telemetry_capacity_;
+  std::string _telemetry_directory_;
+
+  // preallocated ring filled in update(), keeps the latest samples when full,
+  // it is swapped with the dump buffer when the flip ends
+  std::vector<TelemetrySample_t> telemetry_;
+  size_t                         telemetry_count_ = 0;  // samples recorded during the flip, including the overwritten ones
+  ros::Time                      telemetry_flip_start_;
+  std::vector<TelemetrySample_t> telemetry_dump_;
+  size_t                         telemetry_dump_count_ = 0;
+  ros::Time                      telemetry_dump_stamp_;
+  bool                           telemetry_dump_pending_ = false;
+  std::mutex                     mutex_telemetry_dump_;
+
+  ros::Timer timer_telemetry_;
+  void       timerTelemetry(const ros::TimerEvent &event);
 
   // | ------------------------ routines ------------------------ |
 
   bool checkState(void);
 
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
+
   // | ------------------------ profiler ------------------------ |
 
   mrs_lib::Profiler profiler_;
@@ -173,12 +235,6 @@ private:
   // | ------------------------- rampup ------------------------- |
 
   double _rampup_speed_;
-
-  bool      rampup_active_ = false;
-  double    rampup_acc_;
-  double    rampup_duration_;
-  ros::Time rampup_start_time_;
-  ros::Time rampup_last_time_;
 };
 
 //}
@@ -215,16 +271,21 @@ void FlipTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
   param_loader.loadParam("phases/flipping_pulse/axis", drs_params_.axis);
   param_loader.loadParam("phases/flipping_pulse/direction", drs_params_.direction);
   param_loader.loadParam("phases/flipping_pulse/timeout_factor", _pulse_timeout_factor_);
+  param_loader.loadParam("phases/innertia/timeout_factor", _innertia_timeout_factor_);
 
   param_loader.loadParam("rampup/speed", _rampup_speed_);
 
   param_loader.loadParam("phases/recovery/duration", _recovery_duration_);
-  param_loader.loadParam("phases/innertia/timeout_factor", _innertia_timeout_factor_);
 
-  _pulse_timeout_ = _pulse_timeout_factor_ * (FLIPPING_PULSE_STOP_TILT / drs_params_.attitude_rate);
-  ROS_INFO("[FlipTracker]: initializing pulse timeout: %.4f s", _pulse_timeout_);
-  _innertia_timeout_ = _innertia_timeout_factor_ * (((M_PI - FLIPPING_PULSE_STOP_TILT) + (M_PI - INNERTIA_PULSE_STOP_TILT)) / drs_params_.attitude_rate);
-  ROS_INFO("[FlipTracker]: initializing inertia timeout: %.4f s", _innertia_timeout_);
+  param_loader.loadParam("telemetry/enabled", _telemetry_enabled_);
+  param_loader.loadParam("telemetry/capacity", _telemetry_capacity_);
+  param_loader.loadParam("telemetry/directory", _telemetry_directory_);
+
+  if (_telemetry_enabled_ && _telemetry_capacity_ <= 0) {
+    ROS_ERROR("[FlipTracker]: the telemetry capacity has to be positive, got %d", _telemetry_capacity_);
+    ros::shutdown();
+    return;
+  }
 
   if (_version_ != VERSION) {
 
@@ -250,6 +311,16 @@ void FlipTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
 
   service_server_flip_ = nh_.advertiseService("flip_in", &FlipTracker::callbackFlip, this);
 
+  // | ------------------------ telemetry ----------------------- |
+
+  if (_telemetry_enabled_) {
+
+    telemetry_.resize(_telemetry_capacity_);
+    telemetry_dump_.resize(_telemetry_capacity_);
+
+    timer_telemetry_ = nh_.createTimer(ros::Rate(1.0), &FlipTracker::timerTelemetry, this);
+  }
+
   // | ------------------------ profiler ------------------------ |
 
   profiler_ = mrs_lib::Profiler(nh_, "FlipTracker", _profiler_enabled_);
@@ -344,8 +415,8 @@ bool FlipTracker::resetStatic(void) {
 const mrs_msgs::PositionCommand::ConstPtr FlipTracker::update(const mrs_msgs::UavState::ConstPtr &                        uav_state,
                                                               [[maybe_unused]] const mrs_msgs::AttitudeCommand::ConstPtr &last_attitude_cmd) {
 
-  auto current_state = mrs_lib::get_mutexed(mutex_current_state_, current_state_);
-  auto drs_params    = mrs_lib::get_mutexed(mutex_drs_params_, drs_params_);
+  auto [current_state, plan, flip_start_time, phase_start_time] =
+      mrs_lib::get_mutexed(mutex_current_state_, current_state_, plan_, flip_start_time_, phase_start_time_);
 
   mrs_lib::Routine    profiler_routine = profiler_.createRoutine("update");
   mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("FlipTracker::update", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
@@ -363,9 +434,17 @@ const mrs_msgs::PositionCommand::ConstPtr FlipTracker::update(const mrs_msgs::Ua
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  mrs_msgs::PositionCommand position_cmd = activation_cmd_;
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+  *position_cmd = activation_cmd_;
+
+  ros::Time now = ros::Time::now();
 
-  position_cmd.header.stamp = ros::Time::now();
+  position_cmd->header.stamp = now;
+
+  // | ----------------- evaluate the flip plan ----------------- |
+
+  double t = (now - flip_start_time).toSec();
 
   // rotate the drone's z axis
   tf2::Transform uav_state_transform = mrs_lib::AttitudeConverter(uav_state->pose.orientation);
@@ -374,104 +453,106 @@ const mrs_msgs::PositionCommand::ConstPtr FlipTracker::update(const mrs_msgs::Ua
   // calculate the angle between the drone's z axis and the world's z axis
   double tilt_angle = acos(uav_z_in_world.dot(tf2::Vector3(0, 0, 1)));
 
-  double mass = common_handlers_->getMass();
-  double g    = common_handlers_->g;
-
-  // calculate the z acceleration
-  double hover_thrust = mrs_lib::quadratic_thrust_model::forceToThrust(common_handlers_->motor_params, mass * g);
-
-  switch (current_state) {
-
-    case STATE_IDLE: {
+  if (current_state != STATE_IDLE) {
 
-      position_cmd.use_position_vertical   = true;
-      position_cmd.use_position_horizontal = true;
+    States_t phase = nextPhase(plan, current_state, (now - phase_start_time).toSec(), tilt_angle, uav_state->velocity.linear.z);
 
-      position_cmd.use_velocity_vertical   = true;
-      position_cmd.use_velocity_horizontal = true;
+    // the flip has finished, hand the recorded data over for dumping
+    if (phase == STATE_IDLE && _telemetry_enabled_) {
 
-      position_cmd.use_acceleration = false;
-      position_cmd.use_jerk         = false;
-      position_cmd.use_snap         = false;
+      std::scoped_lock lock(mutex_telemetry_dump_);
 
-      position_cmd.use_heading              = true;
-      position_cmd.use_heading_rate         = false;
-      position_cmd.use_heading_acceleration = false;
-      position_cmd.use_heading_jerk         = false;
+      if (!telemetry_dump_pending_) {
 
-      position_cmd.use_orientation = false;
+        std::swap(telemetry_, telemetry_dump_);
 
-      position_cmd.use_attitude_rate = false;
+        telemetry_dump_count_   = telemetry_count_;
+        telemetry_dump_stamp_   = flip_start_time;
+        telemetry_dump_pending_ = true;
+      }
 
-      break;
+      telemetry_count_ = 0;
     }
 
-    case STATE_ACCELERATION: {
+    if (phase != current_state) {
+
+      ROS_INFO("[FlipTracker]: switching to phase %d at %.3f s, tilt %.2f rad", phase, t, tilt_angle);
 
-      position_cmd.use_position_vertical   = false;
-      position_cmd.use_position_horizontal = true;
+      current_state    = phase;
+      phase_start_time = now;
 
-      position_cmd.use_velocity_vertical   = true;
-      position_cmd.use_velocity_horizontal = true;
+      {
+        std::scoped_lock lock(mutex_current_state_);
 
-      position_cmd.use_acceleration = true;
+        current_state_    = current_state;
+        phase_start_time_ = phase_start_time;
+      }
+    }
+  }
 
-      /* position_cmd.use_acceleration = true; */
+  double phase_time = (now - phase_start_time).toSec();
 
-      position_cmd.use_jerk = false;
+  switch (current_state) {
 
-      position_cmd.use_snap = false;
+    case STATE_IDLE: {
 
-      position_cmd.use_heading              = true;
-      position_cmd.use_heading_rate         = false;
-      position_cmd.use_heading_acceleration = false;
-      position_cmd.use_heading_jerk         = false;
+      position_cmd->use_position_vertical   = true;
+      position_cmd->use_position_horizontal = true;
 
-      position_cmd.use_orientation = false;
+      position_cmd->use_velocity_vertical   = true;
+      position_cmd->use_velocity_horizontal = true;
 
-      position_cmd.use_attitude_rate = false;
+      position_cmd->use_acceleration = false;
+      position_cmd->use_jerk         = false;
+      position_cmd->use_snap         = false;
 
-      if (rampup_active_) {
+      position_cmd->use_heading              = true;
+      position_cmd->use_heading_rate         = false;
+      position_cmd->use_heading_acceleration = false;
+      position_cmd->use_heading_jerk         = false;
 
-        // deactivate the rampup when the times up
-        if (fabs((ros::Time::now() - rampup_start_time_).toSec()) >= rampup_duration_) {
+      position_cmd->use_orientation = false;
 
-          rampup_active_              = false;
-          position_cmd.acceleration.z = z_acceleration_acc_;
+      position_cmd->use_attitude_rate = false;
 
-          ROS_INFO("[FlipTracker]: rampup finished");
+      break;
+    }
 
-        } else {
+    case STATE_ACCELERATION: {
 
-          double rampup_dt = (ros::Time::now() - rampup_last_time_).toSec();
+      position_cmd->use_position_vertical   = false;
+      position_cmd->use_position_horizontal = true;
 
-          rampup_acc_ += _rampup_speed_ * rampup_dt;
+      position_cmd->use_velocity_vertical   = true;
+      position_cmd->use_velocity_horizontal = true;
 
-          rampup_last_time_ = ros::Time::now();
+      position_cmd->use_acceleration = true;
 
-          position_cmd.acceleration.z = rampup_acc_;
+      /* position_cmd->use_acceleration = true; */
 
-          ROS_INFO_THROTTLE(0.1, "[FlipTracker]: ramping up acceleration, %.4f", rampup_acc_);
-        }
+      position_cmd->use_jerk = false;
 
-      } else {
-        position_cmd.acceleration.z = z_acceleration_acc_;
-      }
+      position_cmd->use_snap = false;
 
-      position_cmd.acceleration.z = z_acceleration_acc_;
+      position_cmd->use_heading              = true;
+      position_cmd->use_heading_rate         = false;
+      position_cmd->use_heading_acceleration = false;
+      position_cmd->use_heading_jerk         = false;
 
-      position_cmd.velocity.z = z_vel_gained_by_flipping_;
+      position_cmd->use_orientation = false;
 
-      if ((ros::Time::now() - state_change_time_).toSec() >= 2 * z_acceleration_duration_) {
-        ROS_INFO("[FlipTracker]: acceleration timeouted, recovering");
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_RECOVERY, current_state_);
-        state_change_time_ = ros::Time::now();
-      }
+      position_cmd->use_attitude_rate = false;
 
-      if (uav_state->velocity.linear.z > 0.95 * z_vel_gained_by_flipping_) {
-        ROS_INFO("[FlipTracker]: z vel exceeded %.2f, flipping", z_vel_gained_by_flipping_);
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_FLIPPING_PULSE, current_state_);
-        state_change_time_ = ros::Time::now();
+      // jerk-limited rampup of the acceleration, then constant acceleration until the velocity is reached
+      if (phase_time < plan.rampup_end) {
+        position_cmd->acceleration.z = plan.z_jerk * phase_time;
+        position_cmd->velocity.z     = 0.5 * plan.z_jerk * phase_time * phase_time;
+      } else if (phase_time < plan.acceleration_end) {
+        position_cmd->acceleration.z = plan.z_acceleration;
+        position_cmd->velocity.z     = 0.5 * plan.z_jerk * pow(plan.rampup_end, 2) + plan.z_acceleration * (phase_time - plan.rampup_end);
+      } else {
+        position_cmd->acceleration.z = plan.z_acceleration;
+        position_cmd->velocity.z     = plan.z_velocity;
       }
 
       break;
@@ -479,148 +560,137 @@ const mrs_msgs::PositionCommand::ConstPtr FlipTracker::update(const mrs_msgs::Ua
 
     case STATE_FLIPPING_PULSE: {
 
-      position_cmd.use_position_vertical   = false;
-      position_cmd.use_position_horizontal = false;
+      position_cmd->use_position_vertical   = false;
+      position_cmd->use_position_horizontal = false;
 
-      position_cmd.use_velocity_vertical   = false;
-      position_cmd.use_velocity_horizontal = false;
+      position_cmd->use_velocity_vertical   = false;
+      position_cmd->use_velocity_horizontal = false;
 
-      position_cmd.use_acceleration = false;
+      position_cmd->use_acceleration = false;
 
-      position_cmd.use_jerk = false;
+      position_cmd->use_jerk = false;
 
-      position_cmd.use_snap = false;
+      position_cmd->use_snap = false;
 
-      position_cmd.use_heading              = false;
-      position_cmd.use_heading_rate         = false;
-      position_cmd.use_heading_acceleration = false;
-      position_cmd.use_heading_jerk         = false;
+      position_cmd->use_heading              = false;
+      position_cmd->use_heading_rate         = false;
+      position_cmd->use_heading_acceleration = false;
+      position_cmd->use_heading_jerk         = false;
 
-      position_cmd.use_orientation = false;
+      position_cmd->use_orientation = false;
 
-      double direction = drs_params.direction == 0 ? 1.0 : -1.0;
+      position_cmd->attitude_rate.x = plan.attitude_rate(0);
+      position_cmd->attitude_rate.y = plan.attitude_rate(1);
+      position_cmd->attitude_rate.z = plan.attitude_rate(2);
 
-      if (drs_params.axis == 0) {
-        position_cmd.attitude_rate.x = direction * drs_params.attitude_rate;
-      } else if (drs_params.axis == 1) {
-        position_cmd.attitude_rate.y = direction * drs_params.attitude_rate;
-      }
+      position_cmd->use_attitude_rate = true;
 
-      position_cmd.use_attitude_rate = true;
+      // the tilt expected by the plan
+      double planned_tilt = plan.attitude_rate.norm() * phase_time;
 
-      if (tilt_angle <= M_PI / 2.0) {
-        position_cmd.thrust = hover_thrust * cos(tilt_angle);
+      if (planned_tilt <= M_PI / 2.0) {
+        position_cmd->thrust = plan.hover_thrust * cos(planned_tilt);
       } else {
-        position_cmd.thrust = 0;
-      }
-      position_cmd.use_thrust = true;
-
-      if ((ros::Time::now() - state_change_time_).toSec() >= _pulse_timeout_) {
-
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_RECOVERY, current_state_);
-
-        ROS_ERROR("[FlipTracker]: pulse phase took too long (%.4f s, timeout %.4f s), startin recovery", (ros::Time::now() - state_change_time_).toSec(),
-                  _pulse_timeout_);
-
-        state_change_time_ = ros::Time::now();
-
-      } else if (tilt_angle > FLIPPING_PULSE_STOP_TILT) {
-
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_FLIPPING_INTERTIA, current_state_);
-
-        ROS_INFO("[FlipTracker]: pulse phase took %.4f s, (timeout %.4f s)", (ros::Time::now() - state_change_time_).toSec(), _pulse_timeout_);
-
-        state_change_time_ = ros::Time::now();
+        position_cmd->thrust = 0;
       }
+      position_cmd->use_thrust = true;
 
       break;
     }
 
     case STATE_FLIPPING_INTERTIA: {
 
-      position_cmd.use_position_vertical   = false;
-      position_cmd.use_position_horizontal = false;
+      position_cmd->use_position_vertical   = false;
+      position_cmd->use_position_horizontal = false;
 
-      position_cmd.use_velocity_vertical   = false;
-      position_cmd.use_velocity_horizontal = false;
+      position_cmd->use_velocity_vertical   = false;
+      position_cmd->use_velocity_horizontal = false;
 
-      position_cmd.use_acceleration = false;
+      position_cmd->use_acceleration = false;
 
-      position_cmd.use_jerk = false;
+      position_cmd->use_jerk = false;
 
-      position_cmd.use_snap = false;
+      position_cmd->use_snap = false;
 
-      position_cmd.use_heading              = false;
-      position_cmd.use_heading_rate         = false;
-      position_cmd.use_heading_acceleration = false;
-      position_cmd.use_heading_jerk         = false;
+      position_cmd->use_heading              = false;
+      position_cmd->use_heading_rate         = false;
+      position_cmd->use_heading_acceleration = false;
+      position_cmd->use_heading_jerk         = false;
 
-      position_cmd.use_orientation = false;
+      position_cmd->use_orientation = false;
 
-      position_cmd.use_attitude_rate = true;
+      position_cmd->use_attitude_rate = true;
 
-      position_cmd.attitude_rate.x = 0;
-      position_cmd.attitude_rate.y = 0;
-      position_cmd.attitude_rate.z = 0;
+      position_cmd->attitude_rate.x = 0;
+      position_cmd->attitude_rate.y = 0;
+      position_cmd->attitude_rate.z = 0;
 
-      position_cmd.thrust     = 0;
-      position_cmd.use_thrust = true;
+      position_cmd->thrust     = 0;
+      position_cmd->use_thrust = true;
 
-      if ((ros::Time::now() - state_change_time_).toSec() >= _innertia_timeout_) {
+      break;
+    }
+
+    case STATE_RECOVERY: {
 
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_RECOVERY, current_state_);
+      activation_cmd_.position.z = uav_state->pose.position.z;
 
-        ROS_ERROR("[FlipTracker]: inertia phase took too long (%.4f s, timeout %.4f s), startin recovery", (ros::Time::now() - state_change_time_).toSec(),
-                  _innertia_timeout_);
+      position_cmd->use_position_vertical   = false;
+      position_cmd->use_position_horizontal = true;
 
-        state_change_time_ = ros::Time::now();
+      position_cmd->use_velocity_vertical   = true;
+      position_cmd->use_velocity_horizontal = true;
 
-      } else if (tilt_angle <= INNERTIA_PULSE_STOP_TILT) {
+      position_cmd->use_acceleration = false;
+      position_cmd->use_jerk         = false;
+      position_cmd->use_snap         = false;
 
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_RECOVERY, current_state_);
+      position_cmd->use_heading              = true;
+      position_cmd->use_heading_rate         = false;
+      position_cmd->use_heading_acceleration = false;
+      position_cmd->use_heading_jerk         = false;
 
-        ROS_INFO("[FlipTracker]: inertia phase took %.4f s, (timeout %.4f s)", (ros::Time::now() - state_change_time_).toSec(), _innertia_timeout_);
+      position_cmd->use_orientation = false;
 
-        state_change_time_ = ros::Time::now();
-      }
+      position_cmd->use_attitude_rate = false;
 
       break;
     }
+  }
 
-    case STATE_RECOVERY: {
-
-      activation_cmd_.position.z = uav_state->pose.position.z;
-
-      position_cmd.use_position_vertical   = false;
-      position_cmd.use_position_horizontal = true;
+  // | --------------------- record telemetry -------------------- |
 
-      position_cmd.use_velocity_vertical   = true;
-      position_cmd.use_velocity_horizontal = true;
+  if (current_state != STATE_IDLE && _telemetry_enabled_) {
 
-      position_cmd.use_acceleration = false;
-      position_cmd.use_jerk         = false;
-      position_cmd.use_snap         = false;
+    // a new flip, the previous one was not finished
+    if (flip_start_time != telemetry_flip_start_) {
+      telemetry_count_      = 0;
+      telemetry_flip_start_ = flip_start_time;
+    }
 
-      position_cmd.use_heading              = true;
-      position_cmd.use_heading_rate         = false;
-      position_cmd.use_heading_acceleration = false;
-      position_cmd.use_heading_jerk         = false;
+    TelemetrySample_t &sample = telemetry_[telemetry_count_++ % telemetry_.size()];
 
-      position_cmd.use_orientation = false;
+    sample.time       = t;
+    sample.state      = current_state;
+    sample.tilt_angle = tilt_angle;
 
-      position_cmd.use_attitude_rate = false;
+    sample.attitude_rate[0] = position_cmd->use_attitude_rate ? position_cmd->attitude_rate.x : 0;
+    sample.attitude_rate[1] = position_cmd->use_attitude_rate ? position_cmd->attitude_rate.y : 0;
+    sample.attitude_rate[2] = position_cmd->use_attitude_rate ? position_cmd->attitude_rate.z : 0;
+    sample.thrust           = position_cmd->use_thrust ? position_cmd->thrust : -1;
 
-      if ((ros::Time::now() - state_change_time_).toSec() >= _recovery_duration_) {
+    sample.velocity[0] = uav_state->velocity.linear.x;
+    sample.velocity[1] = uav_state->velocity.linear.y;
+    sample.velocity[2] = uav_state->velocity.linear.z;
 
-        mrs_lib::set_mutexed(mutex_current_state_, STATE_IDLE, current_state_);
-        state_change_time_ = ros::Time::now();
-      }
+    sample.angular_velocity[0] = uav_state->velocity.angular.x;
+    sample.angular_velocity[1] = uav_state->velocity.angular.y;
+    sample.angular_velocity[2] = uav_state->velocity.angular.z;
 
-      break;
-    }
+    sample.height = uav_state->pose.position.z;
   }
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  return position_cmd;
 }
 
 //}
@@ -833,6 +903,8 @@ bool FlipTracker::callbackFlip([[maybe_unused]] std_srvs::Trigger::Request &req,
 
   auto drs_params = mrs_lib::get_mutexed(mutex_drs_params_, drs_params_);
 
+  double z_acceleration_acc_;
+
   // calculate the z acceleration
   if (drs_params.z_mode == 0) {
     z_acceleration_acc_ = drs_params.z_acceleration;
@@ -867,17 +939,24 @@ bool FlipTracker::callbackFlip([[maybe_unused]] std_srvs::Trigger::Request &req,
     return true;
   }
 
-  // calculate what velocity will the UAV gain while perfoming the flipping maneuvre
-  /* z_pos_lost_by_flipping_ = 0.5 * g * pow(((drs_params.velocity_gain_from_rot * M_PI) / drs_params.attitude_rate), 2.0); */
+  if (z_acceleration_acc_ <= 0 || drs_params.attitude_rate <= 0) {
+
+    std::stringstream ss;
+    ss << "can not flip, the acceleration and the attitude rate have to be positive";
+
+    res.message = ss.str();
+    res.success = false;
 
-  z_vel_gained_by_flipping_ = g * ((drs_params.velocity_gain_from_rot * M_PI) / drs_params.attitude_rate);
+    ROS_WARN_STREAM("[FlipTracker]: " << ss.str());
 
-  // calculate how long do we have to accelerate to create a positive velocity for the maneuvre
-  /* z_acceleration_duration_ = sqrt((2 * z_pos_lost_by_flipping_) / z_acceleration_acc_); */
+    return true;
+  }
 
-  z_acceleration_duration_ = z_vel_gained_by_flipping_ / z_acceleration_acc_;
+  FlipPlan_t plan = planFlip(drs_params, z_acceleration_acc_);
 
-  ROS_INFO("[FlipTracker]: z manouvre: acceleration: %.2f, duration: %.2f", z_acceleration_acc_, z_acceleration_duration_);
+  ROS_INFO("[FlipTracker]: z manouvre: acceleration: %.2f, velocity: %.2f, duration: %.2f", plan.z_acceleration, plan.z_velocity, plan.acceleration_end);
+  ROS_INFO("[FlipTracker]: the expected durations: pulse %.3f s (timeout %.3f s), inertia %.3f s (timeout %.3f s)", plan.pulse_duration, plan.pulse_timeout,
+           plan.inertia_duration, plan.inertia_timeout);
 
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
@@ -896,21 +975,101 @@ bool FlipTracker::callbackFlip([[maybe_unused]] std_srvs::Trigger::Request &req,
 
   ROS_INFO_STREAM("[FlipTracker]: " << ss.str());
 
-  rampup_active_     = true;
-  rampup_start_time_ = ros::Time::now();
-  rampup_last_time_  = ros::Time::now();
-  rampup_duration_   = fabs(z_acceleration_acc_) / _rampup_speed_;
-  rampup_acc_        = 0;
-
-  mrs_lib::set_mutexed(mutex_current_state_, STATE_ACCELERATION, current_state_);
+  {
+    std::scoped_lock lock(mutex_current_state_);
 
-  state_change_time_ = ros::Time::now();
+    plan_             = plan;
+    flip_start_time_  = ros::Time::now();
+    phase_start_time_ = flip_start_time_;
+    current_state_    = STATE_ACCELERATION;
+  }
 
   return true;
 }
 
 //}
 
+// | ------------------------- timers ------------------------- |
+
+/* timerTelemetry() //{ */
+
+void FlipTracker::timerTelemetry([[maybe_unused]] const ros::TimerEvent &event) {
+
+  std::vector<TelemetrySample_t> samples;
+  size_t                         recorded;
+  ros::Time                      stamp;
+
+  // copied out, so the file is written without holding the lock, update() takes it when a flip ends
+  {
+    std::scoped_lock lock(mutex_telemetry_dump_);
+
+    if (!telemetry_dump_pending_) {
+      return;
+    }
+
+    recorded = telemetry_dump_count_;
+    stamp    = telemetry_dump_stamp_;
+
+    const size_t n_samples = std::min(telemetry_dump_count_, telemetry_dump_.size());
+
+    // the oldest sample first
+    const size_t oldest = telemetry_dump_count_ > telemetry_dump_.size() ? telemetry_dump_count_ % telemetry_dump_.size() : 0;
+
+    samples.reserve(n_samples);
+
+    for (size_t i = 0; i < n_samples; i++) {
+      samples.push_back(telemetry_dump_[(oldest + i) % telemetry_dump_.size()]);
+    }
+
+    telemetry_dump_pending_ = false;
+  }
+
+  // the nanoseconds keep the dumps of the flips within the same second apart
+  std::stringstream filename;
+  filename << _telemetry_directory_ << "/flip_" << _uav_name_ << "_" << stamp.sec << "_" << std::setw(9) << std::setfill('0') << stamp.nsec << ".bin";
+
+  std::ofstream file(filename.str(), std::ios::binary);
+
+  if (!file.is_open()) {
+    ROS_ERROR("[FlipTracker]: could not open '%s' for the flip telemetry", filename.str().c_str());
+    return;
+  }
+
+  // the fields are written one by one in this order (little endian), without any padding:
+  // time, state (int32), tilt_angle, attitude_rate[3], thrust, velocity[3], angular_velocity[3], height
+  auto write_sample = [&file](const TelemetrySample_t &sample) {
+    auto write = [&file](const auto &value) { file.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+
+    write(sample.time);
+    write(sample.state);
+    write(sample.tilt_angle);
+    write(sample.attitude_rate);
+    write(sample.thrust);
+    write(sample.velocity);
+    write(sample.angular_velocity);
+    write(sample.height);
+  };
+
+  const uint32_t sample_size = sizeof(double) * 13 + sizeof(int32_t);
+
+  // header: magic, the size of a sample and the number of samples, then the samples
+  const char     magic[8]  = {'F', 'L', 'I', 'P', 'L', 'O', 'G', '1'};
+  const uint32_t n_samples = samples.size();
+
+  file.write(magic, sizeof(magic));
+  file.write(reinterpret_cast<const char *>(&sample_size), sizeof(sample_size));
+  file.write(reinterpret_cast<const char *>(&n_samples), sizeof(n_samples));
+
+  for (auto &sample : samples) {
+    write_sample(sample);
+  }
+
+  ROS_INFO("[FlipTracker]: %u telemetry samples of the flip saved to '%s'%s", n_samples, filename.str().c_str(),
+           recorded > n_samples ? " (the oldest were overwritten)" : "");
+}
+
+//}
+
 /* dynamicReconfigureCallback() //{ */
 
 void FlipTracker::dynamicReconfigureCallback(mrs_uav_trackers::flip_trackerConfig &config, [[maybe_unused]] uint32_t level) {
@@ -926,6 +1085,142 @@ void FlipTracker::dynamicReconfigureCallback(mrs_uav_trackers::flip_trackerConfi
 
 // | ------------------------ routines ------------------------ |
 
+/* planFlip() //{ */
+
+FlipTracker::FlipPlan_t FlipTracker::planFlip(const mrs_uav_trackers::flip_trackerConfig &drs_params, const double z_acceleration) {
+
+  double mass = common_handlers_->getMass();
+  double g    = common_handlers_->g;
+
+  FlipPlan_t plan;
+
+  plan.z_acceleration = z_acceleration;
+  plan.z_jerk         = _rampup_speed_;
+
+  // the vertical velocity the UAV loses while flipping, it has to be gained in advance
+  plan.z_velocity = g * ((drs_params.velocity_gain_from_rot * M_PI) / drs_params.attitude_rate);
+
+  // | ------------------- acceleration phase ------------------- |
+
+  double rampup_velocity = 0.5 * pow(z_acceleration, 2) / plan.z_jerk;
+
+  if (plan.z_velocity <= rampup_velocity) {
+
+    // the velocity is gained before the acceleration is fully ramped up
+    plan.rampup_end       = sqrt(2.0 * plan.z_velocity / plan.z_jerk);
+    plan.acceleration_end = plan.rampup_end;
+    plan.z_acceleration   = plan.z_jerk * plan.rampup_end;
+
+  } else {
+
+    plan.rampup_end       = z_acceleration / plan.z_jerk;
+    plan.acceleration_end = plan.rampup_end + (plan.z_velocity - rampup_velocity) / z_acceleration;
+  }
+
+  plan.acceleration_timeout = 2.0 * plan.acceleration_end;
+
+  // | ------------------------- pulse -------------------------- |
+
+  double direction = drs_params.direction == 0 ? 1.0 : -1.0;
+
+  plan.attitude_rate = vec3_t::Zero();
+
+  if (drs_params.axis == 0) {
+    plan.attitude_rate(0) = direction * drs_params.attitude_rate;
+  } else if (drs_params.axis == 1) {
+    plan.attitude_rate(1) = direction * drs_params.attitude_rate;
+  }
+
+  plan.hover_thrust = mrs_lib::quadratic_thrust_model::forceToThrust(common_handlers_->motor_params, mass * g);
+
+  plan.pulse_duration = FLIPPING_PULSE_STOP_TILT / drs_params.attitude_rate;
+  plan.pulse_timeout  = _pulse_timeout_factor_ * plan.pulse_duration;
+
+  // | ------------------------ inertia ------------------------- |
+
+  // the UAV keeps rotating with the same rate, until it is close enough to level again
+  plan.inertia_duration = ((M_PI - FLIPPING_PULSE_STOP_TILT) + (M_PI - INNERTIA_PULSE_STOP_TILT)) / drs_params.attitude_rate;
+  plan.inertia_timeout  = _innertia_timeout_factor_ * plan.inertia_duration;
+
+  return plan;
+}
+
+//}
+
+/* nextPhase() //{ */
+
+// the phases are switched by the measured state, each of them is aborted to the recovery when it takes too long
+States_t FlipTracker::nextPhase(const FlipPlan_t &plan, const States_t phase, const double phase_time, const double tilt_angle, const double z_velocity) {
+
+  switch (phase) {
+
+    case STATE_ACCELERATION: {
+
+      if (phase_time >= plan.acceleration_timeout) {
+
+        ROS_ERROR("[FlipTracker]: acceleration took too long (%.4f s, timeout %.4f s), starting recovery", phase_time, plan.acceleration_timeout);
+        return STATE_RECOVERY;
+
+      } else if (z_velocity > 0.95 * plan.z_velocity) {
+
+        ROS_INFO("[FlipTracker]: z vel exceeded %.2f, flipping", plan.z_velocity);
+        return STATE_FLIPPING_PULSE;
+      }
+
+      break;
+    }
+
+    case STATE_FLIPPING_PULSE: {
+
+      if (phase_time >= plan.pulse_timeout) {
+
+        ROS_ERROR("[FlipTracker]: pulse phase took too long (%.4f s, timeout %.4f s), starting recovery", phase_time, plan.pulse_timeout);
+        return STATE_RECOVERY;
+
+      } else if (tilt_angle > FLIPPING_PULSE_STOP_TILT) {
+
+        ROS_INFO("[FlipTracker]: pulse phase took %.4f s, (expected %.4f s)", phase_time, plan.pulse_duration);
+        return STATE_FLIPPING_INTERTIA;
+      }
+
+      break;
+    }
+
+    case STATE_FLIPPING_INTERTIA: {
+
+      if (phase_time >= plan.inertia_timeout) {
+
+        ROS_ERROR("[FlipTracker]: inertia phase took too long (%.4f s, timeout %.4f s), starting recovery", phase_time, plan.inertia_timeout);
+        return STATE_RECOVERY;
+
+      } else if (tilt_angle <= INNERTIA_PULSE_STOP_TILT) {
+
+        ROS_INFO("[FlipTracker]: inertia phase took %.4f s, (expected %.4f s)", phase_time, plan.inertia_duration);
+        return STATE_RECOVERY;
+      }
+
+      break;
+    }
+
+    case STATE_RECOVERY: {
+
+      if (phase_time >= _recovery_duration_) {
+        return STATE_IDLE;
+      }
+
+      break;
+    }
+
+    case STATE_IDLE: {
+      break;
+    }
+  }
+
+  return phase;
+}
+
+//}
+
 /* checkState() //{ */
 
 bool FlipTracker::checkState(void) {
@@ -6,6 +6,8 @@
 
 #include <mrs_uav_managers/tracker.h>
 
+#include <mrs_uav_trackers/position_command_pool.h>
+
 #include <nav_msgs/Odometry.h>
 #include <sensor_msgs/Joy.h>
 
@@ -82,8 +84,6 @@ private:
   bool is_initialized_ = false;
   bool is_active_      = false;
 
-  ros::Time last_update;
-
   // | ------------------------ uav state ----------------------- |
 
   mrs_msgs::UavState uav_state_;
@@ -93,30 +93,68 @@ private:
   // | ------------------ dynamics constraints ------------------ |
 
   double     _heading_rate_;
+  double     _heading_acceleration_;
+  double     _vertical_acceleration_;
+  double     _max_tilt_rate_;
   std::mutex mutex_constraints_;
 
   // | ------------------ tracker's inner state ----------------- |
 
+  // the reference follows the joystick input with limited rates
   double     state_z_;
   double     state_heading_;
+  double     state_vertical_speed_;
+  double     state_heading_rate_;
+  double     state_roll_;
+  double     state_pitch_;
+  ros::Time  last_update_time_;
   std::mutex mutex_state_;
 
   // | ------------------- joystick subscriber ------------------ |
 
   mrs_lib::SubscribeHandler<sensor_msgs::Joy> sh_joystick_;
 
+  void callbackJoystick(mrs_lib::SubscribeHandler<sensor_msgs::Joy> &wrp);
+
   double _max_tilt_;
   double _vertical_speed_;
 
-  // channel numbers and channel multipliers
-  int    _channel_pitch_;
-  int    _channel_roll_;
-  int    _channel_heading_;
-  int    _channel_thrust_;
-  double _channel_mult_pitch_;
-  double _channel_mult_roll_;
-  double _channel_mult_heading_;
-  double _channel_mult_thrust_;
+  // a joystick axis mapped to one of the inputs
+  struct Channel_t
+  {
+    int    index;
+    double multiplier;
+    double deadband;
+    double expo;
+  };
+
+  Channel_t channel_pitch_;
+  Channel_t channel_roll_;
+  Channel_t channel_heading_;
+  Channel_t channel_thrust_;
+
+  void   loadChannel(mrs_lib::ParamLoader &param_loader, const std::string &name, Channel_t &channel);
+  double shapeChannel(const sensor_msgs::Joy &joy, const Channel_t &channel);
+
+  // the shaped and scaled joystick input
+  struct Input_t
+  {
+    double    vertical_speed = 0;
+    double    heading_rate   = 0;
+    double    pitch          = 0;
+    double    roll           = 0;
+    ros::Time stamp;  // the time of arrival
+  };
+
+  Input_t    input_;
+  std::mutex mutex_input_;
+
+  double _input_timeout_;
+  bool   input_stale_ = false;
+
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
 
   // | ------------------------ profiler ------------------------ |
 
@@ -157,22 +195,20 @@ void JoyTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]] c
   param_loader.loadParam("enable_profiler", _profiler_enabled_);
 
   param_loader.loadParam("vertical_tracker/vertical_speed", _vertical_speed_);
+  param_loader.loadParam("vertical_tracker/vertical_acceleration", _vertical_acceleration_);
 
   param_loader.loadParam("max_tilt", _max_tilt_);
+  param_loader.loadParam("max_tilt_rate", _max_tilt_rate_);
 
   param_loader.loadParam("heading_tracker/heading_rate", _heading_rate_);
+  param_loader.loadParam("heading_tracker/heading_acceleration", _heading_acceleration_);
 
-  // load channels
-  param_loader.loadParam("channels/pitch", _channel_pitch_);
-  param_loader.loadParam("channels/roll", _channel_roll_);
-  param_loader.loadParam("channels/heading", _channel_heading_);
-  param_loader.loadParam("channels/thrust", _channel_thrust_);
+  param_loader.loadParam("input_timeout", _input_timeout_);
 
-  // load channel multipliers
-  param_loader.loadParam("channel_multipliers/pitch", _channel_mult_pitch_);
-  param_loader.loadParam("channel_multipliers/roll", _channel_mult_roll_);
-  param_loader.loadParam("channel_multipliers/heading", _channel_mult_heading_);
-  param_loader.loadParam("channel_multipliers/thrust", _channel_mult_thrust_);
+  loadChannel(param_loader, "pitch", channel_pitch_);
+  loadChannel(param_loader, "roll", channel_roll_);
+  loadChannel(param_loader, "heading", channel_heading_);
+  loadChannel(param_loader, "thrust", channel_thrust_);
 
   if (!param_loader.loadedSuccessfully()) {
     ROS_ERROR("[JoyTracker]: could not load all parameters!");
@@ -191,12 +227,10 @@ void JoyTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]] c
   shopts.queue_size      = 1;
   shopts.transport_hints = ros::TransportHints().tcpNoDelay();
 
-  sh_joystick_ = mrs_lib::SubscribeHandler<sensor_msgs::Joy>(shopts, "joystick_in");
+  sh_joystick_ = mrs_lib::SubscribeHandler<sensor_msgs::Joy>(shopts, "joystick_in", &JoyTracker::callbackJoystick, this);
 
   // | --------------------- finish the init -------------------- |
 
-  last_update = ros::Time(0);
-
   is_initialized_ = true;
 
   ROS_INFO("[JoyTracker]: initialized, version %s", VERSION);
@@ -222,27 +256,53 @@ std::tuple<bool, std::string> JoyTracker::activate(const mrs_msgs::PositionComma
     return std::tuple(false, ss.str());
   }
 
+  auto input = mrs_lib::get_mutexed(mutex_input_, input_);
+
+  if (_input_timeout_ > 0 && (ros::Time::now() - input.stamp).toSec() > _input_timeout_) {
+
+    ss << "the joystick input is stale";
+    return std::tuple(false, ss.str());
+  }
+
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
   double uav_heading = 0;
+  double uav_roll    = 0;
+  double uav_pitch   = 0;
 
   try {
     uav_heading = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getHeading();
+    uav_roll    = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getRoll();
+    uav_pitch   = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getPitch();
   }
   catch (...) {
     ROS_ERROR_THROTTLE(1.0, "[JoyTracker]: could not calculate UAV heading");
   }
 
-  // initialized the heading and z from the last tracker command / odometry
+  // initialized the reference from the last tracker command / odometry, it then
+  // moves towards the joystick input with the limited rates, so it does not jump
   {
     std::scoped_lock lock(mutex_state_);
 
+    state_vertical_speed_ = 0;
+    state_heading_rate_   = 0;
+    state_roll_           = uav_roll;
+    state_pitch_          = uav_pitch;
+
     if (mrs_msgs::PositionCommand::Ptr() != last_position_cmd) {
 
       // the last command is usable
       state_z_       = last_position_cmd->position.z;
       state_heading_ = last_position_cmd->heading;
 
+      if (last_position_cmd->use_velocity_vertical) {
+        state_vertical_speed_ = last_position_cmd->velocity.z;
+      }
+
+      if (last_position_cmd->use_heading_rate) {
+        state_heading_rate_ = last_position_cmd->heading_rate;
+      }
+
     } else {
 
       state_z_       = uav_state.pose.position.z;
@@ -250,8 +310,12 @@ std::tuple<bool, std::string> JoyTracker::activate(const mrs_msgs::PositionComma
 
       ROS_WARN("[JoyTracker]: the previous command is not usable for activation, using Odometry instead");
     }
+
+    last_update_time_ = ros::Time::now();
   }
 
+  input_stale_ = false;
+
   is_active_ = true;
 
   ss << "activated";
@@ -298,63 +362,85 @@ const mrs_msgs::PositionCommand::ConstPtr JoyTracker::update(const mrs_msgs::Uav
     got_uav_state_ = true;
   }
 
-  double dt = (ros::Time::now() - last_update).toSec();
-
-  last_update = ros::Time::now();
-
   // up to this part the update() method is evaluated even when the tracker is not active
   if (!is_active_) {
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  if (!sh_joystick_.hasMsg()) {
-    return mrs_msgs::PositionCommand::Ptr();
-  }
+  ros::Time now = ros::Time::now();
 
   // | ------------------ get the joystick data ----------------- |
 
-  sensor_msgs::JoyConstPtr joy_data = sh_joystick_.getMsg();
+  auto input = mrs_lib::get_mutexed(mutex_input_, input_);
+
+  // stale input is treated as centered sticks
+  bool stale = _input_timeout_ > 0 && (now - input.stamp).toSec() > _input_timeout_;
+
+  if (stale != input_stale_) {
+
+    if (stale) {
+      ROS_WARN("[JoyTracker]: the joystick input is stale, centering the sticks");
+    } else {
+      ROS_INFO("[JoyTracker]: the joystick input is fresh again");
+    }
+
+    input_stale_ = stale;
+  }
+
+  if (stale) {
+    input = Input_t();
+  }
+
+  auto [vertical_acceleration, heading_acceleration, max_tilt_rate] =
+      mrs_lib::get_mutexed(mutex_constraints_, _vertical_acceleration_, _heading_acceleration_, _max_tilt_rate_);
+
+  std::scoped_lock lock(mutex_state_);
 
-  double desired_vertical_speed = _channel_mult_thrust_ * joy_data->axes[_channel_thrust_] * _vertical_speed_;
-  double desired_heading_rate   = _channel_mult_heading_ * joy_data->axes[_channel_heading_] * _heading_rate_;
-  double desired_pitch          = _channel_mult_pitch_ * joy_data->axes[_channel_pitch_] * _max_tilt_;
-  double desired_roll           = _channel_mult_roll_ * joy_data->axes[_channel_roll_] * _max_tilt_;
+  double dt = std::max((now - last_update_time_).toSec(), 0.0);
+
+  last_update_time_ = now;
 
   // | --------------------- height tracking -------------------- |
 
-  state_z_ += desired_vertical_speed * dt;
+  state_vertical_speed_ += std::clamp(input.vertical_speed - state_vertical_speed_, -vertical_acceleration * dt, vertical_acceleration * dt);
+
+  state_z_ += state_vertical_speed_ * dt;
 
   // | -------------------- heading tracking -------------------- |
 
-  state_heading_ += desired_heading_rate * dt;
+  state_heading_rate_ += std::clamp(input.heading_rate - state_heading_rate_, -heading_acceleration * dt, heading_acceleration * dt);
+
+  state_heading_ += state_heading_rate_ * dt;
   state_heading_ = radians::wrap(state_heading_);
 
-  ROS_INFO_THROTTLE(1.0, "[JoyTracker]: desired vert_speed: %.2f, heading_speed: %.2f, pitch: %.2f, roll: %.2f", desired_vertical_speed, desired_heading_rate,
-                    desired_pitch, desired_roll);
+  // | -------------------- tilt tracking -------------------- |
 
-  mrs_msgs::PositionCommand position_cmd;
+  state_roll_ += std::clamp(input.roll - state_roll_, -max_tilt_rate * dt, max_tilt_rate * dt);
+  state_pitch_ += std::clamp(input.pitch - state_pitch_, -max_tilt_rate * dt, max_tilt_rate * dt);
 
-  position_cmd.header.stamp    = ros::Time::now();
-  position_cmd.header.frame_id = uav_state->header.frame_id;
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
 
-  position_cmd.use_position_vertical = true;
-  position_cmd.position.z            = state_z_;
+  position_cmd->header.stamp    = now;
+  position_cmd->header.frame_id = uav_state->header.frame_id;
+
+  position_cmd->use_position_vertical = true;
+  position_cmd->position.z            = state_z_;
 
   // filling these anyway to allow visualization of the reference
-  position_cmd.position.x = uav_state->pose.position.x;
-  position_cmd.position.y = uav_state->pose.position.y;
+  position_cmd->position.x = uav_state->pose.position.x;
+  position_cmd->position.y = uav_state->pose.position.y;
 
-  position_cmd.use_velocity_vertical = true;
-  position_cmd.velocity.z            = desired_vertical_speed;
+  position_cmd->use_velocity_vertical = true;
+  position_cmd->velocity.z            = state_vertical_speed_;
 
-  position_cmd.use_heading_rate = 1;
-  position_cmd.heading_rate     = desired_heading_rate;
+  position_cmd->use_heading_rate = 1;
+  position_cmd->heading_rate     = state_heading_rate_;
 
-  /* position_cmd.orientation     = mrs_lib::AttitudeConverter(desired_roll, desired_pitch, 0).setHeadingByYaw(state_heading_); */
-  position_cmd.orientation     = mrs_lib::AttitudeConverter(desired_roll, desired_pitch, state_heading_);
-  position_cmd.use_orientation = true;
+  /* position_cmd->orientation     = mrs_lib::AttitudeConverter(desired_roll, desired_pitch, 0).setHeadingByYaw(state_heading_); */
+  position_cmd->orientation     = mrs_lib::AttitudeConverter(state_roll_, state_pitch_, state_heading_);
+  position_cmd->use_orientation = true;
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  return position_cmd;
 }
 
 //}
@@ -487,6 +573,74 @@ const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr JoyTracker::setTrajecto
 
 //}
 
+// --------------------------------------------------------------
+// |                          callbacks                         |
+// --------------------------------------------------------------
+
+/* callbackJoystick() //{ */
+
+void JoyTracker::callbackJoystick(mrs_lib::SubscribeHandler<sensor_msgs::Joy> &wrp) {
+
+  if (!is_initialized_) {
+    return;
+  }
+
+  sensor_msgs::JoyConstPtr joy = wrp.getMsg();
+
+  Input_t input;
+
+  input.vertical_speed = shapeChannel(*joy, channel_thrust_) * _vertical_speed_;
+  input.heading_rate   = shapeChannel(*joy, channel_heading_) * _heading_rate_;
+  input.pitch          = shapeChannel(*joy, channel_pitch_) * _max_tilt_;
+  input.roll           = shapeChannel(*joy, channel_roll_) * _max_tilt_;
+
+  // the joystick driver publishes only on change (unless its autorepeat is set), so the staleness is measured from the arrival
+  input.stamp = ros::Time::now();
+
+  mrs_lib::set_mutexed(mutex_input_, input, input_);
+}
+
+//}
+
+// --------------------------------------------------------------
+// |                          routines                          |
+// --------------------------------------------------------------
+
+/* loadChannel() //{ */
+
+void JoyTracker::loadChannel(mrs_lib::ParamLoader &param_loader, const std::string &name, Channel_t &channel) {
+
+  param_loader.loadParam("channels/" + name, channel.index);
+  param_loader.loadParam("channel_multipliers/" + name, channel.multiplier);
+  param_loader.loadParam("channel_shaping/" + name + "/deadband", channel.deadband);
+  param_loader.loadParam("channel_shaping/" + name + "/expo", channel.expo);
+}
+
+//}
+
+/* shapeChannel() //{ */
+
+// returns the axis value in [-1, 1] after applying the deadband and the expo curve
+double JoyTracker::shapeChannel(const sensor_msgs::Joy &joy, const Channel_t &channel) {
+
+  if (channel.index < 0 || channel.index >= int(joy.axes.size())) {
+    return 0;
+  }
+
+  double value = std::clamp(channel.multiplier * joy.axes[channel.index], -1.0, 1.0);
+
+  if (fabs(value) <= channel.deadband) {
+    return 0;
+  }
+
+  // rescale the rest of the range, so the output does not jump at the edge of the deadband
+  value = (value > 0 ? value - channel.deadband : value + channel.deadband) / (1.0 - channel.deadband);
+
+  return (1.0 - channel.expo) * value + channel.expo * pow(value, 3);
+}
+
+//}
+
 }  // namespace joy_tracker
 
 }  // namespace mrs_uav_trackers
@@ -8,6 +8,7 @@
 
 #include <mrs_msgs/Vec1.h>
 #include <mrs_msgs/UavState.h>
+#include <mrs_msgs/Float64Stamped.h>
 #include <mrs_msgs/VelocityReferenceSrv.h>
 
 #include <mrs_lib/param_loader.h>
@@ -17,6 +18,10 @@
 #include <mrs_lib/utils.h>
 #include <mrs_lib/geometry/cyclic.h>
 #include <mrs_lib/geometry/misc.h>
+#include <mrs_lib/subscribe_handler.h>
+
+#include <mrs_uav_trackers/motion_profiles.h>
+#include <mrs_uav_trackers/position_command_pool.h>
 
 //}
 
@@ -42,25 +47,18 @@ namespace mrs_uav_trackers
 namespace landoff_tracker
 {
 
+
 /* //{ class LandoffTracker */
 
-// state machine
-typedef enum
+// the full-state reference produced by the tracker
+struct Reference_t
 {
-
-  IDLE_STATE,
-  LANDED_STATE,
-  STOP_MOTION_STATE,
-  HOVER_STATE,
-  ACCELERATING_STATE,
-  DECELERATING_STATE,
-  STOPPING_STATE,
-
-} States_t;
-
-const char* state_names[7] = {
-
-    "IDLING", "LANDED", "STOPPING_MOTION", "HOVERING", "ACCELERATING", "DECELERATING", "STOPPING"};
+  double x = 0, y = 0, z = 0;
+  double vel_x = 0, vel_y = 0, vel_z = 0;
+  double acc_x = 0, acc_y = 0, acc_z = 0;
+  double jerk_x = 0, jerk_y = 0, jerk_z = 0;
+  double heading = 0, heading_rate = 0;
+};
 
 class LandoffTracker : public mrs_uav_managers::Tracker {
 public:
@@ -91,20 +89,12 @@ public:
 private:
   bool callbacks_enabled_ = true;
 
-  mrs_msgs::AttitudeCommand last_attitude_cmd_;
-  std::mutex                mutex_last_attitude_cmd_;
-
   std::string     _version_;
   ros::NodeHandle nh_;
   std::string     _uav_name_;
 
   std::shared_ptr<mrs_uav_managers::CommonHandlers_t> common_handlers_;
 
-  // main timer
-  void       timerMain(const ros::TimerEvent& event);
-  ros::Timer timer_main_;
-  std::mutex mutex_main_timer_;
-
   // | ------------------------ uav state ----------------------- |
 
   mrs_msgs::UavState uav_state_;
@@ -113,37 +103,17 @@ private:
 
   // | ---------------- the tracker's inner state --------------- |
 
-  int    _main_timer_rate_;
   double _landing_reference_;
-  double _tracker_dt_;
   bool   is_initialized_ = false;
   bool   is_active_      = false;
 
   bool   _takeoff_disable_lateral_gains_ = false;
   double _takeoff_disable_lateral_gains_height_;
 
-  // | --------------- the tracker's state machine -------------- |
-
-  States_t current_state_vertical_    = IDLE_STATE;
-  States_t previous_state_vertical_   = IDLE_STATE;
-  States_t current_state_horizontal_  = IDLE_STATE;
-  States_t previous_state_horizontal_ = IDLE_STATE;
-
-  void changeStateHorizontal(States_t new_state);
-  void changeStateVertical(States_t new_state);
-  void changeState(States_t new_state);
-
   std::atomic<bool> taking_off_ = false;
   std::atomic<bool> landing_    = false;
   std::atomic<bool> elanding_   = false;
 
-  void stopHorizontalMotion(void);
-  void stopVerticalMotion(void);
-  void accelerateVertical(void);
-  void decelerateVertical(void);
-  void stopHorizontal(void);
-  void stopVertical(void);
-
   // | --------------- takeoff / landing services --------------- |
 
   ros::ServiceServer service_takeoff_;
@@ -168,28 +138,80 @@ private:
   double _landing_acceleration_;
   double _elanding_acceleration_;
 
+  double _horizontal_jerk_;
+  double _vertical_jerk_;
+  double _takeoff_jerk_;
+  double _landing_jerk_;
+  double _elanding_jerk_;
+
   double _heading_rate_;
   double _heading_gain_;
 
   double _max_position_difference_;
+  double _takeoff_time_scale_rate_;
+  double _takeoff_time_scale_acceleration_;
+
+  // | ------------------------- landing ------------------------ |
+
+  bool   _landing_fast_descent_enabled_;
+  double _landing_fast_descent_speed_;
+  double _landing_fast_descent_acceleration_;
+  double _landing_fast_descent_jerk_;
+  double _landing_slow_height_;
+  double _landing_height_timeout_;
+  double _landing_touchdown_mass_factor_;
+
+  mrs_lib::SubscribeHandler<mrs_msgs::Float64Stamped> sh_height_;
+
+  double    landing_ground_z_     = 0;  // the ground used for planning the current landing
+  bool      landing_got_ground_   = false;
+  bool      landing_fast_descent_ = false;
+  double    landing_slow_time_    = 0;  // [s] the motion time when the final slow phase starts
+  bool      landing_touchdown_    = false;
+  double    landing_touchdown_z_  = 0;  // the reference height frozen at the touchdown
+  double    landing_mass_         = 0;  // the total mass estimated by the controller when the landing started
+  ros::Time landing_start_time_;
+
+  std::optional<double> heightAboveGround(void);
+  void                  startLanding(const ros::Time& time);
 
   // | -------------------------- goal -------------------------- |
 
-  double            goal_x_, goal_y_, goal_z_, goal_heading_;
+  double            goal_z_, goal_heading_;
   std::atomic<bool> have_goal_ = false;
-  std::mutex        mutex_goal_;
-
-  // | ---------------- tracker's internal state ---------------- |
 
-  double     state_x_, state_y_, state_z_, state_heading_;
-  double     speed_x_, speed_y_, speed_heading_;
-  double     current_heading_, current_vertical_direction_, current_vertical_speed_, current_horizontal_speed_;
-  double     current_horizontal_acceleration_, current_vertical_acceleration_;
+  // | -------------------- the planned motion ------------------ |
+
+  // stopping the previous motion, followed by the vertical transition
+  // (takeoff or landing), both evaluated in closed form
+  ros::Time      motion_start_time_;
+  ros::Time      last_update_time_;
+  double         motion_time_  = 0;  // [s] the time within the motion evaluated during the last update()
+  double         motion_scale_      = 1;  // the rate of the motion time, lowered while waiting for the controller during takeoff
+  double         motion_scale_rate_ = 0;  // [1/s] the rate of change of the motion scale
+  double         stop_origin_x_, stop_origin_y_, stop_direction_;
+  SCurveProfile  stop_horizontal_;
+  SCurveProfile  stop_vertical_;
+  SCurveProfile  goto_vertical_;
+  double         goto_start_ = 0;  // [s] the motion time when the vertical motion to the goal starts
+  HeadingProfile heading_profile_;
+
+  // | ------------------- takeoff statistics ------------------- |
+
+  ros::Time takeoff_start_time_;
+  int       takeoff_saturation_events_ = 0;
+  bool      takeoff_saturated_         = false;
+
+  // guards the goal and the planned motion
   std::mutex mutex_state_;
 
-  // | -------------------- tracker's output -------------------- |
+  void        planMotion(const Reference_t& initial, const ros::Time& time);
+  Reference_t sampleMotion(const double t);
+  double      stopDuration(void);
+
+  // | ------------------------- output ------------------------- |
 
-  mrs_msgs::PositionCommand position_output_;
+  PositionCommandPool position_cmd_pool_;
 
   // | ------------------------ profiler ------------------------ |
 
@@ -247,14 +269,28 @@ void LandoffTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused
   param_loader.loadParam("vertical_tracker/elanding_speed", _elanding_speed_);
   param_loader.loadParam("vertical_tracker/elanding_acceleration", _elanding_acceleration_);
 
+  param_loader.loadParam("horizontal_tracker/horizontal_jerk", _horizontal_jerk_);
+  param_loader.loadParam("vertical_tracker/vertical_jerk", _vertical_jerk_);
+  param_loader.loadParam("vertical_tracker/takeoff_jerk", _takeoff_jerk_);
+  param_loader.loadParam("vertical_tracker/landing_jerk", _landing_jerk_);
+  param_loader.loadParam("vertical_tracker/elanding_jerk", _elanding_jerk_);
+
   param_loader.loadParam("heading_tracker/heading_rate", _heading_rate_);
   param_loader.loadParam("heading_tracker/heading_gain", _heading_gain_);
 
-  param_loader.loadParam("main_timer_rate", _main_timer_rate_);
-
   param_loader.loadParam("landing_reference", _landing_reference_);
 
   param_loader.loadParam("max_position_difference", _max_position_difference_);
+  param_loader.loadParam("takeoff_time_scale_rate", _takeoff_time_scale_rate_);
+  param_loader.loadParam("takeoff_time_scale_acceleration", _takeoff_time_scale_acceleration_);
+
+  param_loader.loadParam("landing/fast_descent/enabled", _landing_fast_descent_enabled_);
+  param_loader.loadParam("landing/fast_descent/speed", _landing_fast_descent_speed_);
+  param_loader.loadParam("landing/fast_descent/acceleration", _landing_fast_descent_acceleration_);
+  param_loader.loadParam("landing/fast_descent/jerk", _landing_fast_descent_jerk_);
+  param_loader.loadParam("landing/slow_height", _landing_slow_height_);
+  param_loader.loadParam("landing/height_timeout", _landing_height_timeout_);
+  param_loader.loadParam("landing/touchdown_mass_factor", _landing_touchdown_mass_factor_);
 
   param_loader.loadParam("takeoff_disable_lateral_gains", _takeoff_disable_lateral_gains_);
   param_loader.loadParam("takeoff_disable_lateral_gains_height", _takeoff_disable_lateral_gains_height_);
@@ -264,33 +300,6 @@ void LandoffTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused
     ros::shutdown();
   }
 
-  _tracker_dt_ = 1.0 / double(_main_timer_rate_);
-
-  ROS_INFO("[LandoffTracker]: tracker_dt: %f", _tracker_dt_);
-
-  state_x_       = 0;
-  state_y_       = 0;
-  state_z_       = 0;
-  state_heading_ = 0;
-
-  speed_x_       = 0;
-  speed_y_       = 0;
-  speed_heading_ = 0;
-
-  current_horizontal_speed_ = 0;
-  current_vertical_speed_   = 0;
-
-  current_horizontal_acceleration_ = 0;
-  current_vertical_acceleration_   = 0;
-
-  current_vertical_direction_ = 0;
-
-  current_state_vertical_  = LANDED_STATE;
-  previous_state_vertical_ = LANDED_STATE;
-
-  current_state_horizontal_  = LANDED_STATE;
-  previous_state_horizontal_ = LANDED_STATE;
-
   // | ------------------------ profiler ------------------------ |
 
   profiler_ = mrs_lib::Profiler(nh_, "LandoffTracker", _profiler_enabled_);
@@ -301,9 +310,17 @@ void LandoffTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused
   service_land_    = nh_.advertiseService("land_in", &LandoffTracker::callbackLand, this);
   service_eland_   = nh_.advertiseService("eland_in", &LandoffTracker::callbackELand, this);
 
-  // | ------------------------- timers ------------------------- |
+  // | ----------------------- subscribers ---------------------- |
+
+  mrs_lib::SubscribeHandlerOptions shopts;
+  shopts.nh              = nh_;
+  shopts.node_name       = "LandoffTracker";
+  shopts.threadsafe      = true;
+  shopts.autostart       = true;
+  shopts.transport_hints = ros::TransportHints().tcpNoDelay();
 
-  timer_main_ = nh_.createTimer(ros::Rate(_main_timer_rate_), &LandoffTracker::timerMain, this, false, false);
+  // the height above ground, e.g., from a rangefinder-based estimator
+  sh_height_ = mrs_lib::SubscribeHandler<mrs_msgs::Float64Stamped>(shopts, "height_in");
 
   // | ----------------------- finish init ---------------------- |
 
@@ -346,86 +363,34 @@ std::tuple<bool, std::string> LandoffTracker::activate([[maybe_unused]] const mr
   // |                      initial condition                     |
   // --------------------------------------------------------------
 
-  {
-    std::scoped_lock lock(mutex_goal_);
-
-    // the last command is usable
-    state_x_       = uav_state.pose.position.x;
-    state_y_       = uav_state.pose.position.y;
-    state_z_       = uav_state.pose.position.z;
-    state_heading_ = uav_heading;
-
-    speed_x_         = uav_state.velocity.linear.x;
-    speed_y_         = uav_state.velocity.linear.y;
-    current_heading_ = atan2(speed_y_, speed_x_);
-
-    current_horizontal_speed_ = sqrt(pow(speed_x_, 2) + pow(speed_y_, 2));
-
-    current_vertical_speed_     = fabs(uav_state.velocity.linear.z);
-    current_vertical_direction_ = uav_state.velocity.linear.z > 0 ? +1 : -1;
-
-    current_horizontal_acceleration_ = 0;
-    current_vertical_acceleration_   = 0;
-
-    goal_heading_ = uav_heading;
-
-    ROS_INFO("[LandoffTracker]: initial condition: x: %.2f, y: %.2f, z: %.2f, heading: %.2f", state_x_, state_y_, state_z_, state_heading_);
-  }
-
-  // --------------------------------------------------------------
-  // |          horizontal initial conditions prediction          |
-  // --------------------------------------------------------------
-
-  double horizontal_t_stop, horizontal_stop_dist, stop_dist_x, stop_dist_y;
-
-  {
-    std::scoped_lock lock(mutex_state_);
+  Reference_t initial;
 
-    horizontal_t_stop    = current_horizontal_speed_ / _horizontal_acceleration_;
-    horizontal_stop_dist = (horizontal_t_stop * current_horizontal_speed_) / 2.0;
-    stop_dist_x          = cos(current_heading_) * horizontal_stop_dist;
-    stop_dist_y          = sin(current_heading_) * horizontal_stop_dist;
-  }
+  initial.x       = uav_state.pose.position.x;
+  initial.y       = uav_state.pose.position.y;
+  initial.z       = uav_state.pose.position.z;
+  initial.heading = uav_heading;
 
-  // --------------------------------------------------------------
-  // |           vertical initial conditions prediction           |
-  // --------------------------------------------------------------
+  initial.vel_x = uav_state.velocity.linear.x;
+  initial.vel_y = uav_state.velocity.linear.y;
+  initial.vel_z = uav_state.velocity.linear.z;
 
-  double vertical_t_stop, vertical_stop_dist;
-
-  {
-    std::scoped_lock lock(mutex_state_);
-
-    vertical_t_stop    = current_vertical_speed_ / _vertical_acceleration_;
-    vertical_stop_dist = current_vertical_direction_ * (vertical_t_stop * current_vertical_speed_) / 2.0;
-  }
-
-  // --------------------------------------------------------------
-  // |               heading initial condition prediction             |
-  // --------------------------------------------------------------
-
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_);
-
-    goal_x_ = state_x_ + stop_dist_x;
-    goal_y_ = state_y_ + stop_dist_y;
-    goal_z_ = state_z_ + vertical_stop_dist;
-  }
+  ROS_INFO("[LandoffTracker]: initial condition: x: %.2f, y: %.2f, z: %.2f, heading: %.2f", initial.x, initial.y, initial.z, initial.heading);
 
   landing_    = false;
   taking_off_ = false;
-  is_active_  = true;
   have_goal_  = false;
 
-  timer_main_.start();
-
   {
-    std::scoped_lock lock(mutex_goal_);
+    std::scoped_lock lock(mutex_state_);
+
+    goal_heading_ = uav_heading;
 
-    ROS_INFO("[LandoffTracker]: stopping goal: x: %.2f, y: %.2f, z: %.2f, heading: %.2f", goal_x_, goal_y_, goal_z_, goal_heading_);
+    planMotion(initial, ros::Time::now());
+
+    ROS_INFO("[LandoffTracker]: stopping goal: z: %.2f, heading: %.2f", goal_z_, goal_heading_);
   }
 
-  changeState(STOP_MOTION_STATE);
+  is_active_ = true;
 
   ss << "activated";
   ROS_INFO_STREAM("[LandoffTracker]: " << ss.str());
@@ -439,13 +404,9 @@ std::tuple<bool, std::string> LandoffTracker::activate([[maybe_unused]] const mr
 
 void LandoffTracker::deactivate(void) {
 
-  is_active_                = false;
-  landing_                  = false;
-  taking_off_               = false;
-  current_state_vertical_   = IDLE_STATE;
-  current_state_horizontal_ = IDLE_STATE;
-
-  timer_main_.stop();
+  is_active_  = false;
+  landing_    = false;
+  taking_off_ = false;
 
   ROS_INFO("[LandoffTracker]: deactivated");
 }
@@ -482,49 +443,234 @@ const mrs_msgs::PositionCommand::ConstPtr LandoffTracker::update(const mrs_msgs:
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  position_output_.header.stamp    = ros::Time::now();
-  position_output_.header.frame_id = uav_state_.header.frame_id;
+  ros::Time now = ros::Time::now();
+
+  double uav_x = uav_state->pose.position.x;
+  double uav_y = uav_state->pose.position.y;
+  double uav_z = uav_state->pose.position.z;
+
+  Reference_t reference;
+  bool        takeoff_finished = false;
 
   {
     std::scoped_lock lock(mutex_state_);
 
-    position_output_.position.x = state_x_;
-    position_output_.position.y = state_y_;
-    position_output_.position.z = state_z_;
-    position_output_.heading    = state_heading_;
-
-    position_output_.velocity.x   = cos(current_heading_) * current_horizontal_speed_;
-    position_output_.velocity.y   = sin(current_heading_) * current_horizontal_speed_;
-    position_output_.velocity.z   = current_vertical_direction_ * current_vertical_speed_;
-    position_output_.heading_rate = speed_heading_;
-
-    position_output_.use_position_vertical   = 1;
-    position_output_.use_position_horizontal = 1;
-    position_output_.use_heading             = 1;
-    position_output_.use_heading_rate        = 1;
-    position_output_.use_velocity_vertical   = 1;
-    position_output_.use_velocity_horizontal = 1;
+    double dt         = std::max((now - last_update_time_).toSec(), 0.0);
+    last_update_time_ = now;
+
+    // the second derivative of the motion scale
+    double scale_acceleration = 0;
+
+    // --------------------------------------------------------------
+    // |              motion saturation during takeoff              |
+    // --------------------------------------------------------------
+
+    if (taking_off_) {
+
+      reference = sampleMotion(motion_time_);
+
+      double err_x      = uav_x - reference.x;
+      double err_y      = uav_y - reference.y;
+      double err_z      = uav_z - reference.z;
+      double error_size = sqrt(pow(err_x, 2) + pow(err_y, 2) + pow(err_z, 2));
+
+      // if the reference would move further from the UAV while the control error is already over the threshold
+      bool saturated = error_size > _max_position_difference_ && (reference.vel_x * err_x + reference.vel_y * err_y + reference.vel_z * err_z) < 0;
+
+      if (saturated) {
+
+        ROS_WARN_THROTTLE(
+            0.1, "[LandoffTracker]: position difference %.3f > %.3f, saturating the motion. Reference: x=%.2f, y=%.2f, z=%.2f, Odometry: %.2f, %.2f, %.2f",
+            error_size, _max_position_difference_, reference.x, reference.y, reference.z, uav_x, uav_y, uav_z);
+
+        if (!takeoff_saturated_) {
+          takeoff_saturation_events_++;
+        }
+      }
+
+      takeoff_saturated_ = saturated;
+
+      if (last_attitude_cmd && last_attitude_cmd->ramping_up) {
+
+        // hold the motion completely while the controller ramps up, the reference is still at rest at that time
+        ROS_INFO_THROTTLE(1.0, "[LandoffTracker]: waiting for the controller to rampup");
+        motion_scale_      = 0;
+        motion_scale_rate_ = 0;
+
+      } else {
+
+        // slow down the motion when saturated => the tracker will wait for the controller
+        double rate_target = saturated ? -_takeoff_time_scale_rate_ : _takeoff_time_scale_rate_;
+
+        // the rate of the scale is changed gradually, so the feed forward acceleration stays continuous,
+        // and it is brought to zero in time to reach the bounds of the scale
+        double braking_distance = pow(motion_scale_rate_, 2) / (2.0 * _takeoff_time_scale_acceleration_);
+
+        if ((rate_target > 0 && motion_scale_ + braking_distance >= 1.0) || (rate_target < 0 && motion_scale_ - braking_distance <= 0.0)) {
+          rate_target = 0;
+        }
+
+        double max_change = _takeoff_time_scale_acceleration_ * dt;
+        double scale_rate = motion_scale_rate_ + std::clamp(rate_target - motion_scale_rate_, -max_change, max_change);
+
+        if (dt > 0) {
+          scale_acceleration = (scale_rate - motion_scale_rate_) / dt;
+        }
+
+        motion_scale_rate_ = scale_rate;
+        motion_scale_      = std::clamp(motion_scale_ + motion_scale_rate_ * dt, 0.0, 1.0);
+      }
+
+    } else {
+
+      motion_scale_      = 1;
+      motion_scale_rate_ = 0;
+    }
+
+    // the reference is evaluated in closed form at the (possibly slowed down) motion time
+    motion_time_ += motion_scale_ * dt;
+
+    reference = sampleMotion(motion_time_);
+
+    // the derivatives w.r.t. the real time
+    double s     = motion_scale_;
+    double s_dot = motion_scale_rate_;
+
+    reference.jerk_x = reference.jerk_x * s * s * s + 3 * reference.acc_x * s * s_dot + reference.vel_x * scale_acceleration;
+    reference.jerk_y = reference.jerk_y * s * s * s + 3 * reference.acc_y * s * s_dot + reference.vel_y * scale_acceleration;
+    reference.jerk_z = reference.jerk_z * s * s * s + 3 * reference.acc_z * s * s_dot + reference.vel_z * scale_acceleration;
+
+    reference.acc_x = reference.acc_x * s * s + reference.vel_x * s_dot;
+    reference.acc_y = reference.acc_y * s * s + reference.vel_y * s_dot;
+    reference.acc_z = reference.acc_z * s * s + reference.vel_z * s_dot;
+
+    reference.vel_x *= s;
+    reference.vel_y *= s;
+    reference.vel_z *= s;
+
+    reference.heading_rate *= s;
+
+    double motion_duration = goto_start_ + goto_vertical_.duration();
+
+    if (taking_off_ && motion_time_ >= motion_duration) {
+
+      takeoff_finished = true;
+
+      ROS_INFO("[LandoffTracker]: takeoff finished in %.2f s (%.2f s planned), %d saturation events", (now - takeoff_start_time_).toSec(), motion_duration,
+               takeoff_saturation_events_);
+    }
   }
 
-  {
-    std::scoped_lock lock(mutex_last_attitude_cmd_);
+  if (takeoff_finished) {
+
+    taking_off_ = false;
+    have_goal_  = false;
+  }
+
+  // --------------------------------------------------------------
+  // |                      landing setpoint                      |
+  // --------------------------------------------------------------
+
+  if (landing_) {
+
+    std::scoped_lock lock(mutex_state_);
+
+    if (landing_fast_descent_) {
+
+      std::optional<double> height = heightAboveGround();
+
+      if (motion_time_ >= landing_slow_time_) {
+
+        landing_fast_descent_ = false;
+
+        ROS_INFO("[LandoffTracker]: fast descent finished after %.2f s, continuing slowly", (now - landing_start_time_).toSec());
+
+      } else if (height && height.value() < _landing_slow_height_) {
+
+        // the ground is closer than expected, continue slowly without stopping the descent
+        ROS_WARN("[LandoffTracker]: height %.2f m is below %.2f m during the fast descent, slowing down", height.value(), _landing_slow_height_);
+
+        landing_ground_z_ = uav_z - height.value();
 
-    last_attitude_cmd_ = *last_attitude_cmd;
+        planMotion(sampleMotion(motion_time_), now);
+      }
+    }
+
+    // | ------------------- touchdown detection ------------------ |
+
+    // the ground takes over the weight of the UAV, so the mass estimated by the controller drops
+    if (!landing_touchdown_ && last_attitude_cmd) {
+
+      if (landing_mass_ <= 0) {
+        landing_mass_ = last_attitude_cmd->total_mass;
+      } else if (last_attitude_cmd->total_mass < _landing_touchdown_mass_factor_ * landing_mass_) {
+
+        landing_touchdown_   = true;
+        landing_touchdown_z_ = std::max(reference.z, uav_z + _landing_reference_);
+
+        ROS_INFO("[LandoffTracker]: touchdown detected after %.2f s of landing", (now - landing_start_time_).toSec());
+      }
+    }
+
+    // stop pushing the reference down
+    if (landing_touchdown_) {
+      reference.z      = landing_touchdown_z_;
+      reference.vel_z  = 0;
+      reference.acc_z  = 0;
+      reference.jerk_z = 0;
+    }
+  }
+
+  // the reference should not get further than landing_reference below the UAV
+  if (landing_) {
+    reference.z = std::max(reference.z, uav_z + _landing_reference_);
   }
 
-  if (_takeoff_disable_lateral_gains_ && taking_off_ && uav_state_.pose.position.z < _takeoff_disable_lateral_gains_height_) {
-    position_output_.disable_position_gains = true;
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+  position_cmd->header.stamp    = now;
+  position_cmd->header.frame_id = uav_state->header.frame_id;
+
+  position_cmd->position.x = reference.x;
+  position_cmd->position.y = reference.y;
+  position_cmd->position.z = reference.z;
+  position_cmd->heading    = reference.heading;
+
+  position_cmd->velocity.x   = reference.vel_x;
+  position_cmd->velocity.y   = reference.vel_y;
+  position_cmd->velocity.z   = reference.vel_z;
+  position_cmd->heading_rate = reference.heading_rate;
+
+  position_cmd->acceleration.x = reference.acc_x;
+  position_cmd->acceleration.y = reference.acc_y;
+  position_cmd->acceleration.z = reference.acc_z;
+
+  position_cmd->jerk.x = reference.jerk_x;
+  position_cmd->jerk.y = reference.jerk_y;
+  position_cmd->jerk.z = reference.jerk_z;
+
+  position_cmd->use_position_vertical   = 1;
+  position_cmd->use_position_horizontal = 1;
+  position_cmd->use_heading             = 1;
+  position_cmd->use_heading_rate        = 1;
+  position_cmd->use_velocity_vertical   = 1;
+  position_cmd->use_velocity_horizontal = 1;
+  position_cmd->use_acceleration        = 1;
+  position_cmd->use_jerk                = 1;
+
+  if (_takeoff_disable_lateral_gains_ && taking_off_ && uav_z < _takeoff_disable_lateral_gains_height_) {
+    position_cmd->disable_position_gains = true;
   } else {
-    position_output_.disable_position_gains = false;
+    position_cmd->disable_position_gains = false;
   }
 
   if (taking_off_) {
-    position_output_.disable_antiwindups = true;
+    position_cmd->disable_antiwindups = true;
   } else {
-    position_output_.disable_antiwindups = false;
+    position_cmd->disable_antiwindups = false;
   }
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_output_));
+  return position_cmd;
 }
 
 //}
@@ -538,10 +684,15 @@ const mrs_msgs::TrackerStatus LandoffTracker::getStatus() {
   tracker_status.active            = is_active_;
   tracker_status.callbacks_enabled = callbacks_enabled_;
 
-  bool hovering = current_state_vertical_ == HOVER_STATE && current_state_horizontal_ == HOVER_STATE;
-  bool idling   = current_state_vertical_ == IDLE_STATE && current_state_horizontal_ == IDLE_STATE;
+  bool moving;
 
-  tracker_status.have_goal = landing_ || taking_off_ || !(hovering || idling);
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    moving = motion_time_ < goto_start_ + goto_vertical_.duration();
+  }
+
+  tracker_status.have_goal = landing_ || taking_off_ || moving;
 
   tracker_status.tracking_trajectory = false;
 
@@ -582,7 +733,7 @@ const std_srvs::SetBoolResponse::ConstPtr LandoffTracker::enableCallbacks(const
 
 const std_srvs::TriggerResponse::ConstPtr LandoffTracker::switchOdometrySource(const mrs_msgs::UavState::ConstPtr& new_uav_state) {
 
-  std::scoped_lock lock(mutex_goal_, mutex_state_);
+  std::scoped_lock lock(mutex_state_);
 
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
@@ -621,19 +772,21 @@ const std_srvs::TriggerResponse::ConstPtr LandoffTracker::switchOdometrySource(c
   double dz       = new_uav_state->pose.position.z - uav_state.pose.position.z;
   double dheading = new_heading - old_heading;
 
-  goal_x_ += dx;
-  goal_y_ += dy;
   goal_z_ += dz;
   goal_heading_ += dheading;
 
-  // | -------------------- update the state -------------------- |
+  landing_ground_z_ += dz;
+  landing_touchdown_z_ += dz;
+
+  // | ----------------- translate the motion ------------------ |
+
+  stop_origin_x_ += dx;
+  stop_origin_y_ += dy;
 
-  state_x_ += dx;
-  state_y_ += dy;
-  state_z_ += dz;
-  state_heading_ += dheading;
+  stop_vertical_.translate(dz);
+  goto_vertical_.translate(dz);
 
-  current_heading_ = atan2(goal_y_ - state_y_, goal_x_ - state_x_);
+  heading_profile_.translate(dheading);
 
   res.message = "odometry source switched";
   res.success = true;
@@ -644,60 +797,32 @@ const std_srvs::TriggerResponse::ConstPtr LandoffTracker::switchOdometrySource(c
 //}
 
 /* //{ hover() */
-const std_srvs::TriggerResponse::ConstPtr LandoffTracker::hover([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr& cmd) {
 
-  std::scoped_lock lock(mutex_main_timer_);
+const std_srvs::TriggerResponse::ConstPtr LandoffTracker::hover([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr& cmd) {
 
   // copy member variables
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
-  auto [current_horizontal_speed, current_vertical_speed, current_heading, current_vertical_direction] =
-      mrs_lib::get_mutexed(mutex_state_, current_horizontal_speed_, current_vertical_speed_, current_heading_, current_vertical_direction_);
-
   std_srvs::TriggerResponse res;
 
-  // --------------------------------------------------------------
-  // |          horizontal initial conditions prediction          |
-  // --------------------------------------------------------------
   {
     std::scoped_lock lock(mutex_state_);
 
-    current_horizontal_speed_ = sqrt(pow(uav_state.velocity.linear.x, 2) + pow(uav_state.velocity.linear.y, 2));
-    current_vertical_speed_   = uav_state.velocity.linear.z;
-    current_heading_          = atan2(uav_state.velocity.linear.y, uav_state.velocity.linear.x);
-  }
-
-  double horizontal_t_stop, horizontal_stop_dist, stop_dist_x, stop_dist_y;
+    // stop from the current velocity of the UAV
+    Reference_t initial = sampleMotion(motion_time_);
 
-  horizontal_t_stop    = current_horizontal_speed / _horizontal_acceleration_;
-  horizontal_stop_dist = (horizontal_t_stop * current_horizontal_speed) / 2.0;
-  stop_dist_x          = cos(current_heading) * horizontal_stop_dist;
-  stop_dist_y          = sin(current_heading) * horizontal_stop_dist;
-
-  // --------------------------------------------------------------
-  // |           vertical initial conditions prediction           |
-  // --------------------------------------------------------------
-
-  double vertical_t_stop    = current_vertical_speed / _vertical_acceleration_;
-  double vertical_stop_dist = current_vertical_direction * (vertical_t_stop * current_vertical_speed) / 2.0;
-
-  // --------------------------------------------------------------
-  // |                        set the goal                        |
-  // --------------------------------------------------------------
+    initial.vel_x = uav_state.velocity.linear.x;
+    initial.vel_y = uav_state.velocity.linear.y;
+    initial.vel_z = uav_state.velocity.linear.z;
 
-  {
-    std::scoped_lock lock(mutex_state_, mutex_goal_);
+    have_goal_ = false;
 
-    goal_x_ = state_x_ + stop_dist_x;
-    goal_y_ = state_y_ + stop_dist_y;
-    goal_z_ = state_z_ + vertical_stop_dist;
+    planMotion(initial, ros::Time::now());
   }
 
   res.message = "hover initiated";
   res.success = true;
 
-  changeState(STOP_MOTION_STATE);
-
   return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
@@ -781,541 +906,232 @@ const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr LandoffTracker::setTraj
 
 //}
 
-// | ----------------- state machine routines ----------------- |
-
-/* //{ changeStateHorizontal() */
-
-void LandoffTracker::changeStateHorizontal(States_t new_state) {
-
-  previous_state_horizontal_ = current_state_horizontal_;
-  current_state_horizontal_  = new_state;
-
-  switch (current_state_horizontal_) {
-
-    case STOPPING_STATE: {
-
-      std::scoped_lock lock(mutex_state_);
-      current_horizontal_speed_ = 0;
-
-      break;
-    };
-
-    default: {
-
-      break;
-    }
-  }
-
-  ROS_INFO("[LandoffTracker]: Switching horizontal state %s -> %s", state_names[previous_state_horizontal_], state_names[current_state_horizontal_]);
-}
-
-//}
-
-/* //{ changeStateVertical() */
-
-void LandoffTracker::changeStateVertical(States_t new_state) {
-
-  previous_state_vertical_ = current_state_vertical_;
-  current_state_vertical_  = new_state;
-
-  switch (current_state_vertical_) {
-
-    case HOVER_STATE: {
-      taking_off_ = false;
-      break;
-    }
-
-    default: {
-      break;
-    }
-  }
-
-  ROS_INFO("[LandoffTracker]: Switching vertical state %s -> %s", state_names[previous_state_vertical_], state_names[current_state_vertical_]);
-}
-
-//}
-
-/* //{ changeState() */
-
-void LandoffTracker::changeState(States_t new_state) {
-
-  changeStateVertical(new_state);
-  changeStateHorizontal(new_state);
-}
-
-//}
-
 // | --------------------- motion routines -------------------- |
 
-/* //{ stopHorizontalMotion() */
+/* //{ planMotion() */
 
-void LandoffTracker::stopHorizontalMotion(void) {
+// plans the stopping from the initial state followed by the vertical motion to the goal
+// (takeoff, landing), should be called with mutex_state_ locked
+void LandoffTracker::planMotion(const Reference_t& initial, const ros::Time& time) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
 
-    current_horizontal_speed_ -= _horizontal_acceleration_ * _tracker_dt_;
+  motion_start_time_ = time;
+  last_update_time_  = time;
+  motion_time_       = 0;
+  motion_scale_      = 1;
+  motion_scale_rate_ = 0;
 
-    if (current_horizontal_speed_ < 0) {
-      current_horizontal_speed_        = 0;
-      current_horizontal_acceleration_ = 0;
-    } else {
-      current_horizontal_acceleration_ = -_horizontal_acceleration_;
-    }
-  }
-}
-
-//}
-
-/* //{ stopVerticalMotion() */
-
-void LandoffTracker::stopVerticalMotion(void) {
-
-  {
-    std::scoped_lock lock(mutex_state_);
-
-    current_vertical_speed_ -= _vertical_acceleration_ * _tracker_dt_;
-
-    if (current_vertical_speed_ < 0) {
-      current_vertical_speed_        = 0;
-      current_vertical_acceleration_ = 0;
-    } else {
-      current_vertical_acceleration_ = -_vertical_acceleration_;
-    }
-  }
-}
+  // | ------------------ stop the current motion ------------------ |
 
-//}
+  stop_origin_x_  = initial.x;
+  stop_origin_y_  = initial.y;
+  stop_direction_ = atan2(initial.vel_y, initial.vel_x);
 
-/* //{ accelerateVertical() */
+  double horizontal_speed        = sqrt(pow(initial.vel_x, 2) + pow(initial.vel_y, 2));
+  double horizontal_acceleration = cos(stop_direction_) * initial.acc_x + sin(stop_direction_) * initial.acc_y;
 
-void LandoffTracker::accelerateVertical(void) {
+  stop_horizontal_ = SCurveProfile::stop(0.0, horizontal_speed, horizontal_acceleration, _horizontal_acceleration_, _horizontal_jerk_);
+  stop_vertical_   = SCurveProfile::stop(initial.z, initial.vel_z, initial.acc_z, _vertical_acceleration_, _vertical_jerk_);
+  goto_start_      = stopDuration();
 
-  // copy member variables
-  auto [current_vertical_speed, state_z] = mrs_lib::get_mutexed(mutex_state_, current_vertical_speed_, state_z_);
-  auto goal_z                            = mrs_lib::get_mutexed(mutex_goal_, goal_z_);
-  auto constraints                       = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
+  double stopped_z = stop_vertical_.finalState().position;
 
-  double used_acceleration;
-  double used_speed;
+  // | --------------- the vertical motion to the goal -------------- |
 
-  if (taking_off_) {
+  if (have_goal_ && taking_off_) {
 
-    used_speed        = _takeoff_speed_;
-    used_acceleration = _takeoff_acceleration_;
+    double used_speed        = _takeoff_speed_;
+    double used_acceleration = _takeoff_acceleration_;
+    double used_jerk         = _takeoff_jerk_;
 
     if (used_speed > constraints.vertical_ascending_speed) {
       used_speed = constraints.vertical_ascending_speed;
-      ROS_WARN_THROTTLE(1.0, "[LandoffTracker]: saturating takeoff speed");
+      ROS_WARN("[LandoffTracker]: saturating takeoff speed");
     }
 
     if (used_acceleration > constraints.vertical_ascending_acceleration) {
       used_acceleration = constraints.vertical_ascending_acceleration;
-      ROS_WARN_THROTTLE(1.0, "[LandoffTracker]: saturating takeoff acceleration");
+      ROS_WARN("[LandoffTracker]: saturating takeoff acceleration");
     }
 
-  } else if (landing_) {
+    if (used_jerk > constraints.vertical_ascending_jerk) {
+      used_jerk = constraints.vertical_ascending_jerk;
+      ROS_WARN("[LandoffTracker]: saturating takeoff jerk");
+    }
+
+    goto_vertical_ = SCurveProfile::restToRest(stopped_z, goal_z_, used_speed, used_acceleration, used_jerk);
+
+  } else if (have_goal_ && landing_) {
+
+    double used_speed;
+    double used_acceleration;
+    double used_jerk;
 
     if (elanding_) {
 
       used_speed        = _elanding_speed_;
       used_acceleration = _elanding_acceleration_;
+      used_jerk         = _elanding_jerk_;
 
     } else {
 
       used_speed        = _landing_speed_;
       used_acceleration = _landing_acceleration_;
+      used_jerk         = _landing_jerk_;
 
       if (used_speed > constraints.vertical_descending_speed) {
         used_speed = constraints.vertical_descending_speed;
-        ROS_WARN_THROTTLE(1.0, "[LandoffTracker]: saturating landing speed");
+        ROS_WARN("[LandoffTracker]: saturating landing speed");
       }
 
       if (used_acceleration > constraints.vertical_descending_acceleration) {
         used_acceleration = constraints.vertical_descending_acceleration;
-        ROS_WARN_THROTTLE(1.0, "[LandoffTracker]: saturating landing acceleration");
+        ROS_WARN("[LandoffTracker]: saturating landing acceleration");
       }
-    }
-
-  } else {
-
-    // TODO take this from constraints
-    used_speed        = _vertical_speed_;
-    used_acceleration = _vertical_acceleration_;
-  }
-
-  // set the right heading
-  double tar_z = goal_z - state_z;
 
-  // set the right vertical direction
-  {
-    std::scoped_lock lock(mutex_state_);
+      if (used_jerk > constraints.vertical_descending_jerk) {
+        used_jerk = constraints.vertical_descending_jerk;
+        ROS_WARN("[LandoffTracker]: saturating landing jerk");
+      }
+    }
 
-    current_vertical_direction_ = mrs_lib::signum(tar_z);
-  }
+    landing_fast_descent_ = false;
 
-  auto current_vertical_direction = mrs_lib::get_mutexed(mutex_state_, current_vertical_direction_);
+    if (!elanding_ && _landing_fast_descent_enabled_ && landing_got_ground_) {
 
-  // calculate the time to stop and the distance it will take to stop [vertical]
-  double vertical_t_stop    = current_vertical_speed / used_acceleration;
-  double vertical_stop_dist = (vertical_t_stop * current_vertical_speed) / 2.0;
-  double stop_dist_z        = current_vertical_direction * vertical_stop_dist;
+      double fast_speed        = std::min(_landing_fast_descent_speed_, constraints.vertical_descending_speed);
+      double fast_acceleration = std::min(_landing_fast_descent_acceleration_, constraints.vertical_descending_acceleration);
+      double fast_jerk         = std::min(_landing_fast_descent_jerk_, constraints.vertical_descending_jerk);
 
-  {
-    std::scoped_lock lock(mutex_state_);
+      double slow_z = landing_ground_z_ + _landing_slow_height_;
 
-    current_vertical_speed_ += used_acceleration * _tracker_dt_;
+      // descend fast while high enough to slow down to the landing speed in time
+      if (fast_speed > used_speed && stopped_z - slow_z > SCurveProfile::transitionDistance(0.0, used_speed, fast_acceleration, fast_jerk)) {
 
-    if (current_vertical_speed_ >= used_speed) {
-      current_vertical_speed_ -= _vertical_acceleration_ * _tracker_dt_;
-      current_vertical_acceleration_ = 0;
-    } else {
-      current_vertical_acceleration_ = used_acceleration;
-    }
-  }
+        // the final phase continues with the landing speed
+        goto_vertical_ = SCurveProfile::approach(stopped_z, slow_z, used_speed, fast_speed, fast_acceleration, fast_jerk);
 
-  // stopping condition to change to decelerate state
-  //
-  // It does not apply if landing or elanding, cause,
-  // it could potentially stop in mid air if odometry jumps (this happened),
-  // Instead, landing and elanding is stopped by sensing the thrust.
-  if (!elanding_ && !landing_) {
-    if (fabs(state_z + stop_dist_z - goal_z) < (2 * (used_speed * _tracker_dt_))) {
+        double fast_duration = SCurveProfile::transition(stopped_z, slow_z, 0.0, used_speed, fast_speed, fast_acceleration, fast_jerk).duration();
 
-      {
-        std::scoped_lock lock(mutex_state_);
+        landing_fast_descent_ = true;
+        landing_slow_time_    = goto_start_ + fast_duration;
 
-        current_vertical_acceleration_ = 0;
+        ROS_INFO("[LandoffTracker]: descending fast down to %.2f m above the ground, will take %.2f s", _landing_slow_height_, fast_duration);
       }
-
-      changeStateVertical(DECELERATING_STATE);
     }
-  }
-}
-
-//}
-
-/* //{ decelerateVertical() */
-
-void LandoffTracker::decelerateVertical(void) {
-
-  double used_acceleration;
-
-  if (taking_off_) {
-
-    used_acceleration = _takeoff_acceleration_;
 
-  } else if (landing_) {
+    // landing does not stop at any particular height, it is terminated by sensing the thrust
+    if (!landing_fast_descent_) {
 
-    if (elanding_) {
+      if (initial.vel_z <= 0) {
 
-      used_acceleration = _elanding_acceleration_;
+        // already descending (e.g., after the fast descent), continue without stopping first
+        stop_vertical_ = SCurveProfile(initial.z);
+        goto_start_    = 0;
+        goto_vertical_ = SCurveProfile::toVelocity(initial.z, initial.vel_z, initial.acc_z, -used_speed, used_acceleration, used_jerk);
 
-    } else {
+      } else {
 
-      used_acceleration = _landing_acceleration_;
+        goto_vertical_ = SCurveProfile::toVelocity(stopped_z, 0.0, 0.0, -used_speed, used_acceleration, used_jerk);
+      }
     }
 
   } else {
-    used_acceleration = _vertical_acceleration_;
-  }
 
-  {
-    std::scoped_lock lock(mutex_state_);
-
-    current_vertical_speed_ -= used_acceleration * _tracker_dt_;
-
-    if (current_vertical_speed_ < 0) {
-      current_vertical_speed_ = 0;
-    } else {
-      current_vertical_acceleration_ = -used_acceleration;
-    }
-  }
-
-  auto current_vertical_speed = mrs_lib::get_mutexed(mutex_state_, current_vertical_speed_);
-
-  if (current_vertical_speed == 0) {
-
-    {
-      std::scoped_lock lock(mutex_state_);
-
-      current_vertical_acceleration_ = 0;
-    }
-
-    changeStateVertical(STOPPING_STATE);
+    goal_z_        = stopped_z;
+    goto_vertical_ = SCurveProfile(stopped_z);
   }
-}
 
-//}
-
-/* //{ stopHorizontal() */
+  // | ------------------------- heading ------------------------- |
 
-void LandoffTracker::stopHorizontal(void) {
-
-  {
-    std::scoped_lock lock(mutex_state_, mutex_goal_);
-
-    state_x_                         = 0.95 * state_x_ + 0.05 * goal_x_;
-    state_y_                         = 0.95 * state_y_ + 0.05 * goal_y_;
-    current_horizontal_acceleration_ = 0;
-  }
+  heading_profile_ = HeadingProfile(initial.heading, goal_heading_, _heading_gain_, _heading_rate_);
 }
 
 //}
 
-/* //{ stopVertical() */
-
-void LandoffTracker::stopVertical(void) {
+/* //{ stopDuration() */
 
-  {
-    std::scoped_lock lock(mutex_state_, mutex_goal_);
+// should be called with mutex_state_ locked
+double LandoffTracker::stopDuration(void) {
 
-    state_z_                       = 0.95 * state_z_ + 0.05 * goal_z_;
-    current_vertical_acceleration_ = 0;
-  }
+  return std::max(stop_horizontal_.duration(), stop_vertical_.duration());
 }
 
 //}
 
-// | --------------------- timer routines --------------------- |
+/* //{ sampleMotion() */
 
-/* //{ timerMain() */
+// evaluates the planned motion at the time [s] since its start, should be called with mutex_state_ locked
+Reference_t LandoffTracker::sampleMotion(const double t) {
 
-void LandoffTracker::timerMain(const ros::TimerEvent& event) {
+  Reference_t reference;
 
-  std::scoped_lock lock(mutex_main_timer_);
+  ProfileSample_t horizontal = stop_horizontal_.sample(t);
 
-  if (!is_active_) {
-    return;
-  }
-
-  // copy member variables
-  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
-  auto [state_x, state_y, state_z, current_horizontal_speed, current_vertical_speed, current_heading, current_vertical_direction] = mrs_lib::get_mutexed(
-      mutex_state_, state_x_, state_y_, state_z_, current_horizontal_speed_, current_vertical_speed_, current_heading_, current_vertical_direction_);
-  auto [goal_x, goal_y, goal_z] = mrs_lib::get_mutexed(mutex_goal_, goal_x_, goal_y_, goal_z_);
-  auto last_attitude_cmd        = mrs_lib::get_mutexed(mutex_last_attitude_cmd_, last_attitude_cmd_);
+  reference.x      = stop_origin_x_ + cos(stop_direction_) * horizontal.position;
+  reference.y      = stop_origin_y_ + sin(stop_direction_) * horizontal.position;
+  reference.vel_x  = cos(stop_direction_) * horizontal.velocity;
+  reference.vel_y  = sin(stop_direction_) * horizontal.velocity;
+  reference.acc_x  = cos(stop_direction_) * horizontal.acceleration;
+  reference.acc_y  = sin(stop_direction_) * horizontal.acceleration;
+  reference.jerk_x = cos(stop_direction_) * horizontal.jerk;
+  reference.jerk_y = sin(stop_direction_) * horizontal.jerk;
 
-  double uav_x, uav_y, uav_z;
-  uav_x = uav_state.pose.position.x;
-  uav_y = uav_state.pose.position.y;
-  uav_z = uav_state.pose.position.z;
+  ProfileSample_t vertical = t < goto_start_ ? stop_vertical_.sample(t) : goto_vertical_.sample(t - goto_start_);
 
-  mrs_lib::Routine    profiler_routine = profiler_.createRoutine("main", _main_timer_rate_, 0.002, event);
-  mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("LandoffTracker::main", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
+  reference.z      = vertical.position;
+  reference.vel_z  = vertical.velocity;
+  reference.acc_z  = vertical.acceleration;
+  reference.jerk_z = vertical.jerk;
 
-  bool takeoff_saturated = false;
+  heading_profile_.sample(t, reference.heading, reference.heading_rate);
 
-  if (taking_off_) {
-
-    // calculate the vector
-    double err_x      = uav_x - state_x;
-    double err_y      = uav_y - state_y;
-    double err_z      = uav_z - state_z;
-    double error_size = sqrt(pow(err_x, 2) + pow(err_y, 2) + pow(err_z, 2));
-
-    if (error_size > _max_position_difference_) {
-
-      // calculate the potential next step
-      double future_state_x = state_x + cos(current_heading) * current_horizontal_speed * _tracker_dt_;
-      double future_state_y = state_y + sin(current_heading) * current_horizontal_speed * _tracker_dt_;
-      double future_state_z = state_z + current_vertical_direction * current_vertical_speed * _tracker_dt_;
-
-      // if the step would lead to a greater control error than the threshold
-      if (mrs_lib::geometry::dist(vec3_t(future_state_x, future_state_y, future_state_z), vec3_t(uav_x, uav_y, uav_z)) > error_size) {
-
-        // set this to true... later, we will not update the model if this is true, thus the tracker's motion will stop
-        // => the tracker will wait for the controller
-        takeoff_saturated = true;
-
-        ROS_WARN_THROTTLE(
-            0.1, "[LandoffTracker]: position difference %.3f > %.3f, saturating the motion. Reference: x=%.2f, y=%.2f, z=%.2f, Odometry: %.2f, %.2f, %.2f",
-            error_size, _max_position_difference_, future_state_x, future_state_y, future_state_z, uav_x, uav_y, uav_z);
-      }
-    }
-
-    // saturate while ramping up during takeoff
-    if (last_attitude_cmd.ramping_up) {
-
-      ROS_INFO_THROTTLE(1.0, "[LandoffTracker]: waiting for the controller to rampup");
-      takeoff_saturated = true;
-    }
-  }
-
-  if (!takeoff_saturated) {
-
-    switch (current_state_horizontal_) {
-
-      case STOP_MOTION_STATE: {
-
-        stopHorizontalMotion();
-        break;
-      }
-
-      case STOPPING_STATE: {
-
-        stopHorizontal();
-        break;
-      }
-
-      default: {
-
-        break;
-      }
-    }
-
-    switch (current_state_vertical_) {
-
-      case STOP_MOTION_STATE: {
-
-        stopVerticalMotion();
-        break;
-      }
-
-      case ACCELERATING_STATE: {
-
-        accelerateVertical();
-        break;
-      }
-
-      case DECELERATING_STATE: {
-
-        decelerateVertical();
-        break;
-      }
-
-      case STOPPING_STATE: {
-
-        stopVertical();
-        break;
-      }
-
-      default: {
-
-        break;
-      }
-    }
-  }
-
-  if (current_state_horizontal_ == STOP_MOTION_STATE && current_state_vertical_ == STOP_MOTION_STATE) {
-    if (fabs(current_vertical_speed) <= 0.1 && fabs(current_horizontal_speed) <= 0.1) {
-
-      // if the current motion was stopped (the conditions above) but we still have a goal (landing or taking off)
-      // -> we should start accelerating towards the goal in the vertical direction
-      // This is important, do not modify without testing, otherwise your landing routine may crash into the ground
-      // while having large lateral speed
-      if (have_goal_) {
-
-        changeStateVertical(ACCELERATING_STATE);
-        changeStateHorizontal(STOPPING_STATE);
-
-      } else {
-
-        changeState(STOPPING_STATE);
-
-        {
-          std::scoped_lock lock(mutex_state_);
-
-          current_horizontal_speed_ = 0;
-          current_vertical_speed_   = 0;
-        }
-      }
-    }
-  }
-
-  if (current_state_vertical_ == STOPPING_STATE && current_state_horizontal_ == STOPPING_STATE) {
-    if (fabs(state_x - goal_x) < 0.1 && fabs(state_y - goal_y) < 0.1 && fabs(state_z - goal_z) < 0.1) {
-
-      {
-        std::scoped_lock lock(mutex_state_);
-
-        state_x_ = goal_x;
-        state_y_ = goal_y;
-        state_z_ = goal_z;
-
-        current_horizontal_speed_ = 0;
-        current_vertical_speed_   = 0;
-      }
+  return reference;
+}
 
-      changeState(HOVER_STATE);
+//}
 
-      have_goal_ = false;
-    }
-  }
+/* //{ startLanding() */
 
-  if (current_state_horizontal_ == LANDED_STATE && current_state_vertical_ == LANDED_STATE) {
-    {
-      std::scoped_lock lock(mutex_state_);
+// plans the landing from the current reference, should be called with mutex_state_ locked
+void LandoffTracker::startLanding(const ros::Time& time) {
 
-      state_x_ = goal_x = uav_x;
-      state_y_ = goal_y = uav_y;
-      state_z_ = goal_z = uav_z;
+  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
-      have_goal_ = false;
-    }
-  }
+  std::optional<double> height = heightAboveGround();
 
-  // --------------------------------------------------------------
-  // |              motion saturation during takeoff              |
-  // --------------------------------------------------------------
+  if (height) {
+    landing_ground_z_   = uav_state.pose.position.z - height.value();
+    landing_got_ground_ = true;
+  } else {
 
-  // update the inner states
-  if (!takeoff_saturated) {
-    {
-      std::scoped_lock lock(mutex_state_);
+    landing_got_ground_ = false;
 
-      state_x_ += cos(current_heading) * current_horizontal_speed * _tracker_dt_;
-      state_y_ += sin(current_heading) * current_horizontal_speed * _tracker_dt_;
-      state_z_ += current_vertical_direction * current_vertical_speed * _tracker_dt_;
+    if (!elanding_) {
+      ROS_WARN("[LandoffTracker]: the height above ground is not measured, landing slowly all the way down");
     }
   }
 
-  // --------------------------------------------------------------
-  // |                        heading tracking                        |
-  // --------------------------------------------------------------
+  landing_touchdown_  = false;
+  landing_mass_       = 0;
+  landing_start_time_ = time;
 
-  // compute the desired heading rate
-  {
-    std::scoped_lock lock(mutex_state_);
-
-    double current_heading_rate;
-
-    if (fabs(goal_heading_ - state_heading_) > M_PI)
-      current_heading_rate = -_heading_gain_ * (goal_heading_ - state_heading_);
-    else
-      current_heading_rate = _heading_gain_ * (goal_heading_ - state_heading_);
+  planMotion(sampleMotion(motion_time_), time);
+}
 
-    if (current_heading_rate > _heading_rate_) {
-      current_heading_rate = _heading_rate_;
-    } else if (current_heading_rate < -_heading_rate_) {
-      current_heading_rate = -_heading_rate_;
-    }
+//}
 
-    // flap the resulted state_heading_ aroud PI
-    state_heading_ += current_heading_rate * _tracker_dt_;
+/* //{ heightAboveGround() */
 
-    if (state_heading_ > M_PI) {
-      state_heading_ -= 2 * M_PI;
-    } else if (state_heading_ < -M_PI) {
-      state_heading_ += 2 * M_PI;
-    }
+// the measured height above ground, if fresh
+std::optional<double> LandoffTracker::heightAboveGround(void) {
 
-    if (fabs(state_heading_ - goal_heading_) < (2 * (_heading_rate_ * _tracker_dt_))) {
-      state_heading_ = goal_heading_;
-    }
+  if (sh_height_.hasMsg() && (ros::Time::now() - sh_height_.lastMsgTime()).toSec() < _landing_height_timeout_) {
+    return sh_height_.getMsg()->value;
   }
 
-  // --------------------------------------------------------------
-  // |                      landing setpoint                      |
-  // --------------------------------------------------------------
-
-  if (landing_) {
-    {
-      std::scoped_lock lock(mutex_goal_);
-
-      goal_z_ = uav_z + _landing_reference_;
-    }
-  }
+  return {};
 }
 
 //}
@@ -1333,11 +1149,6 @@ bool LandoffTracker::callbackTakeoff(mrs_msgs::Vec1::Request& req, mrs_msgs::Vec
 
   double uav_heading = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getHeading();
 
-  double uav_x, uav_y, uav_z;
-  uav_x = uav_state.pose.position.x;
-  uav_y = uav_state.pose.position.y;
-  uav_z = uav_state.pose.position.z;
-
   if (!is_active_) {
     ss << "can not takeoff, the tracker is not active";
     ROS_ERROR_STREAM_THROTTLE(1.0, "[LandoffTracker]: " << ss.str());
@@ -1363,39 +1174,37 @@ bool LandoffTracker::callbackTakeoff(mrs_msgs::Vec1::Request& req, mrs_msgs::Vec
     return true;
   }
 
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_);
-
-    state_x_ = uav_x;
-    goal_x_  = uav_x;
-
-    state_y_ = uav_y;
-    goal_y_  = uav_y;
-
-    state_z_ = uav_z;
-    goal_z_  = uav_z + req.goal;
+  // the takeoff starts from a standstill at the current position of the UAV
+  Reference_t initial;
 
-    state_heading_ = uav_heading;
-    goal_heading_  = uav_heading;
-
-    speed_x_                = 0;
-    speed_y_                = 0;
-    current_vertical_speed_ = 0;
-
-    have_goal_ = true;
-  }
+  initial.x       = uav_state.pose.position.x;
+  initial.y       = uav_state.pose.position.y;
+  initial.z       = uav_state.pose.position.z;
+  initial.heading = uav_heading;
 
   ROS_INFO("[LandoffTracker]: taking off");
 
   taking_off_ = true;
   landing_    = false;
   elanding_   = false;
+  have_goal_  = true;
+
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    goal_z_       = initial.z + req.goal;
+    goal_heading_ = uav_heading;
+
+    planMotion(initial, ros::Time::now());
+
+    takeoff_start_time_        = motion_start_time_;
+    takeoff_saturation_events_ = 0;
+    takeoff_saturated_         = false;
+  }
 
   res.success = true;
   res.message = "taking off";
 
-  changeState(STOP_MOTION_STATE);
-
   return true;
 }
 
@@ -1405,13 +1214,8 @@ bool LandoffTracker::callbackTakeoff(mrs_msgs::Vec1::Request& req, mrs_msgs::Vec
 
 bool LandoffTracker::callbackLand([[maybe_unused]] std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) {
 
-  std::scoped_lock lock(mutex_main_timer_);
-
   std::stringstream ss;
 
-  // copy member variables
-  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
-
   if (!is_active_) {
     ss << "can not land, the tracker is not active";
     ROS_ERROR_STREAM_THROTTLE(1.0, "[LandoffTracker]: " << ss.str());
@@ -1420,12 +1224,6 @@ bool LandoffTracker::callbackLand([[maybe_unused]] std_srvs::Trigger::Request& r
     return true;
   }
 
-  {
-    std::scoped_lock lock(mutex_goal_);
-
-    goal_z_ = uav_state.pose.position.z + _landing_reference_;
-  }
-
   ROS_INFO("[LandoffTracker]: landing");
 
   landing_    = true;
@@ -1433,11 +1231,15 @@ bool LandoffTracker::callbackLand([[maybe_unused]] std_srvs::Trigger::Request& r
   taking_off_ = false;
   have_goal_  = true;
 
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    startLanding(ros::Time::now());
+  }
+
   res.success = true;
   res.message = "landing";
 
-  changeState(STOP_MOTION_STATE);
-
   return true;
 }
 
@@ -1447,13 +1249,8 @@ bool LandoffTracker::callbackLand([[maybe_unused]] std_srvs::Trigger::Request& r
 
 bool LandoffTracker::callbackELand([[maybe_unused]] std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) {
 
-  std::scoped_lock lock(mutex_main_timer_);
-
   std::stringstream ss;
 
-  // copy member variables
-  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
-
   if (!is_active_) {
 
     ss << "can not eland, the tracker is not active";
@@ -1463,16 +1260,9 @@ bool LandoffTracker::callbackELand([[maybe_unused]] std_srvs::Trigger::Request&
     taking_off_ = false;
     landing_    = false;
     elanding_   = false;
-    changeState(LANDED_STATE);
     return true;
   }
 
-  {
-    std::scoped_lock lock(mutex_goal_);
-
-    goal_z_ = uav_state.pose.position.z + _landing_reference_;
-  }
-
   ROS_WARN("[LandoffTracker]: emergency landing");
 
   landing_    = true;
@@ -1480,11 +1270,15 @@ bool LandoffTracker::callbackELand([[maybe_unused]] std_srvs::Trigger::Request&
   taking_off_ = false;
   have_goal_  = true;
 
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    startLanding(ros::Time::now());
+  }
+
   res.success = true;
   res.message = "elanding";
 
-  changeState(STOP_MOTION_STATE);
-
   return true;
 }
 
@@ -16,6 +16,9 @@
 
 #include <mrs_msgs/VelocityReferenceSrv.h>
 
+#include <mrs_uav_trackers/motion_profiles.h>
+#include <mrs_uav_trackers/position_command_pool.h>
+
 //}
 
 /* defines //{ */
@@ -44,21 +47,40 @@ namespace line_tracker
 
 /* //{ class LineTracker */
 
-// state machine
-typedef enum
+// 3D motion parametrized by time, all the axes share a single jerk-limited
+// profile along the line, so they start and finish together, the second profile
+// zeroes the perpendicular acceleration when stopping and turns the velocity in the corner blends
+struct Segment_t
 {
+  double         start             = 0;   // [s], since the start of the motion
+  int            waypoint_idx      = -1;  // the queued waypoint the segment leads to, -1 if none
+  vec3_t         origin            = vec3_t::Zero();
+  vec3_t         direction         = vec3_t::UnitX();  // unit vector
+  SCurveProfile  profile;                              // distance travelled along the direction
+  vec3_t         lateral_direction = vec3_t::UnitY();  // unit vector
+  SCurveProfile  lateral;                              // distance travelled along the lateral direction
+  HeadingProfile heading;                              // started at the beginning of the segment
+
+  double duration(void) const {
+    return std::max(profile.duration(), lateral.duration());
+  }
+};
 
-  IDLE_STATE,
-  STOP_MOTION_STATE,
-  ACCELERATING_STATE,
-  DECELERATING_STATE,
-  STOPPING_STATE,
-
-} States_t;
-
-const char *state_names[5] = {
+struct Waypoint_t
+{
+  vec3_t position = vec3_t::Zero();
+  double heading  = 0;
+};
 
-    "IDLING", "STOPPING_MOTION", "ACCELERATING", "DECELERATING", "STOPPING"};
+// the full-state reference produced by the tracker
+struct Reference_t
+{
+  double x = 0, y = 0, z = 0;
+  double vel_x = 0, vel_y = 0, vel_z = 0;
+  double acc_x = 0, acc_y = 0, acc_z = 0;
+  double jerk_x = 0, jerk_y = 0, jerk_z = 0;
+  double heading = 0, heading_rate = 0;
+};
 
 class LineTracker : public mrs_uav_managers::Tracker {
 public:
@@ -96,85 +118,66 @@ private:
   std::string _version_;
   std::string _uav_name_;
 
-  void       mainTimer(const ros::TimerEvent &event);
-  ros::Timer main_timer_;
-
   // | ------------------------ uav state ----------------------- |
 
   mrs_msgs::UavState uav_state_;
   bool               got_uav_state_ = false;
   std::mutex         mutex_uav_state_;
 
-  double uav_x_;
-  double uav_y_;
-  double uav_z_;
-
   // tracker's inner states
-  double _tracker_loop_rate_;
-  double _tracker_dt_;
-  bool   is_initialized_ = false;
-  bool   is_active_      = false;
-
-  // | ----------------- internal state mmachine ---------------- |
-
-  States_t current_state_vertical_    = IDLE_STATE;
-  States_t previous_state_vertical_   = IDLE_STATE;
-  States_t current_state_horizontal_  = IDLE_STATE;
-  States_t previous_state_horizontal_ = IDLE_STATE;
-
-  void changeStateHorizontal(States_t new_state);
-  void changeStateVertical(States_t new_state);
-  void changeState(States_t new_state);
-
-  void stopHorizontalMotion(void);
-  void stopVerticalMotion(void);
-  void accelerateHorizontal(void);
-  void accelerateVertical(void);
-  void decelerateHorizontal(void);
-  void decelerateVertical(void);
-  void stopHorizontal(void);
-  void stopVertical(void);
+  bool is_initialized_ = false;
+  bool is_active_      = false;
 
   // | ------------------ dynamics constraints ------------------ |
 
-  double     _horizontal_speed_;
-  double     _vertical_speed_;
-  double     _horizontal_acceleration_;
-  double     _vertical_acceleration_;
-  double     _heading_rate_;
-  double     _heading_gain_;
-  std::mutex mutex_constraints_;
+  mrs_msgs::DynamicsConstraints constraints_;
+  double                        _heading_gain_;
+  double                        _junction_deviation_;
+  std::mutex                    mutex_constraints_;
+
+  std::tuple<double, double, double> lineConstraints(const vec3_t &direction, const mrs_msgs::DynamicsConstraints &constraints);
+  double junctionSpeed(const vec3_t &in, const vec3_t &out, const double max_blend_length, const mrs_msgs::DynamicsConstraints &constraints,
+                       const double junction_deviation);
+  double blendDuration(const vec3_t &in, const vec3_t &out, const double speed, const mrs_msgs::DynamicsConstraints &constraints);
 
   // | ---------------------- desired goal ---------------------- |
 
-  double     goal_x_;
-  double     goal_y_;
-  double     goal_z_;
-  double     goal_heading_;
-  bool       have_goal_ = false;
-  std::mutex mutex_goal_;
+  double goal_x_;
+  double goal_y_;
+  double goal_z_;
+  double goal_heading_;
 
-  // | ------------------- the state variables ------------------ |
-  double state_x_;
-  double state_y_;
-  double state_z_;
-  double state_heading_;
+  // | --------------------- waypoint queue --------------------- |
 
-  double speed_x_;
-  double speed_y_;
-  double speed_heading_;
+  std::vector<Waypoint_t> waypoints_;
+  bool                    waypoints_use_heading_ = false;
+  bool                    tracking_waypoints_    = false;
+  int                     waypoint_idx_          = 0;  // the waypoint being flown to, used for resuming
 
-  double current_heading_;
-  double current_vertical_direction_;
+  std::tuple<bool, std::string> flyWaypoints(const int first_idx);
+  std::vector<Waypoint_t>       queuedWaypoints(const int first_idx, const double initial_heading);
+  void                          updateWaypointProgress(const double t);
 
-  double current_vertical_speed_;
-  double current_horizontal_speed_;
+  // | -------------------- the planned motion ------------------ |
 
-  double current_horizontal_acceleration_;
-  double current_vertical_acceleration_;
+  // the motion consists of stopping from the previous motion, followed by straight
+  // segments through the waypoints, all evaluated in closed form
+  ros::Time              motion_start_time_;
+  std::vector<Segment_t> segments_;
 
+  // guards the goal, the waypoints and the planned motion
   std::mutex mutex_state_;
 
+  void        planMotion(const Reference_t &initial, const ros::Time &time, const std::vector<Waypoint_t> &waypoints, const int first_waypoint_idx);
+  int         findSegment(const double t);
+  double      motionDuration(void);
+  Reference_t sampleMotion(const double t);
+  Reference_t sampleSegment(const Segment_t &segment, const double t);
+
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
+
   // | ------------------------ profiler ------------------------ |
 
   mrs_lib::Profiler profiler_;
@@ -214,43 +217,23 @@ void LineTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
 
   param_loader.loadParam("enable_profiler", _profiler_enabled_);
 
-  param_loader.loadParam("horizontal_tracker/horizontal_speed", _horizontal_speed_);
-  param_loader.loadParam("horizontal_tracker/horizontal_acceleration", _horizontal_acceleration_);
-
-  param_loader.loadParam("vertical_tracker/vertical_speed", _vertical_speed_);
-  param_loader.loadParam("vertical_tracker/vertical_acceleration", _vertical_acceleration_);
-
-  param_loader.loadParam("heading_tracker/heading_rate", _heading_rate_);
-  param_loader.loadParam("heading_tracker/heading_gain", _heading_gain_);
-
-  param_loader.loadParam("tracker_loop_rate", _tracker_loop_rate_);
-
-  _tracker_dt_ = 1.0 / double(_tracker_loop_rate_);
-
-  ROS_INFO("[LineTracker]: tracker_dt: %.2f", _tracker_dt_);
-
-  state_x_       = 0;
-  state_y_       = 0;
-  state_z_       = 0;
-  state_heading_ = 0;
+  // the initial constraints, until the first ones are provided by the control manager
+  param_loader.loadParam("horizontal_tracker/horizontal_speed", constraints_.horizontal_speed);
+  param_loader.loadParam("horizontal_tracker/horizontal_acceleration", constraints_.horizontal_acceleration);
+  param_loader.loadParam("horizontal_tracker/horizontal_jerk", constraints_.horizontal_jerk);
 
-  speed_x_       = 0;
-  speed_y_       = 0;
-  speed_heading_ = 0;
+  param_loader.loadParam("vertical_tracker/vertical_speed", constraints_.vertical_ascending_speed);
+  param_loader.loadParam("vertical_tracker/vertical_acceleration", constraints_.vertical_ascending_acceleration);
+  param_loader.loadParam("vertical_tracker/vertical_jerk", constraints_.vertical_ascending_jerk);
 
-  current_horizontal_speed_ = 0;
-  current_vertical_speed_   = 0;
+  constraints_.vertical_descending_speed        = constraints_.vertical_ascending_speed;
+  constraints_.vertical_descending_acceleration = constraints_.vertical_ascending_acceleration;
+  constraints_.vertical_descending_jerk         = constraints_.vertical_ascending_jerk;
 
-  current_horizontal_acceleration_ = 0;
-  current_vertical_acceleration_   = 0;
-
-  current_vertical_direction_ = 0;
-
-  current_state_vertical_  = IDLE_STATE;
-  previous_state_vertical_ = IDLE_STATE;
+  param_loader.loadParam("heading_tracker/heading_rate", constraints_.heading_speed);
+  param_loader.loadParam("heading_tracker/heading_gain", _heading_gain_);
 
-  current_state_horizontal_  = IDLE_STATE;
-  previous_state_horizontal_ = IDLE_STATE;
+  param_loader.loadParam("waypoints/junction_deviation", _junction_deviation_);
 
   // --------------------------------------------------------------
   // |                          profiler_                          |
@@ -258,12 +241,6 @@ void LineTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
 
   profiler_ = mrs_lib::Profiler(nh_, "LineTracker", _profiler_enabled_);
 
-  // --------------------------------------------------------------
-  // |                           timers                           |
-  // --------------------------------------------------------------
-
-  main_timer_ = nh_.createTimer(ros::Rate(_tracker_loop_rate_), &LineTracker::mainTimer, this);
-
   if (!param_loader.loadedSuccessfully()) {
     ROS_ERROR("[LineTracker]: could not load all parameters!");
     ros::shutdown();
@@ -302,124 +279,79 @@ std::tuple<bool, std::string> LineTracker::activate(const mrs_msgs::PositionComm
     return std::tuple(false, ss.str());
   }
 
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_);
+  Reference_t initial;
 
-    if (mrs_msgs::PositionCommand::Ptr() != last_position_cmd) {
+  if (mrs_msgs::PositionCommand::Ptr() != last_position_cmd) {
 
-      // the last command is usable
-      if (last_position_cmd->use_position_horizontal) {
-        state_x_ = last_position_cmd->position.x;
-        state_y_ = last_position_cmd->position.y;
-      } else {
-        state_x_ = uav_state.pose.position.x;
-        state_y_ = uav_state.pose.position.y;
-      }
+    // the last command is usable
+    if (last_position_cmd->use_position_horizontal) {
+      initial.x = last_position_cmd->position.x;
+      initial.y = last_position_cmd->position.y;
+    } else {
+      initial.x = uav_state.pose.position.x;
+      initial.y = uav_state.pose.position.y;
+    }
 
-      if (last_position_cmd->use_position_vertical) {
-        state_z_ = last_position_cmd->position.z;
-      } else {
-        state_z_ = uav_state.pose.position.z;
-      }
+    if (last_position_cmd->use_position_vertical) {
+      initial.z = last_position_cmd->position.z;
+    } else {
+      initial.z = uav_state.pose.position.z;
+    }
 
-      if (last_position_cmd->use_heading) {
-        state_heading_ = last_position_cmd->heading;
-      } else if (last_position_cmd->use_orientation) {
-        try {
-          state_heading_ = mrs_lib::AttitudeConverter(last_position_cmd->orientation).getHeading();
-        }
-        catch (...) {
-          state_heading_ = uav_heading;
-        }
-      } else {
-        state_heading_ = uav_heading;
+    if (last_position_cmd->use_heading) {
+      initial.heading = last_position_cmd->heading;
+    } else if (last_position_cmd->use_orientation) {
+      try {
+        initial.heading = mrs_lib::AttitudeConverter(last_position_cmd->orientation).getHeading();
       }
-
-      if (last_position_cmd->use_velocity_horizontal) {
-        speed_x_ = last_position_cmd->velocity.x;
-        speed_y_ = last_position_cmd->velocity.y;
-      } else {
-        speed_x_ = uav_state.velocity.linear.x;
-        speed_y_ = uav_state.velocity.linear.y;
+      catch (...) {
+        initial.heading = uav_heading;
       }
-
-      current_heading_          = atan2(speed_y_, speed_x_);
-      current_horizontal_speed_ = sqrt(pow(speed_x_, 2) + pow(speed_y_, 2));
-
-      current_vertical_speed_     = fabs(last_position_cmd->velocity.z);
-      current_vertical_direction_ = last_position_cmd->velocity.z > 0 ? +1 : -1;
-
-      current_horizontal_acceleration_ = 0;
-      current_vertical_acceleration_   = 0;
-
-      goal_heading_ = last_position_cmd->heading;
-
-      ROS_INFO("[LineTracker]: initial condition: x=%.2f, y=%.2f, z=%.2f, heading=%.2f", last_position_cmd->position.x, last_position_cmd->position.y,
-               last_position_cmd->position.z, last_position_cmd->heading);
-      ROS_INFO("[LineTracker]: initial condition: x_rate=%.2f, y_rate=%.2f, z_rate=%.2f", speed_x_, speed_y_, current_vertical_speed_);
-
     } else {
+      initial.heading = uav_heading;
+    }
 
-      state_x_       = uav_state.pose.position.x;
-      state_y_       = uav_state.pose.position.y;
-      state_z_       = uav_state.pose.position.z;
-      state_heading_ = uav_heading;
-
-      speed_x_                  = uav_state.velocity.linear.x;
-      speed_y_                  = uav_state.velocity.linear.y;
-      current_heading_          = atan2(speed_y_, speed_x_);
-      current_horizontal_speed_ = sqrt(pow(speed_x_, 2) + pow(speed_y_, 2));
-
-      current_vertical_speed_     = fabs(uav_state.velocity.linear.z);
-      current_vertical_direction_ = uav_state.velocity.linear.z > 0 ? +1 : -1;
-
-      current_horizontal_acceleration_ = 0;
-      current_vertical_acceleration_   = 0;
+    if (last_position_cmd->use_velocity_horizontal) {
+      initial.vel_x = last_position_cmd->velocity.x;
+      initial.vel_y = last_position_cmd->velocity.y;
+    } else {
+      initial.vel_x = uav_state.velocity.linear.x;
+      initial.vel_y = uav_state.velocity.linear.y;
+    }
 
-      goal_heading_ = uav_heading;
+    initial.vel_z = last_position_cmd->velocity.z;
 
-      ROS_WARN("[LineTracker]: the previous command is not usable for activation, using Odometry instead");
+    if (last_position_cmd->use_acceleration) {
+      initial.acc_x = last_position_cmd->acceleration.x;
+      initial.acc_y = last_position_cmd->acceleration.y;
+      initial.acc_z = last_position_cmd->acceleration.z;
     }
-  }
 
-  // --------------------------------------------------------------
-  // |          horizontal initial conditions prediction          |
-  // --------------------------------------------------------------
-
-  double horizontal_t_stop, horizontal_stop_dist, stop_dist_x, stop_dist_y;
+    ROS_INFO("[LineTracker]: initial condition: x=%.2f, y=%.2f, z=%.2f, heading=%.2f", last_position_cmd->position.x, last_position_cmd->position.y,
+             last_position_cmd->position.z, last_position_cmd->heading);
+    ROS_INFO("[LineTracker]: initial condition: x_rate=%.2f, y_rate=%.2f, z_rate=%.2f", initial.vel_x, initial.vel_y, initial.vel_z);
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  } else {
 
-    horizontal_t_stop    = current_horizontal_speed_ / _horizontal_acceleration_;
-    horizontal_stop_dist = (horizontal_t_stop * current_horizontal_speed_) / 2.0;
-    stop_dist_x          = cos(current_heading_) * horizontal_stop_dist;
-    stop_dist_y          = sin(current_heading_) * horizontal_stop_dist;
-  }
+    initial.x       = uav_state.pose.position.x;
+    initial.y       = uav_state.pose.position.y;
+    initial.z       = uav_state.pose.position.z;
+    initial.heading = uav_heading;
 
-  // --------------------------------------------------------------
-  // |           vertical initial conditions prediction           |
-  // --------------------------------------------------------------
+    initial.vel_x = uav_state.velocity.linear.x;
+    initial.vel_y = uav_state.velocity.linear.y;
+    initial.vel_z = uav_state.velocity.linear.z;
 
-  double vertical_t_stop, vertical_stop_dist;
+    ROS_WARN("[LineTracker]: the previous command is not usable for activation, using Odometry instead");
+  }
 
   {
     std::scoped_lock lock(mutex_state_);
 
-    vertical_t_stop    = current_vertical_speed_ / _vertical_acceleration_;
-    vertical_stop_dist = current_vertical_direction_ * (vertical_t_stop * current_vertical_speed_) / 2.0;
-  }
-
-  // --------------------------------------------------------------
-  // |              heading initial condition  prediction             |
-  // --------------------------------------------------------------
-
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_);
+    tracking_waypoints_ = false;
+    goal_heading_       = initial.heading;
 
-    goal_x_ = state_x_ + stop_dist_x;
-    goal_y_ = state_y_ + stop_dist_y;
-    goal_z_ = state_z_ + vertical_stop_dist;
+    planMotion(initial, ros::Time::now(), {}, -1);
 
     ROS_INFO("[LineTracker]: setting z goal to %.2f", goal_z_);
   }
@@ -429,8 +361,6 @@ std::tuple<bool, std::string> LineTracker::activate(const mrs_msgs::PositionComm
   ss << "activated";
   ROS_INFO_STREAM("[LineTracker]: " << ss.str());
 
-  changeState(STOP_MOTION_STATE);
-
   return std::tuple(true, ss.str());
 }
 
@@ -474,30 +404,22 @@ bool LineTracker::resetStatic(void) {
     return false;
   }
 
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_, mutex_uav_state_);
-
-    state_x_       = uav_state_.pose.position.x;
-    state_y_       = uav_state_.pose.position.y;
-    state_z_       = uav_state_.pose.position.z;
-    state_heading_ = uav_heading;
+  Reference_t initial;
 
-    speed_x_                  = 0;
-    speed_y_                  = 0;
-    current_heading_          = 0;
-    current_horizontal_speed_ = 0;
+  initial.x       = uav_state.pose.position.x;
+  initial.y       = uav_state.pose.position.y;
+  initial.z       = uav_state.pose.position.z;
+  initial.heading = uav_heading;
 
-    current_vertical_speed_     = 0;
-    current_vertical_direction_ = 0;
+  {
+    std::scoped_lock lock(mutex_state_);
 
-    current_horizontal_acceleration_ = 0;
-    current_vertical_acceleration_   = 0;
+    tracking_waypoints_ = false;
+    goal_heading_       = uav_heading;
 
-    goal_heading_ = uav_heading;
+    planMotion(initial, ros::Time::now(), {}, -1);
   }
 
-  changeState(IDLE_STATE);
-
   return true;
 }
 
@@ -515,9 +437,6 @@ const mrs_msgs::PositionCommand::ConstPtr LineTracker::update(const mrs_msgs::Ua
     std::scoped_lock lock(mutex_uav_state_);
 
     uav_state_ = *uav_state;
-    uav_x_     = uav_state_.pose.position.x;
-    uav_y_     = uav_state_.pose.position.y;
-    uav_z_     = uav_state_.pose.position.z;
 
     got_uav_state_ = true;
   }
@@ -527,38 +446,54 @@ const mrs_msgs::PositionCommand::ConstPtr LineTracker::update(const mrs_msgs::Ua
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  mrs_msgs::PositionCommand position_cmd;
+  ros::Time now = ros::Time::now();
 
-  position_cmd.header.stamp    = ros::Time::now();
-  position_cmd.header.frame_id = uav_state->header.frame_id;
+  // the reference is evaluated in closed form from the start of the motion
+  Reference_t reference;
 
   {
     std::scoped_lock lock(mutex_state_);
 
-    position_cmd.position.x = state_x_;
-    position_cmd.position.y = state_y_;
-    position_cmd.position.z = state_z_;
-    position_cmd.heading    = radians::wrap(state_heading_);
-
-    position_cmd.velocity.x   = cos(current_heading_) * current_horizontal_speed_;
-    position_cmd.velocity.y   = sin(current_heading_) * current_horizontal_speed_;
-    position_cmd.velocity.z   = current_vertical_direction_ * current_vertical_speed_;
-    position_cmd.heading_rate = speed_heading_;
-
-    position_cmd.acceleration.x = 0;
-    position_cmd.acceleration.y = 0;
-    position_cmd.acceleration.z = current_vertical_direction_ * current_vertical_acceleration_;
-
-    position_cmd.use_position_vertical   = 1;
-    position_cmd.use_position_horizontal = 1;
-    position_cmd.use_heading             = 1;
-    position_cmd.use_heading_rate        = 1;
-    position_cmd.use_velocity_vertical   = 1;
-    position_cmd.use_velocity_horizontal = 1;
-    position_cmd.use_acceleration        = 1;
+    double t = (now - motion_start_time_).toSec();
+
+    updateWaypointProgress(t);
+
+    reference = sampleMotion(t);
   }
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+  position_cmd->header.stamp    = now;
+  position_cmd->header.frame_id = uav_state->header.frame_id;
+
+  position_cmd->position.x = reference.x;
+  position_cmd->position.y = reference.y;
+  position_cmd->position.z = reference.z;
+  position_cmd->heading    = radians::wrap(reference.heading);
+
+  position_cmd->velocity.x   = reference.vel_x;
+  position_cmd->velocity.y   = reference.vel_y;
+  position_cmd->velocity.z   = reference.vel_z;
+  position_cmd->heading_rate = reference.heading_rate;
+
+  position_cmd->acceleration.x = reference.acc_x;
+  position_cmd->acceleration.y = reference.acc_y;
+  position_cmd->acceleration.z = reference.acc_z;
+
+  position_cmd->jerk.x = reference.jerk_x;
+  position_cmd->jerk.y = reference.jerk_y;
+  position_cmd->jerk.z = reference.jerk_z;
+
+  position_cmd->use_position_vertical   = 1;
+  position_cmd->use_position_horizontal = 1;
+  position_cmd->use_heading             = 1;
+  position_cmd->use_heading_rate        = 1;
+  position_cmd->use_velocity_vertical   = 1;
+  position_cmd->use_velocity_horizontal = 1;
+  position_cmd->use_acceleration        = 1;
+  position_cmd->use_jerk                = 1;
+
+  return position_cmd;
 }
 
 //}
@@ -572,11 +507,17 @@ const mrs_msgs::TrackerStatus LineTracker::getStatus() {
   tracker_status.active            = is_active_;
   tracker_status.callbacks_enabled = callbacks_enabled_;
 
-  bool idling = current_state_vertical_ == IDLE_STATE && current_state_horizontal_ == IDLE_STATE;
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    double t = (ros::Time::now() - motion_start_time_).toSec();
 
-  tracker_status.have_goal = !idling;
+    tracker_status.have_goal = t < motionDuration();
 
-  tracker_status.tracking_trajectory = false;
+    tracker_status.tracking_trajectory = tracking_waypoints_;
+    tracker_status.trajectory_idx      = waypoint_idx_;
+    tracker_status.trajectory_length   = waypoints_.size();
+  }
 
   return tracker_status;
 }
@@ -615,7 +556,7 @@ const std_srvs::SetBoolResponse::ConstPtr LineTracker::enableCallbacks(const std
 
 const std_srvs::TriggerResponse::ConstPtr LineTracker::switchOdometrySource(const mrs_msgs::UavState::ConstPtr &new_uav_state) {
 
-  std::scoped_lock lock(mutex_goal_, mutex_state_);
+  std::scoped_lock lock(mutex_state_);
 
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
@@ -659,14 +600,17 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::switchOdometrySource(cons
   goal_z_ += dz;
   goal_heading_ += dheading;
 
-  // | -------------------- update the state -------------------- |
+  // | ----------------- translate the motion ------------------ |
 
-  state_x_ += dx;
-  state_y_ += dy;
-  state_z_ += dz;
-  state_heading_ += dheading;
+  for (Segment_t &segment : segments_) {
+    segment.origin += vec3_t(dx, dy, dz);
+    segment.heading.translate(dheading);
+  }
 
-  current_heading_ = atan2(goal_y_ - state_y_, goal_x_ - state_x_);
+  for (Waypoint_t &waypoint : waypoints_) {
+    waypoint.position += vec3_t(dx, dy, dz);
+    waypoint.heading += dheading;
+  }
 
   res.message = "odometry source switched";
   res.success = true;
@@ -682,58 +626,28 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::hover([[maybe_unused]] co
 
   std_srvs::TriggerResponse res;
 
-  // --------------------------------------------------------------
-  // |          horizontal initial conditions prediction          |
-  // --------------------------------------------------------------
-  {
-    std::scoped_lock lock(mutex_state_, mutex_uav_state_);
-
-    current_horizontal_speed_ = sqrt(pow(uav_state_.velocity.linear.x, 2) + pow(uav_state_.velocity.linear.y, 2));
-    current_vertical_speed_   = uav_state_.velocity.linear.z;
-    current_heading_          = atan2(uav_state_.velocity.linear.y, uav_state_.velocity.linear.x);
-  }
-
-  double horizontal_t_stop, horizontal_stop_dist, stop_dist_x, stop_dist_y;
-
-  {
-    std::scoped_lock lock(mutex_state_);
-
-    horizontal_t_stop    = current_horizontal_speed_ / _horizontal_acceleration_;
-    horizontal_stop_dist = (horizontal_t_stop * current_horizontal_speed_) / 2.0;
-    stop_dist_x          = cos(current_heading_) * horizontal_stop_dist;
-    stop_dist_y          = sin(current_heading_) * horizontal_stop_dist;
-  }
-
-  // --------------------------------------------------------------
-  // |           vertical initial conditions prediction           |
-  // --------------------------------------------------------------
+  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
-  double vertical_t_stop, vertical_stop_dist;
+  ros::Time now = ros::Time::now();
 
   {
     std::scoped_lock lock(mutex_state_);
 
-    vertical_t_stop    = current_vertical_speed_ / _vertical_acceleration_;
-    vertical_stop_dist = current_vertical_direction_ * (vertical_t_stop * current_vertical_speed_) / 2.0;
-  }
+    // stop from the current velocity of the UAV
+    Reference_t initial = sampleMotion((now - motion_start_time_).toSec());
 
-  // --------------------------------------------------------------
-  // |                        set the goal                        |
-  // --------------------------------------------------------------
+    initial.vel_x = uav_state.velocity.linear.x;
+    initial.vel_y = uav_state.velocity.linear.y;
+    initial.vel_z = uav_state.velocity.linear.z;
 
-  {
-    std::scoped_lock lock(mutex_goal_, mutex_state_);
+    tracking_waypoints_ = false;
 
-    goal_x_ = state_x_ + stop_dist_x;
-    goal_y_ = state_y_ + stop_dist_y;
-    goal_z_ = state_z_ + vertical_stop_dist;
+    planMotion(initial, now, {}, -1);
   }
 
   res.message = "hover initiated";
   res.success = true;
 
-  changeState(STOP_MOTION_STATE);
-
   return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
@@ -742,7 +656,14 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::hover([[maybe_unused]] co
 /* //{ startTrajectoryTracking() */
 
 const std_srvs::TriggerResponse::ConstPtr LineTracker::startTrajectoryTracking([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr &cmd) {
-  return std_srvs::TriggerResponse::Ptr();
+
+  auto [success, message] = flyWaypoints(0);
+
+  std_srvs::TriggerResponse res;
+  res.success = success;
+  res.message = message;
+
+  return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
 //}
@@ -750,7 +671,42 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::startTrajectoryTracking([
 /* //{ stopTrajectoryTracking() */
 
 const std_srvs::TriggerResponse::ConstPtr LineTracker::stopTrajectoryTracking([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr &cmd) {
-  return std_srvs::TriggerResponse::Ptr();
+
+  std::stringstream ss;
+
+  ros::Time now = ros::Time::now();
+
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    double t = (now - motion_start_time_).toSec();
+
+    updateWaypointProgress(t);
+
+    if (tracking_waypoints_) {
+
+      Reference_t initial = sampleMotion(t);
+
+      tracking_waypoints_ = false;
+      goal_heading_       = initial.heading;
+
+      planMotion(initial, now, {}, -1);
+
+      ss << "stopping trajectory tracking";
+
+    } else {
+
+      ss << "can not stop trajectory tracking, already at stop";
+    }
+  }
+
+  ROS_INFO_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
+
+  std_srvs::TriggerResponse res;
+  res.success = true;
+  res.message = ss.str();
+
+  return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
 //}
@@ -758,7 +714,24 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::stopTrajectoryTracking([[
 /* //{ resumeTrajectoryTracking() */
 
 const std_srvs::TriggerResponse::ConstPtr LineTracker::resumeTrajectoryTracking([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr &cmd) {
-  return std_srvs::TriggerResponse::Ptr();
+
+  int waypoint_idx;
+
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    updateWaypointProgress((ros::Time::now() - motion_start_time_).toSec());
+
+    waypoint_idx = waypoint_idx_;
+  }
+
+  auto [success, message] = flyWaypoints(waypoint_idx);
+
+  std_srvs::TriggerResponse res;
+  res.success = success;
+  res.message = message;
+
+  return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
 //}
@@ -766,7 +739,46 @@ const std_srvs::TriggerResponse::ConstPtr LineTracker::resumeTrajectoryTracking(
 /* //{ gotoTrajectoryStart() */
 
 const std_srvs::TriggerResponse::ConstPtr LineTracker::gotoTrajectoryStart([[maybe_unused]] const std_srvs::TriggerRequest::ConstPtr &cmd) {
-  return std_srvs::TriggerResponse::Ptr();
+
+  std::stringstream ss;
+
+  std_srvs::TriggerResponse res;
+
+  ros::Time now = ros::Time::now();
+
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    if (waypoints_.empty()) {
+
+      ss << "can not fly to the start of the trajectory, the trajectory is not set";
+      ROS_WARN_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
+
+      res.success = false;
+      res.message = ss.str();
+
+      return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
+    }
+
+    Reference_t initial = sampleMotion((now - motion_start_time_).toSec());
+
+    std::vector<Waypoint_t> waypoints = queuedWaypoints(0, initial.heading);
+
+    waypoints.resize(1);
+
+    tracking_waypoints_ = false;
+    waypoint_idx_       = 0;
+
+    planMotion(initial, now, waypoints, -1);
+  }
+
+  ss << "flying to the start of the trajectory";
+  ROS_INFO_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
+
+  res.success = true;
+  res.message = ss.str();
+
+  return std_srvs::TriggerResponse::ConstPtr(new std_srvs::TriggerResponse(res));
 }
 
 //}
@@ -778,17 +790,7 @@ const mrs_msgs::DynamicsConstraintsSrvResponse::ConstPtr LineTracker::setConstra
   mrs_msgs::DynamicsConstraintsSrvResponse res;
 
   // this is the place to copy the constraints
-  {
-    std::scoped_lock lock(mutex_constraints_);
-
-    _horizontal_speed_        = cmd->constraints.horizontal_speed;
-    _horizontal_acceleration_ = cmd->constraints.horizontal_acceleration;
-
-    _vertical_speed_        = cmd->constraints.vertical_ascending_speed;
-    _vertical_acceleration_ = cmd->constraints.vertical_ascending_acceleration;
-
-    _heading_rate_ = cmd->constraints.heading_speed;
-  }
+  mrs_lib::set_mutexed(mutex_constraints_, cmd->constraints, constraints_);
 
   res.success = true;
   res.message = "constraints updated";
@@ -804,22 +806,26 @@ const mrs_msgs::ReferenceSrvResponse::ConstPtr LineTracker::setReference(const m
 
   mrs_msgs::ReferenceSrvResponse res;
 
-  auto state_heading = mrs_lib::get_mutexed(mutex_state_, state_heading_);
+  ros::Time now = ros::Time::now();
 
   {
-    std::scoped_lock lock(mutex_goal_);
+    std::scoped_lock lock(mutex_state_);
 
-    goal_x_       = cmd->reference.position.x;
-    goal_y_       = cmd->reference.position.y;
-    goal_z_       = cmd->reference.position.z;
-    goal_heading_ = radians::unwrap(cmd->reference.heading, state_heading);
+    Reference_t initial = sampleMotion((now - motion_start_time_).toSec());
 
-    ROS_INFO("[LineTracker]: received new setpoint %.2f, %.2f, %.2f, %.2f", goal_x_, goal_y_, goal_z_, goal_heading_);
+    Waypoint_t goal;
 
-    have_goal_ = true;
-  }
+    goal.position = vec3_t(cmd->reference.position.x, cmd->reference.position.y, cmd->reference.position.z);
+    goal.heading  = radians::unwrap(cmd->reference.heading, initial.heading);
+
+    ROS_INFO("[LineTracker]: received new setpoint %.2f, %.2f, %.2f, %.2f", goal.position(0), goal.position(1), goal.position(2), goal.heading);
+
+    tracking_waypoints_ = false;
+
+    planMotion(initial, now, {goal}, -1);
 
-  changeState(STOP_MOTION_STATE);
+    ROS_INFO("[LineTracker]: the transition will take %.2f s", motionDuration());
+  }
 
   res.success = true;
   res.message = "reference set";
@@ -840,420 +846,548 @@ const mrs_msgs::VelocityReferenceSrvResponse::ConstPtr LineTracker::setVelocityR
 
 /* //{ setTrajectoryReference() */
 
-const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr LineTracker::setTrajectoryReference([
-    [maybe_unused]] const mrs_msgs::TrajectoryReferenceSrvRequest::ConstPtr &cmd) {
-  return mrs_msgs::TrajectoryReferenceSrvResponse::Ptr();
-}
+const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr LineTracker::setTrajectoryReference(const mrs_msgs::TrajectoryReferenceSrvRequest::ConstPtr &cmd) {
 
-//}
+  std::stringstream ss;
 
-// | ----------------- state machine routines ----------------- |
+  mrs_msgs::TrajectoryReferenceSrvResponse res;
 
-/* //{ changeStateHorizontal() */
+  // the points are treated as waypoints, the sampling time is not used
+  if (cmd->trajectory.loop) {
 
-void LineTracker::changeStateHorizontal(States_t new_state) {
+    ss << "can not load the waypoints, looping is not supported";
+    ROS_WARN_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
 
-  previous_state_horizontal_ = current_state_horizontal_;
-  current_state_horizontal_  = new_state;
+    res.success = false;
+    res.message = ss.str();
 
-  // just for ROS_INFO
-  ROS_DEBUG("[LineTracker]: Switching horizontal state %s -> %s", state_names[previous_state_horizontal_], state_names[current_state_horizontal_]);
-}
+    return mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr(new mrs_msgs::TrajectoryReferenceSrvResponse(res));
+  }
 
-//}
+  if (cmd->trajectory.points.empty()) {
+
+    ss << "can not load the waypoints, the trajectory is empty";
+    ROS_WARN_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
 
-/* //{ changeStateVertical() */
+    res.success = false;
+    res.message = ss.str();
 
-void LineTracker::changeStateVertical(States_t new_state) {
+    return mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr(new mrs_msgs::TrajectoryReferenceSrvResponse(res));
+  }
 
-  previous_state_vertical_ = current_state_vertical_;
-  current_state_vertical_  = new_state;
+  std::vector<Waypoint_t> waypoints;
+  waypoints.reserve(cmd->trajectory.points.size());
 
-  // just for ROS_INFO
-  ROS_DEBUG("[LineTracker]: Switching vertical state %s -> %s", state_names[previous_state_vertical_], state_names[current_state_vertical_]);
-}
+  for (const mrs_msgs::Reference &point : cmd->trajectory.points) {
 
-//}
+    Waypoint_t waypoint;
+
+    waypoint.position = vec3_t(point.position.x, point.position.y, point.position.z);
+    waypoint.heading  = point.heading;
+
+    waypoints.push_back(waypoint);
+  }
+
+  {
+    std::scoped_lock lock(mutex_state_);
+
+    waypoints_             = waypoints;
+    waypoints_use_heading_ = cmd->trajectory.use_heading;
+    waypoint_idx_          = 0;
+  }
+
+  ROS_INFO("[LineTracker]: loaded %d waypoints", int(waypoints.size()));
+
+  if (cmd->trajectory.fly_now) {
 
-/* //{ changeState() */
+    auto [success, message] = flyWaypoints(0);
 
-void LineTracker::changeState(States_t new_state) {
+    res.success = success;
+    res.message = message;
 
-  changeStateVertical(new_state);
-  changeStateHorizontal(new_state);
+  } else {
+
+    res.success = true;
+    res.message = "waypoints loaded";
+  }
+
+  return mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr(new mrs_msgs::TrajectoryReferenceSrvResponse(res));
 }
 
 //}
 
 // | --------------------- motion routines -------------------- |
 
-/* //{ stopHorizontalMotion() */
+/* //{ planMotion() */
 
-void LineTracker::stopHorizontalMotion(void) {
+// plans the stopping from the initial state followed by the flight through the waypoints (if there are any),
+// should be called with mutex_state_ locked
+void LineTracker::planMotion(const Reference_t &initial, const ros::Time &time, const std::vector<Waypoint_t> &waypoints, const int first_waypoint_idx) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  auto [constraints, heading_gain, junction_deviation] = mrs_lib::get_mutexed(mutex_constraints_, constraints_, _heading_gain_, _junction_deviation_);
 
-    current_horizontal_speed_ -= _horizontal_acceleration_ * _tracker_dt_;
+  motion_start_time_ = time;
 
-    if (current_horizontal_speed_ < 0) {
-      current_horizontal_speed_        = 0;
-      current_horizontal_acceleration_ = 0;
-    } else {
-      current_horizontal_acceleration_ = -_horizontal_acceleration_;
+  segments_.clear();
+
+  // | ------------------ stop the current motion ------------------ |
+
+  vec3_t initial_position(initial.x, initial.y, initial.z);
+  vec3_t initial_velocity(initial.vel_x, initial.vel_y, initial.vel_z);
+  vec3_t initial_acceleration(initial.acc_x, initial.acc_y, initial.acc_z);
+
+  double initial_speed = initial_velocity.norm();
+
+  Segment_t stop_segment;
+
+  stop_segment.origin = initial_position;
+
+  if (initial_speed > STOP_THR || initial_acceleration.norm() > STOP_THR) {
+
+    stop_segment.direction = initial_speed > STOP_THR ? vec3_t(initial_velocity / initial_speed) : initial_acceleration.normalized();
+
+    // the stopping decelerates against the direction, so the constraints of the opposite direction apply
+    {
+      auto [speed, acceleration, jerk] = lineConstraints(-stop_segment.direction, constraints);
+
+      stop_segment.profile = SCurveProfile::stop(0.0, initial_speed, initial_acceleration.dot(stop_segment.direction), acceleration, jerk);
+    }
+
+    // the acceleration perpendicular to the velocity is brought to zero separately, so the reference acceleration does not step
+    vec3_t lateral_acceleration = initial_acceleration - initial_acceleration.dot(stop_segment.direction) * stop_segment.direction;
+
+    if (lateral_acceleration.norm() > STOP_THR) {
+
+      stop_segment.lateral_direction = lateral_acceleration.normalized();
+
+      auto [speed, acceleration, jerk] = lineConstraints(-stop_segment.lateral_direction, constraints);
+
+      stop_segment.lateral = SCurveProfile::stop(0.0, 0.0, lateral_acceleration.norm(), acceleration, jerk);
     }
   }
-}
 
-//}
+  Reference_t stopped = sampleSegment(stop_segment, stop_segment.duration());
 
-/* //{ stopVerticalMotion() */
+  vec3_t stopped_position(stopped.x, stopped.y, stopped.z);
 
-void LineTracker::stopVerticalMotion(void) {
+  // | --------------- the polyline through the waypoints -------------- |
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  std::vector<Segment_t> path;
+  std::vector<double>    length, speed, acceleration, jerk, heading;
 
-    current_vertical_speed_ -= _vertical_acceleration_ * _tracker_dt_;
+  vec3_t vertex = stopped_position;
 
-    if (current_vertical_speed_ < 0) {
-      current_vertical_speed_        = 0;
-      current_vertical_acceleration_ = 0;
-    } else {
-      current_vertical_acceleration_ = -_vertical_acceleration_;
+  for (size_t i = 0; i < waypoints.size(); i++) {
+
+    vec3_t difference = waypoints[i].position - vertex;
+    double distance   = difference.norm();
+
+    // waypoints on the spot only update the heading
+    if (distance < STOP_THR) {
+
+      if (!heading.empty()) {
+        heading.back() = waypoints[i].heading;
+      }
+
+      continue;
     }
-  }
-}
 
-//}
+    Segment_t segment;
 
-/* //{ accelerateHorizontal() */
+    segment.origin       = vertex;
+    segment.direction    = difference / distance;
+    segment.waypoint_idx = first_waypoint_idx >= 0 ? first_waypoint_idx + int(i) : -1;
 
-void LineTracker::accelerateHorizontal(void) {
+    auto [segment_speed, segment_acceleration, segment_jerk] = lineConstraints(segment.direction, constraints);
 
-  // copy member variables
-  auto [goal_x, goal_y]                             = mrs_lib::get_mutexed(mutex_goal_, goal_x_, goal_y_);
-  auto [state_x, state_y, current_horizontal_speed] = mrs_lib::get_mutexed(mutex_state_, state_x_, state_y_, current_horizontal_speed_);
+    path.push_back(segment);
+    length.push_back(distance);
+    speed.push_back(segment_speed);
+    acceleration.push_back(segment_acceleration);
+    jerk.push_back(segment_jerk);
+    heading.push_back(waypoints[i].heading);
 
-  {
-    std::scoped_lock lock(mutex_state_);
+    vertex = waypoints[i].position;
+  }
 
-    current_heading_ = atan2(goal_y - state_y, goal_x - state_x);
+  if (waypoints.empty()) {
+    goal_x_ = stopped.x;
+    goal_y_ = stopped.y;
+    goal_z_ = stopped.z;
+  } else {
+    goal_x_       = waypoints.back().position(0);
+    goal_y_       = waypoints.back().position(1);
+    goal_z_       = waypoints.back().position(2);
+    goal_heading_ = waypoints.back().heading;
   }
 
-  auto current_heading = mrs_lib::get_mutexed(mutex_state_, current_heading_);
+  // | ------------ the look-ahead velocities at the vertices ----------- |
 
-  double horizontal_t_stop, horizontal_stop_dist, stop_dist_x, stop_dist_y;
+  // the path starts and finishes at rest, the corners are blended with a speed given by the angle, the constraints and the junction deviation,
+  // each blend may take up to a half of the adjacent segments
+  std::vector<double> vertex_speed(path.size() + 1, 0.0);
 
-  horizontal_t_stop    = current_horizontal_speed / _horizontal_acceleration_;
-  horizontal_stop_dist = (horizontal_t_stop * current_horizontal_speed) / 2.0;
-  stop_dist_x          = cos(current_heading) * horizontal_stop_dist;
-  stop_dist_y          = sin(current_heading) * horizontal_stop_dist;
+  for (size_t i = 1; i < path.size(); i++) {
+    vertex_speed[i] = std::min({speed[i - 1], speed[i],
+                                junctionSpeed(path[i - 1].direction, path[i].direction, std::min(length[i - 1], length[i]) / 2.0, constraints, junction_deviation)});
+  }
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  // the blends shorten the straight parts between them
+  std::vector<double> blend_duration(path.size() + 1, 0.0);
+  std::vector<double> straight(path.size(), 0.0);
 
-    current_horizontal_speed_ += _horizontal_acceleration_ * _tracker_dt_;
+  auto updateStraightParts = [&]() {
+    for (size_t i = 1; i < path.size(); i++) {
+      blend_duration[i] = blendDuration(path[i - 1].direction, path[i].direction, vertex_speed[i], constraints);
+    }
 
-    if (current_horizontal_speed_ >= _horizontal_speed_) {
-      current_horizontal_speed_        = _horizontal_speed_;
-      current_horizontal_acceleration_ = 0;
-    } else {
-      current_horizontal_acceleration_ = _horizontal_acceleration_;
+    for (size_t i = 0; i < path.size(); i++) {
+      straight[i] = std::max(length[i] - (vertex_speed[i] * blend_duration[i] + vertex_speed[i + 1] * blend_duration[i + 1]) / 2.0, 0.0);
     }
+  };
+
+  updateStraightParts();
+
+  // the speed has to be reduced in time before the following vertices
+  for (int i = int(path.size()) - 1; i >= 0; i--) {
+    vertex_speed[i] = std::min(vertex_speed[i], SCurveProfile::reachableVelocity(vertex_speed[i + 1], straight[i], speed[i], acceleration[i], jerk[i]));
   }
 
-  if (sqrt(pow(state_x + stop_dist_x - goal_x, 2) + pow(state_y + stop_dist_y - goal_y, 2)) < (2 * (_horizontal_speed_ * _tracker_dt_))) {
+  // and it can not grow faster than the acceleration allows
+  for (size_t i = 0; i < path.size(); i++) {
+    vertex_speed[i + 1] = std::min(vertex_speed[i + 1], SCurveProfile::reachableVelocity(vertex_speed[i], straight[i], speed[i], acceleration[i], jerk[i]));
+  }
 
-    {
-      std::scoped_lock lock(mutex_state_);
+  // slower blends are shorter, so the straight parts only get longer
+  updateStraightParts();
 
-      current_horizontal_acceleration_ = 0;
-    }
+  // | ------------------ the time-parametrized motion ----------------- |
 
-    changeStateHorizontal(DECELERATING_STATE);
-  }
-}
+  double stop_heading_goal = heading.empty() ? goal_heading_ : heading.front();
 
-//}
+  stop_segment.heading = HeadingProfile(initial.heading, stop_heading_goal, heading_gain, constraints.heading_speed);
 
-/* //{ accelerateVertical() */
+  segments_.reserve(2 * path.size() + 1);
+  segments_.push_back(stop_segment);
 
-void LineTracker::accelerateVertical(void) {
+  double start = stop_segment.duration();
 
-  auto goal_z                            = mrs_lib::get_mutexed(mutex_goal_, goal_z_);
-  auto [state_z, current_vertical_speed] = mrs_lib::get_mutexed(mutex_state_, state_z_, current_vertical_speed_);
+  double segment_heading, segment_heading_rate;
+  stop_segment.heading.sample(start, segment_heading, segment_heading_rate);
 
-  // set the right heading
-  double tar_z = goal_z - state_z;
+  for (size_t i = 0; i < path.size(); i++) {
 
-  // set the right vertical direction
-  {
-    std::scoped_lock lock(mutex_state_);
+    const double blend_length = vertex_speed[i] * blend_duration[i] / 2.0;
 
-    current_vertical_direction_ = mrs_lib::signum(tar_z);
-  }
+    // | ----------------- the blend around the vertex ---------------- |
 
-  auto current_vertical_direction = mrs_lib::get_mutexed(mutex_state_, current_vertical_direction_);
+    // the velocity is turned from the incoming to the outgoing direction with a triangular acceleration profile
+    if (blend_duration[i] > 0) {
 
-  // calculate the time to stop and the distance it will take to stop [vertical]
-  double vertical_t_stop    = current_vertical_speed / _vertical_acceleration_;
-  double vertical_stop_dist = (vertical_t_stop * current_vertical_speed) / 2.0;
-  double stop_dist_z        = current_vertical_direction * vertical_stop_dist;
+      const vec3_t change      = path[i].direction - path[i - 1].direction;
+      const double change_norm = change.norm();
 
-  {
-    std::scoped_lock lock(mutex_state_);
+      Segment_t blend;
 
-    current_vertical_speed_ += _vertical_acceleration_ * _tracker_dt_;
+      blend.start             = start;
+      blend.waypoint_idx      = path[i].waypoint_idx;
+      blend.origin            = path[i].origin - path[i - 1].direction * blend_length;
+      blend.direction         = path[i - 1].direction;
+      blend.profile           = SCurveProfile::cruise(0.0, vertex_speed[i], blend_duration[i]);
+      blend.lateral_direction = change / change_norm;
+      blend.lateral = SCurveProfile::velocityChange(0.0, 0.0, vertex_speed[i] * change_norm, 2.0 * vertex_speed[i] * change_norm / blend_duration[i],
+                                                    4.0 * vertex_speed[i] * change_norm / pow(blend_duration[i], 2));
+      blend.heading = HeadingProfile(segment_heading, heading[i], heading_gain, constraints.heading_speed);
 
-    if (current_vertical_speed_ >= _vertical_speed_) {
-      current_vertical_speed_        = _vertical_speed_;
-      current_vertical_acceleration_ = 0;
-    } else {
-      current_vertical_acceleration_ = _vertical_acceleration_;
+      blend.heading.sample(blend.duration(), segment_heading, segment_heading_rate);
+
+      start += blend.duration();
+
+      segments_.push_back(blend);
     }
-  }
 
-  if (fabs(state_z + stop_dist_z - goal_z) < (2 * (_vertical_speed_ * _tracker_dt_))) {
+    // | --------------------- the straight part --------------------- |
 
-    {
-      std::scoped_lock lock(mutex_state_);
+    Segment_t &segment = path[i];
 
-      current_vertical_acceleration_ = 0;
-    }
+    segment.start   = start;
+    segment.origin  = segment.origin + segment.direction * blend_length;
+    segment.profile = SCurveProfile::transition(0.0, straight[i], vertex_speed[i], vertex_speed[i + 1], speed[i], acceleration[i], jerk[i]);
+    segment.heading = HeadingProfile(segment_heading, heading[i], heading_gain, constraints.heading_speed);
 
-    changeStateVertical(DECELERATING_STATE);
+    segment.heading.sample(segment.duration(), segment_heading, segment_heading_rate);
+
+    start += segment.duration();
+
+    segments_.push_back(segment);
   }
 }
 
 //}
 
-/* //{ decelerateHorizontal() */
+/* //{ junctionSpeed() */
 
-void LineTracker::decelerateHorizontal(void) {
+// the highest speed at which the corner between the two directions can be blended without violating the constraints,
+// deviating from the vertex by more than the junction deviation, or starting the blend further than max_blend_length from it
+//
+// the blend of the duration T turns the velocity by a triangular acceleration pulse, it starts and finishes v T / 2 from
+// the vertex, passes v T |out - in| / 12 from it, and its acceleration and jerk peak at 2 v |out - in| / T and 4 v |out - in| / T^2
+double LineTracker::junctionSpeed(const vec3_t &in, const vec3_t &out, const double max_blend_length, const mrs_msgs::DynamicsConstraints &constraints,
+                                  const double junction_deviation) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  const vec3_t change      = out - in;
+  const double change_norm = change.norm();
 
-    current_horizontal_speed_ -= _horizontal_acceleration_ * _tracker_dt_;
+  // continuing straight
+  if (change_norm < 1e-6) {
+    return std::numeric_limits<double>::infinity();
+  }
 
-    if (current_horizontal_speed_ < 0) {
-      current_horizontal_speed_ = 0;
-    } else {
-      current_horizontal_acceleration_ = -_horizontal_acceleration_;
-    }
+  // reversing the direction
+  if (in.dot(out) < -1.0 + 1e-6 || junction_deviation <= 0) {
+    return 0.0;
   }
 
-  auto current_horizontal_speed = mrs_lib::get_mutexed(mutex_state_, current_horizontal_speed_);
+  auto [speed, acceleration, jerk] = lineConstraints(change / change_norm, constraints);
 
-  if (current_horizontal_speed == 0) {
+  return std::min({sqrt(6.0 * junction_deviation * acceleration) / change_norm, cbrt(36.0 * pow(junction_deviation, 2) * jerk / pow(change_norm, 3)),
+                   sqrt(acceleration * max_blend_length / change_norm), cbrt(pow(max_blend_length, 2) * jerk / change_norm)});
+}
 
-    {
-      std::scoped_lock lock(mutex_state_);
+//}
 
-      current_horizontal_acceleration_ = 0;
-    }
+/* //{ blendDuration() */
 
-    changeStateHorizontal(STOPPING_STATE);
+// the shortest blend of the corner at the speed, which satisfies the constraints, see junctionSpeed()
+double LineTracker::blendDuration(const vec3_t &in, const vec3_t &out, const double speed, const mrs_msgs::DynamicsConstraints &constraints) {
+
+  const vec3_t change      = out - in;
+  const double change_norm = change.norm();
+
+  if (change_norm < 1e-6 || speed <= 0) {
+    return 0.0;
   }
+
+  auto [max_speed, acceleration, jerk] = lineConstraints(change / change_norm, constraints);
+
+  return std::max(2.0 * speed * change_norm / acceleration, 2.0 * sqrt(speed * change_norm / jerk));
 }
 
 //}
 
-/* //{ decelerateVertical() */
+/* //{ lineConstraints() */
 
-void LineTracker::decelerateVertical(void) {
+// the speed, acceleration and jerk limits for a straight-line motion in the given direction,
+// such that the horizontal and the vertical constraints are satisfied at the same time
+std::tuple<double, double, double> LineTracker::lineConstraints(const vec3_t &direction, const mrs_msgs::DynamicsConstraints &constraints) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  const double inf = std::numeric_limits<double>::infinity();
 
-    current_vertical_speed_ -= _vertical_acceleration_ * _tracker_dt_;
+  double speed = inf, acceleration = inf, jerk = inf;
 
-    if (current_vertical_speed_ < 0) {
-      current_vertical_speed_ = 0;
-    } else {
-      current_vertical_acceleration_ = -_vertical_acceleration_;
+  auto saturate = [](double &limit, const double axis_limit, const double direction_component) {
+    if (direction_component > STOP_THR && axis_limit > 0) {
+      limit = std::min(limit, axis_limit / direction_component);
     }
-  }
+  };
 
-  auto current_vertical_speed = mrs_lib::get_mutexed(mutex_state_, current_vertical_speed_);
+  double horizontal = direction.head<2>().norm();
+  double vertical   = fabs(direction(2));
+  bool   ascending  = direction(2) > 0;
 
-  if (current_vertical_speed == 0) {
-    current_vertical_acceleration_ = 0;
-    changeStateVertical(STOPPING_STATE);
+  saturate(speed, constraints.horizontal_speed, horizontal);
+  saturate(acceleration, constraints.horizontal_acceleration, horizontal);
+  saturate(jerk, constraints.horizontal_jerk, horizontal);
+
+  saturate(speed, ascending ? constraints.vertical_ascending_speed : constraints.vertical_descending_speed, vertical);
+  saturate(acceleration, ascending ? constraints.vertical_ascending_acceleration : constraints.vertical_descending_acceleration, vertical);
+  saturate(jerk, ascending ? constraints.vertical_ascending_jerk : constraints.vertical_descending_jerk, vertical);
+
+  // without a jerk constraint, the motion is practically acceleration-limited
+  if (!std::isfinite(jerk)) {
+    jerk = 1e3 * acceleration;
   }
+
+  return std::tuple(speed, acceleration, jerk);
 }
 
 //}
 
-/* //{ stopHorizontal() */
+/* //{ sampleSegment() */
 
-void LineTracker::stopHorizontal(void) {
+Reference_t LineTracker::sampleSegment(const Segment_t &segment, const double t) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  Reference_t reference;
 
-    state_x_                         = 0.95 * state_x_ + 0.05 * goal_x_;
-    state_y_                         = 0.95 * state_y_ + 0.05 * goal_y_;
-    current_horizontal_acceleration_ = 0;
-  }
+  ProfileSample_t sample  = segment.profile.sample(t);
+  ProfileSample_t lateral = segment.lateral.sample(t);
+
+  vec3_t position     = segment.origin + segment.direction * sample.position + segment.lateral_direction * lateral.position;
+  vec3_t velocity     = segment.direction * sample.velocity + segment.lateral_direction * lateral.velocity;
+  vec3_t acceleration = segment.direction * sample.acceleration + segment.lateral_direction * lateral.acceleration;
+  vec3_t jerk         = segment.direction * sample.jerk + segment.lateral_direction * lateral.jerk;
+
+  reference.x      = position(0);
+  reference.y      = position(1);
+  reference.z      = position(2);
+  reference.vel_x  = velocity(0);
+  reference.vel_y  = velocity(1);
+  reference.vel_z  = velocity(2);
+  reference.acc_x  = acceleration(0);
+  reference.acc_y  = acceleration(1);
+  reference.acc_z  = acceleration(2);
+  reference.jerk_x = jerk(0);
+  reference.jerk_y = jerk(1);
+  reference.jerk_z = jerk(2);
+
+  return reference;
 }
 
 //}
 
-/* //{ stopVertical() */
+/* //{ findSegment() */
 
-void LineTracker::stopVertical(void) {
+// the index of the segment active at the time [s] since the start of the motion, should be called with mutex_state_ locked
+int LineTracker::findSegment(const double t) {
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  auto it = std::upper_bound(segments_.begin(), segments_.end(), t, [](const double time, const Segment_t &segment) { return time < segment.start; });
 
-    state_z_                       = 0.95 * state_z_ + 0.05 * goal_z_;
-    current_vertical_acceleration_ = 0;
-  }
+  return std::max(int(it - segments_.begin()) - 1, 0);
 }
 
 //}
 
-// | ------------------------- timers ------------------------- |
+/* //{ motionDuration() */
 
-/* //{ mainTimer() */
+// should be called with mutex_state_ locked
+double LineTracker::motionDuration(void) {
 
-void LineTracker::mainTimer(const ros::TimerEvent &event) {
+  return segments_.back().start + segments_.back().duration();
+}
 
-  if (!is_active_) {
-    return;
-  }
+//}
 
-  mrs_lib::Routine    profiler_routine = profiler_.createRoutine("main", _tracker_loop_rate_, 0.01, event);
-  mrs_lib::ScopeTimer timer            = mrs_lib::ScopeTimer("LineTracker::main", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
+/* //{ sampleMotion() */
 
-  auto [goal_x, goal_y, goal_z]    = mrs_lib::get_mutexed(mutex_goal_, goal_x_, goal_y_, goal_z_);
-  auto [state_x, state_y, state_z] = mrs_lib::get_mutexed(mutex_state_, state_x_, state_y_, state_z_);
+// evaluates the planned motion at the time [s] since its start, should be called with mutex_state_ locked
+Reference_t LineTracker::sampleMotion(const double t) {
 
-  switch (current_state_horizontal_) {
+  Reference_t reference;
 
-    case IDLE_STATE:
+  const Segment_t &segment = segments_[findSegment(t)];
 
-      break;
+  double segment_t = t - segment.start;
 
-    case STOP_MOTION_STATE:
+  if (segment_t < segment.duration()) {
+    reference = sampleSegment(segment, segment_t);
+  } else {
 
-      stopHorizontalMotion();
+    // the motion is finished, hold the goal exactly
+    reference.x = goal_x_;
+    reference.y = goal_y_;
+    reference.z = goal_z_;
+  }
 
-      break;
+  segment.heading.sample(segment_t, reference.heading, reference.heading_rate);
 
-    case ACCELERATING_STATE:
+  return reference;
+}
 
-      accelerateHorizontal();
+//}
 
-      break;
+// | -------------------- waypoint routines ------------------- |
 
-    case DECELERATING_STATE:
+/* //{ flyWaypoints() */
 
-      decelerateHorizontal();
+std::tuple<bool, std::string> LineTracker::flyWaypoints(const int first_idx) {
 
-      break;
+  std::stringstream ss;
 
-    case STOPPING_STATE:
+  ros::Time now = ros::Time::now();
 
-      stopHorizontal();
+  {
+    std::scoped_lock lock(mutex_state_);
 
-      break;
-  }
+    if (waypoints_.empty()) {
 
-  switch (current_state_vertical_) {
+      ss << "can not start trajectory tracking, the trajectory is not set";
+      ROS_WARN_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
 
-    case IDLE_STATE:
+      return std::tuple(false, ss.str());
+    }
 
-      break;
+    if (first_idx >= int(waypoints_.size())) {
 
-    case STOP_MOTION_STATE:
+      ss << "can not resume trajectory tracking, trajectory is already finished";
+      ROS_WARN_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
 
-      stopVerticalMotion();
+      return std::tuple(false, ss.str());
+    }
 
-      break;
+    Reference_t initial = sampleMotion((now - motion_start_time_).toSec());
 
-    case ACCELERATING_STATE:
+    tracking_waypoints_ = true;
+    waypoint_idx_       = first_idx;
 
-      accelerateVertical();
+    planMotion(initial, now, queuedWaypoints(first_idx, initial.heading), first_idx);
 
-      break;
+    ss << "flying through " << waypoints_.size() - first_idx << " waypoints, will take " << motionDuration() << " s";
+  }
 
-    case DECELERATING_STATE:
+  ROS_INFO_STREAM_THROTTLE(1.0, "[LineTracker]: " << ss.str());
 
-      decelerateVertical();
+  return std::tuple(true, ss.str());
+}
 
-      break;
+//}
 
-    case STOPPING_STATE:
+/* //{ queuedWaypoints() */
 
-      stopVertical();
+// the queued waypoints starting from the index, with the headings unwrapped along the way,
+// should be called with mutex_state_ locked
+std::vector<Waypoint_t> LineTracker::queuedWaypoints(const int first_idx, const double initial_heading) {
 
-      break;
-  }
+  std::vector<Waypoint_t> waypoints(waypoints_.begin() + first_idx, waypoints_.end());
 
-  if (current_state_horizontal_ == STOP_MOTION_STATE && current_state_vertical_ == STOP_MOTION_STATE) {
-    if (current_vertical_speed_ == 0 && current_horizontal_speed_ == 0) {
-      if (have_goal_) {
-        changeState(ACCELERATING_STATE);
-      } else {
-        changeState(STOPPING_STATE);
-      }
+  double heading = initial_heading;
+
+  for (Waypoint_t &waypoint : waypoints) {
+
+    if (waypoints_use_heading_) {
+      heading = radians::unwrap(waypoint.heading, heading);
     }
+
+    waypoint.heading = heading;
   }
 
-  if (current_state_horizontal_ == STOPPING_STATE && current_state_vertical_ == STOPPING_STATE) {
-    if (fabs(state_x - goal_x) < 1e-3 && fabs(state_y - goal_y) < 1e-3 && fabs(state_z - goal_z) < 1e-3) {
+  return waypoints;
+}
 
-      {
-        std::scoped_lock lock(mutex_state_);
+//}
 
-        state_x_ = goal_x;
-        state_y_ = goal_y;
-        state_z_ = goal_z;
-      }
+/* //{ updateWaypointProgress() */
 
-      changeState(IDLE_STATE);
+// should be called with mutex_state_ locked
+void LineTracker::updateWaypointProgress(const double t) {
 
-      have_goal_ = false;
-    }
+  if (!tracking_waypoints_) {
+    return;
   }
 
-  {
-    std::scoped_lock lock(mutex_state_);
+  if (t >= motionDuration()) {
 
-    state_x_ += cos(current_heading_) * current_horizontal_speed_ * _tracker_dt_;
-    state_y_ += sin(current_heading_) * current_horizontal_speed_ * _tracker_dt_;
-    state_z_ += current_vertical_direction_ * current_vertical_speed_ * _tracker_dt_;
-  }
+    waypoint_idx_       = waypoints_.size();
+    tracking_waypoints_ = false;
 
-  // --------------------------------------------------------------
-  // |                        heading tracking                        |
-  // --------------------------------------------------------------
-
-  {
-    std::scoped_lock lock(mutex_state_);
+    ROS_INFO("[LineTracker]: the last waypoint reached");
 
-    // compute the desired heading rate
-    double current_heading_rate;
-    if (fabs(goal_heading_ - state_heading_) > M_PI)
-      current_heading_rate = -_heading_gain_ * (goal_heading_ - state_heading_);
-    else
-      current_heading_rate = _heading_gain_ * (goal_heading_ - state_heading_);
-
-    if (current_heading_rate > _heading_rate_) {
-      current_heading_rate = _heading_rate_;
-    } else if (current_heading_rate < -_heading_rate_) {
-      current_heading_rate = -_heading_rate_;
-    }
+    return;
+  }
 
-    // flap the resulted state_heading_ aroud PI
-    state_heading_ += current_heading_rate * _tracker_dt_;
+  int waypoint_idx = segments_[findSegment(t)].waypoint_idx;
 
-    if (fabs(state_heading_ - goal_heading_) < (2 * (_heading_rate_ * _tracker_dt_))) {
-      state_heading_ = goal_heading_;
-    }
+  if (waypoint_idx >= 0) {
+    waypoint_idx_ = waypoint_idx;
   }
 }
 
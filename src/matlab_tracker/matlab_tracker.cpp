@@ -4,6 +4,8 @@
 
 #include <ros/ros.h>
 
+#include <deque>
+
 #include <mrs_uav_managers/tracker.h>
 
 #include <nav_msgs/Odometry.h>
@@ -13,8 +15,13 @@
 #include <mrs_lib/mutex.h>
 #include <mrs_lib/subscribe_handler.h>
 #include <mrs_lib/attitude_converter.h>
+#include <mrs_lib/geometry/cyclic.h>
 
 #include <mrs_msgs/VelocityReferenceSrv.h>
+
+#include <mrs_uav_trackers/shared_reference.h>
+#include <mrs_uav_trackers/motion_profiles.h>
+#include <mrs_uav_trackers/position_command_pool.h>
 //}
 
 /* defines //{ */
@@ -23,6 +30,12 @@
 
 //}
 
+/* using //{ */
+
+using sradians = mrs_lib::geometry::sradians;
+
+//}
+
 namespace mrs_uav_trackers
 {
 
@@ -73,6 +86,51 @@ private:
 
   mrs_lib::SubscribeHandler<nav_msgs::Odometry> sh_goal_;
 
+  void callbackGoal(mrs_lib::SubscribeHandler<nav_msgs::Odometry> &wrp);
+
+  double _goal_timeout_;
+
+  // the goal message packs the acceleration and the heading into the unused fields
+  SharedReference_t referenceFromGoal(const nav_msgs::Odometry &goal, const ros::Time &stamp);
+
+  // | -------------------- reference buffer -------------------- |
+
+  // the last few references ordered by their stamps, the output is interpolated between them
+  std::deque<SharedReference_t> buffer_;
+  std::mutex                    mutex_buffer_;
+
+  int    _buffer_length_;
+  double _max_extrapolation_;
+  double _render_delay_;
+
+  void              bufferReference(const SharedReference_t &reference);
+  SharedReference_t sampleReference(const double time);
+
+  // | ------------------------- hover -------------------------- |
+
+  // engaged when the references stop coming, the UAV is stopped smoothly from its current motion
+  bool                         hovering_ = false;
+  mrs_msgs::PositionCommand    hover_output_;
+  ros::Time                    hover_start_time_;
+  std::array<SCurveProfile, 3> hover_stop_;
+
+  double _hover_acceleration_;
+  double _hover_jerk_;
+
+  // | ------------------ shared memory interface ---------------- |
+
+  // optional, for co-located reference generators
+  bool                       _shared_memory_enabled_ = false;
+  std::string                _shared_memory_name_;
+  SharedReferenceBuffer::Ptr shared_buffer_;
+
+  // moves a new shared memory sample to the buffer, returns the newest buffered reference
+  std::optional<SharedReference_t> freshestReference(void);
+
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
+
   // | ------------------------ profiler ------------------------ |
 
   mrs_lib::Profiler profiler;
@@ -118,12 +176,26 @@ void MatlabTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]
   param_loader.loadParam("enable_profiler", _profiler_enabled_);
   param_loader.loadParam("position_mode", _position_mode_);
   param_loader.loadParam("tilt_mode", _tilt_mode_);
+  param_loader.loadParam("goal_timeout", _goal_timeout_);
+  param_loader.loadParam("buffer/length", _buffer_length_);
+  param_loader.loadParam("buffer/max_extrapolation", _max_extrapolation_);
+  param_loader.loadParam("buffer/render_delay", _render_delay_);
+  param_loader.loadParam("hover/acceleration", _hover_acceleration_);
+  param_loader.loadParam("hover/jerk", _hover_jerk_);
+
+  param_loader.loadParam("shared_memory/enabled", _shared_memory_enabled_);
+  param_loader.loadParam("shared_memory/name", _shared_memory_name_);
 
   if (!param_loader.loadedSuccessfully()) {
     ROS_ERROR("[MatlabTracker]: could not load all parameters!");
     ros::shutdown();
   }
 
+  if (_render_delay_ < 0) {
+    ROS_ERROR("[MatlabTracker]: buffer/render_delay should be >= 0");
+    ros::shutdown();
+  }
+
   // | ------------------------ profiler ------------------------ |
 
   profiler = mrs_lib::Profiler(nh_, "matlabtracker", _profiler_enabled_);
@@ -139,7 +211,20 @@ void MatlabTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]
   shopts.autostart       = true;
   shopts.transport_hints = ros::TransportHints().tcpNoDelay();
 
-  sh_goal_ = mrs_lib::SubscribeHandler<nav_msgs::Odometry>(shopts, "goal_in");
+  sh_goal_ = mrs_lib::SubscribeHandler<nav_msgs::Odometry>(shopts, "goal_in", &MatlabTracker::callbackGoal, this);
+
+  // | ------------------ shared memory interface ---------------- |
+
+  if (_shared_memory_enabled_) {
+
+    shared_buffer_ = SharedReferenceBuffer::open(_shared_memory_name_);
+
+    if (shared_buffer_) {
+      ROS_INFO("[MatlabTracker]: reading the references from the shared memory '%s'", _shared_memory_name_.c_str());
+    } else {
+      ROS_ERROR("[MatlabTracker]: could not open the shared memory '%s', only the ROS topic will be used", _shared_memory_name_.c_str());
+    }
+  }
 
   // | --------------------- finish the init -------------------- |
 
@@ -156,11 +241,19 @@ std::tuple<bool, std::string> MatlabTracker::activate([[maybe_unused]] const mrs
 
   std::stringstream ss;
 
-  if (!sh_goal_.hasMsg()) {
+  auto reference = freshestReference();
+
+  if (!reference) {
     ss << "missing Matlab command";
     return std::tuple(false, ss.str());
   }
 
+  if ((ros::Time::now().toSec() - reference->stamp * 1e-9) > _goal_timeout_) {
+    ss << "the Matlab command is too old";
+    return std::tuple(false, ss.str());
+  }
+
+  hovering_  = false;
   is_active_ = true;
 
   ss << "activated";
@@ -204,27 +297,111 @@ const mrs_msgs::PositionCommand::ConstPtr MatlabTracker::update(const mrs_msgs::
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  position_output_.header.stamp    = ros::Time::now();
-  position_output_.header.frame_id = uav_state->header.frame_id;
+  ros::Time now = ros::Time::now();
+
+  auto reference = freshestReference();
+
+  // | ------------------- timeout to a hover ------------------- |
+
+  if (!reference || (now.toSec() - reference->stamp * 1e-9) > _goal_timeout_) {
 
-  nav_msgs::OdometryConstPtr goal = sh_goal_.getMsg();
+    if (!hovering_) {
+
+      ROS_WARN("[MatlabTracker]: the reference timeouted, stopping and hovering");
+
+      hover_output_ = mrs_msgs::PositionCommand();
+
+      // stop from the last reference, if it was a full-state one, otherwise from the current motion of the UAV
+      std::array<double, 3> position     = {uav_state->pose.position.x, uav_state->pose.position.y, uav_state->pose.position.z};
+      std::array<double, 3> velocity     = {uav_state->velocity.linear.x, uav_state->velocity.linear.y, uav_state->velocity.linear.z};
+      std::array<double, 3> acceleration = {0, 0, 0};
+
+      if (_position_mode_ && position_output_.use_position_horizontal) {
+        position     = {position_output_.position.x, position_output_.position.y, position_output_.position.z};
+        velocity     = {position_output_.velocity.x, position_output_.velocity.y, position_output_.velocity.z};
+        acceleration = {position_output_.acceleration.x, position_output_.acceleration.y, position_output_.acceleration.z};
+      }
+
+      for (int i = 0; i < 3; i++) {
+        hover_stop_[i] = SCurveProfile::stop(position[i], velocity[i], acceleration[i], _hover_acceleration_, _hover_jerk_);
+      }
+
+      hover_start_time_ = now;
+
+      try {
+        hover_output_.heading = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeading();
+      }
+      catch (...) {
+        ROS_ERROR("[MatlabTracker]: could not calculate the UAV heading");
+      }
+
+      hover_output_.use_position_horizontal = 1;
+      hover_output_.use_position_vertical   = 1;
+      hover_output_.use_velocity_horizontal = 1;
+      hover_output_.use_velocity_vertical   = 1;
+      hover_output_.use_acceleration        = 1;
+      hover_output_.use_jerk                = 1;
+      hover_output_.use_heading             = 1;
+
+      hovering_ = true;
+    }
+
+    double t = (now - hover_start_time_).toSec();
+
+    ProfileSample_t x = hover_stop_[0].sample(t);
+    ProfileSample_t y = hover_stop_[1].sample(t);
+    ProfileSample_t z = hover_stop_[2].sample(t);
+
+    hover_output_.position.x     = x.position;
+    hover_output_.position.y     = y.position;
+    hover_output_.position.z     = z.position;
+    hover_output_.velocity.x     = x.velocity;
+    hover_output_.velocity.y     = y.velocity;
+    hover_output_.velocity.z     = z.velocity;
+    hover_output_.acceleration.x = x.acceleration;
+    hover_output_.acceleration.y = y.acceleration;
+    hover_output_.acceleration.z = z.acceleration;
+    hover_output_.jerk.x         = x.jerk;
+    hover_output_.jerk.y         = y.jerk;
+    hover_output_.jerk.z         = z.jerk;
+
+    hover_output_.header.stamp    = now;
+    hover_output_.header.frame_id = uav_state->header.frame_id;
+
+    mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+    *position_cmd = hover_output_;
+
+    return position_cmd;
+  }
+
+  if (hovering_) {
+    ROS_INFO("[MatlabTracker]: the reference is coming again");
+    hovering_ = false;
+  }
+
+  // extrapolated from the newest reference to the controller tick, optionally delayed to interpolate between the buffered ones instead
+  const SharedReference_t goal = sampleReference(now.toSec() - _render_delay_);
+
+  position_output_.header.stamp    = now;
+  position_output_.header.frame_id = uav_state->header.frame_id;
 
   if (_position_mode_) {
 
-    position_output_.position.x = goal->pose.pose.position.x;
-    position_output_.position.y = goal->pose.pose.position.y;
-    position_output_.position.z = goal->pose.pose.position.z;
+    position_output_.position.x = goal.position[0];
+    position_output_.position.y = goal.position[1];
+    position_output_.position.z = goal.position[2];
 
-    position_output_.velocity.x = goal->twist.twist.linear.x;
-    position_output_.velocity.y = goal->twist.twist.linear.y;
-    position_output_.velocity.z = goal->twist.twist.linear.z;
+    position_output_.velocity.x = goal.velocity[0];
+    position_output_.velocity.y = goal.velocity[1];
+    position_output_.velocity.z = goal.velocity[2];
 
-    position_output_.acceleration.x = goal->twist.twist.angular.x;
-    position_output_.acceleration.y = goal->twist.twist.angular.y;
-    position_output_.acceleration.z = goal->twist.twist.angular.z;
+    position_output_.acceleration.x = goal.acceleration[0];
+    position_output_.acceleration.y = goal.acceleration[1];
+    position_output_.acceleration.z = goal.acceleration[2];
 
-    position_output_.heading      = goal->pose.pose.orientation.x;
-    position_output_.heading_rate = goal->pose.pose.orientation.y;
+    position_output_.heading      = goal.heading;
+    position_output_.heading_rate = goal.heading_rate;
 
     position_output_.use_heading             = 1;
     position_output_.use_heading_rate        = 1;
@@ -237,14 +414,25 @@ const mrs_msgs::PositionCommand::ConstPtr MatlabTracker::update(const mrs_msgs::
 
   if (_tilt_mode_) {
 
-    position_output_.position.z            = goal->pose.pose.position.z;
+    position_output_.position.z            = goal.position[2];
     position_output_.use_position_vertical = 1;
 
-    position_output_.orientation     = mrs_lib::AttitudeConverter(goal->pose.pose.orientation);
+    geometry_msgs::Quaternion orientation;
+
+    orientation.x = goal.orientation[0];
+    orientation.y = goal.orientation[1];
+    orientation.z = goal.orientation[2];
+    orientation.w = goal.orientation[3];
+
+    position_output_.orientation     = mrs_lib::AttitudeConverter(orientation);
     position_output_.use_orientation = 1;
   }
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_output_));
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+  *position_cmd = position_output_;
+
+  return position_cmd;
 }
 
 //}
@@ -378,6 +566,194 @@ const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr MatlabTracker::setTraje
 
 //}
 
+// --------------------------------------------------------------
+// |                          callbacks                         |
+// --------------------------------------------------------------
+
+/* callbackGoal() //{ */
+
+void MatlabTracker::callbackGoal(mrs_lib::SubscribeHandler<nav_msgs::Odometry> &wrp) {
+
+  if (!is_initialized_) {
+    return;
+  }
+
+  nav_msgs::OdometryConstPtr goal = wrp.getMsg();
+
+  // unstamped goals are stamped on arrival
+  ros::Time stamp = goal->header.stamp.isZero() ? ros::Time::now() : goal->header.stamp;
+
+  bufferReference(referenceFromGoal(*goal, stamp));
+}
+
+//}
+
+// --------------------------------------------------------------
+// |                          routines                          |
+// --------------------------------------------------------------
+
+/* referenceFromGoal() //{ */
+
+SharedReference_t MatlabTracker::referenceFromGoal(const nav_msgs::Odometry &goal, const ros::Time &stamp) {
+
+  SharedReference_t reference;
+
+  reference.stamp = stamp.toNSec();
+
+  reference.position[0] = goal.pose.pose.position.x;
+  reference.position[1] = goal.pose.pose.position.y;
+  reference.position[2] = goal.pose.pose.position.z;
+
+  reference.velocity[0] = goal.twist.twist.linear.x;
+  reference.velocity[1] = goal.twist.twist.linear.y;
+  reference.velocity[2] = goal.twist.twist.linear.z;
+
+  reference.acceleration[0] = goal.twist.twist.angular.x;
+  reference.acceleration[1] = goal.twist.twist.angular.y;
+  reference.acceleration[2] = goal.twist.twist.angular.z;
+
+  // in the position mode, the orientation carries the heading and its rate,
+  // in the tilt mode, it is the desired orientation
+  reference.heading      = goal.pose.pose.orientation.x;
+  reference.heading_rate = goal.pose.pose.orientation.y;
+
+  reference.orientation[0] = goal.pose.pose.orientation.x;
+  reference.orientation[1] = goal.pose.pose.orientation.y;
+  reference.orientation[2] = goal.pose.pose.orientation.z;
+  reference.orientation[3] = goal.pose.pose.orientation.w;
+
+  return reference;
+}
+
+//}
+
+/* freshestReference() //{ */
+
+std::optional<SharedReference_t> MatlabTracker::freshestReference(void) {
+
+  SharedReference_t shared;
+
+  if (shared_buffer_ && shared_buffer_->latest(shared)) {
+    bufferReference(shared);
+  }
+
+  std::scoped_lock lock(mutex_buffer_);
+
+  if (buffer_.empty()) {
+    return {};
+  }
+
+  return buffer_.back();
+}
+
+//}
+
+/* bufferReference() //{ */
+
+void MatlabTracker::bufferReference(const SharedReference_t &reference) {
+
+  std::scoped_lock lock(mutex_buffer_);
+
+  // already buffered or out of order
+  if (!buffer_.empty() && reference.stamp <= buffer_.back().stamp) {
+    return;
+  }
+
+  buffer_.push_back(reference);
+
+  while (int(buffer_.size()) > _buffer_length_) {
+    buffer_.pop_front();
+  }
+}
+
+//}
+
+/* sampleReference() //{ */
+
+SharedReference_t MatlabTracker::sampleReference(const double time) {
+
+  std::scoped_lock lock(mutex_buffer_);
+
+  // | ------------- extrapolate beyond the newest one ------------ |
+
+  const SharedReference_t &newest = buffer_.back();
+
+  if (time >= newest.stamp * 1e-9 || buffer_.size() == 1) {
+
+    double dt = std::clamp(time - newest.stamp * 1e-9, 0.0, _max_extrapolation_);
+
+    SharedReference_t sample = newest;
+
+    for (int i = 0; i < 3; i++) {
+      sample.position[i] += newest.velocity[i] * dt + 0.5 * newest.acceleration[i] * dt * dt;
+      sample.velocity[i] += newest.acceleration[i] * dt;
+    }
+
+    sample.heading = sradians::wrap(sample.heading + newest.heading_rate * dt);
+
+    return sample;
+  }
+
+  // | --------------- before the oldest one, hold it -------------- |
+
+  if (time <= buffer_.front().stamp * 1e-9) {
+
+    SharedReference_t sample = buffer_.front();
+
+    sample.heading = sradians::wrap(sample.heading);
+
+    return sample;
+  }
+
+  // | ------------------ interpolate in between ------------------ |
+
+  auto after = std::upper_bound(buffer_.begin(), buffer_.end(), time,
+                                [](const double t, const SharedReference_t &reference) { return t < reference.stamp * 1e-9; });
+
+  const SharedReference_t &a = *(after - 1);
+  const SharedReference_t &b = *after;
+
+  double h  = (b.stamp - a.stamp) * 1e-9;
+  double s  = (time - a.stamp * 1e-9) / h;
+  double s2 = s * s;
+  double s3 = s2 * s;
+
+  SharedReference_t sample = a;
+
+  // cubic Hermite spline through the positions and velocities, its derivative is the velocity
+  for (int i = 0; i < 3; i++) {
+
+    sample.position[i] = (2 * s3 - 3 * s2 + 1) * a.position[i] + (s3 - 2 * s2 + s) * h * a.velocity[i] + (-2 * s3 + 3 * s2) * b.position[i] +
+                         (s3 - s2) * h * b.velocity[i];
+
+    sample.velocity[i] = (6 * s2 - 6 * s) / h * a.position[i] + (3 * s2 - 4 * s + 1) * a.velocity[i] + (-6 * s2 + 6 * s) / h * b.position[i] +
+                         (3 * s2 - 2 * s) * b.velocity[i];
+
+    sample.acceleration[i] = (1 - s) * a.acceleration[i] + s * b.acceleration[i];
+  }
+
+  sample.heading      = sradians::wrap(a.heading + s * sradians::diff(b.heading, a.heading));
+  sample.heading_rate = (1 - s) * a.heading_rate + s * b.heading_rate;
+
+  Eigen::Quaterniond qa(a.orientation[3], a.orientation[0], a.orientation[1], a.orientation[2]);
+  Eigen::Quaterniond qb(b.orientation[3], b.orientation[0], b.orientation[1], b.orientation[2]);
+
+  // only meaningful in the tilt mode, the position mode packs other values in there
+  if (_tilt_mode_ && qa.norm() > 1e-3 && qb.norm() > 1e-3) {
+
+    Eigen::Quaterniond q = qa.normalized().slerp(s, qb.normalized());
+
+    sample.orientation[0] = q.x();
+    sample.orientation[1] = q.y();
+    sample.orientation[2] = q.z();
+    sample.orientation[3] = q.w();
+  }
+
+  return sample;
+}
+
+//}
+
 }  // namespace matlab_tracker
 
 }  // namespace mrs_uav_trackers
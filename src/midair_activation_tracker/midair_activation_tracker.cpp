@@ -6,6 +6,8 @@
 
 #include <mrs_uav_managers/tracker.h>
 
+#include <mrs_uav_trackers/position_command_pool.h>
+
 #include <mrs_lib/profiler.h>
 #include <mrs_lib/mutex.h>
 #include <mrs_lib/attitude_converter.h>
@@ -15,6 +17,12 @@
 
 //}
 
+/* using //{ */
+
+using vec3_t = mrs_lib::geometry::vec_t<3>;
+
+//}
+
 namespace mrs_uav_trackers
 {
 
@@ -64,6 +72,23 @@ private:
   bool is_initialized_ = false;
   bool is_active_      = false;
 
+  // | ------------------------ uav state ----------------------- |
+
+  mrs_msgs::UavState uav_state_;
+  bool               got_uav_state_ = false;
+  std::mutex         mutex_uav_state_;
+
+  // | ---------------- the estimator-consistent reference -------------- |
+
+  // the estimated acceleration is noisy, it is low-pass filtered before it is passed on
+  double    _acceleration_time_constant_;
+  vec3_t    acceleration_filtered_ = vec3_t::Zero();
+  ros::Time last_update_time_;
+
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
+
   // | ------------------------ profiler ------------------------ |
 
   mrs_lib::Profiler profiler_;
@@ -97,6 +122,12 @@ void MidairActivationTracker::initialize(const ros::NodeHandle &parent_nh, [[may
   }
 
   param_loader.loadParam("enable_profiler", _profiler_enabled_);
+  param_loader.loadParam("acceleration_filter/time_constant", _acceleration_time_constant_);
+
+  if (!param_loader.loadedSuccessfully()) {
+    ROS_ERROR("[MidairActivationTracker]: could not load all parameters!");
+    ros::shutdown();
+  }
 
   // | --------------------- finish the init -------------------- |
 
@@ -113,9 +144,23 @@ std::tuple<bool, std::string> MidairActivationTracker::activate([[maybe_unused]]
 
   std::stringstream ss;
 
+  // the filter starts from the current estimate, so the first output matches the state
+  if (got_uav_state_) {
+
+    auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
+
+    acceleration_filtered_ = vec3_t(uav_state.acceleration.linear.x, uav_state.acceleration.linear.y, uav_state.acceleration.linear.z);
+
+  } else {
+
+    acceleration_filtered_ = vec3_t::Zero();
+  }
+
+  last_update_time_ = ros::Time::now();
+
   is_active_ = true;
 
-  ss << "activated";
+  ss << "activated, following the estimated state";
   ROS_INFO_STREAM("[MidairActivationTracker]: " << ss.str());
 
   return std::tuple(true, ss.str());
@@ -148,6 +193,14 @@ bool MidairActivationTracker::resetStatic(void) {
 const mrs_msgs::PositionCommand::ConstPtr MidairActivationTracker::update(const mrs_msgs::UavState::ConstPtr &                        uav_state,
                                                                           [[maybe_unused]] const mrs_msgs::AttitudeCommand::ConstPtr &last_attitude_cmd) {
 
+  {
+    std::scoped_lock lock(mutex_uav_state_);
+
+    uav_state_ = *uav_state;
+
+    got_uav_state_ = true;
+  }
+
   // up to this part the update() method is evaluated even when the tracker is not active
   if (!is_active_) {
     return mrs_msgs::PositionCommand::Ptr();
@@ -157,38 +210,69 @@ const mrs_msgs::PositionCommand::ConstPtr MidairActivationTracker::update(const
   mrs_lib::ScopeTimer timer =
       mrs_lib::ScopeTimer("MidairActivationTracker::update", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
 
-  mrs_msgs::PositionCommand position_cmd;
+  ros::Time now = ros::Time::now();
+
+  double dt = std::max((now - last_update_time_).toSec(), 0.0);
+
+  last_update_time_ = now;
+
+  // | --------------- filter the estimated acceleration ------------- |
+
+  vec3_t acceleration(uav_state->acceleration.linear.x, uav_state->acceleration.linear.y, uav_state->acceleration.linear.z);
+
+  double alpha = _acceleration_time_constant_ > 0 ? dt / (_acceleration_time_constant_ + dt) : 1.0;
 
-  position_cmd.header.frame_id = uav_state->header.frame_id;
-  position_cmd.header.stamp    = ros::Time::now();
+  acceleration_filtered_ += alpha * (acceleration - acceleration_filtered_);
 
-  position_cmd.position.x = uav_state->pose.position.x;
-  position_cmd.position.y = uav_state->pose.position.y;
-  position_cmd.position.z = uav_state->pose.position.z;
+  // | ------------- the reference matching the state ------------- |
 
-  position_cmd.velocity.x = uav_state->velocity.linear.x;
-  position_cmd.velocity.y = uav_state->velocity.linear.y;
-  position_cmd.velocity.z = uav_state->velocity.linear.z;
+  // the next tracker is activated from this command, so it should describe the current
+  // motion fully, including the acceleration and the heading rate
+
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
+
+  position_cmd->header.frame_id = uav_state->header.frame_id;
+  position_cmd->header.stamp    = now;
+
+  position_cmd->position.x = uav_state->pose.position.x;
+  position_cmd->position.y = uav_state->pose.position.y;
+  position_cmd->position.z = uav_state->pose.position.z;
+
+  position_cmd->velocity.x = uav_state->velocity.linear.x;
+  position_cmd->velocity.y = uav_state->velocity.linear.y;
+  position_cmd->velocity.z = uav_state->velocity.linear.z;
+
+  position_cmd->acceleration.x = acceleration_filtered_(0);
+  position_cmd->acceleration.y = acceleration_filtered_(1);
+  position_cmd->acceleration.z = acceleration_filtered_(2);
 
   try {
-    position_cmd.heading = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeading();
+    position_cmd->heading = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeading();
   }
   catch (...) {
-    position_cmd.heading = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getYaw();
+    position_cmd->heading = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getYaw();
     ROS_WARN_THROTTLE(1.0, "[MidairActivationTracker]: could not get heading");
   }
 
-  position_cmd.use_position_vertical   = true;
-  position_cmd.use_position_horizontal = true;
+  try {
+    position_cmd->heading_rate     = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeadingRate(uav_state->velocity.angular);
+    position_cmd->use_heading_rate = true;
+  }
+  catch (...) {
+    position_cmd->use_heading_rate = false;
+  }
+
+  position_cmd->use_position_vertical   = true;
+  position_cmd->use_position_horizontal = true;
 
-  position_cmd.use_velocity_vertical   = true;
-  position_cmd.use_velocity_horizontal = true;
+  position_cmd->use_velocity_vertical   = true;
+  position_cmd->use_velocity_horizontal = true;
 
-  position_cmd.use_heading = true;
+  position_cmd->use_acceleration = true;
 
-  ROS_WARN_THROTTLE(0.1, "[MidairActivationTracker]: outputting cmd");
+  position_cmd->use_heading = true;
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  return position_cmd;
 }
 
 //}
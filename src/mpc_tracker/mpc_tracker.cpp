@@ -6,6 +6,9 @@
 
 #include <mrs_uav_managers/tracker.h>
 
+#include <mrs_uav_trackers/position_command_pool.h>
+#include <mrs_uav_trackers/motion_profiles.h>
+
 #include <geometry_msgs/Pose.h>
 #include <geometry_msgs/PoseArray.h>
 
@@ -17,6 +20,7 @@
 #include <mrs_msgs/OdometryDiag.h>
 #include <mrs_msgs/VelocityReference.h>
 #include <mrs_msgs/VelocityReferenceSrv.h>
+#include <mrs_msgs/Float64Srv.h>
 
 #include <std_msgs/String.h>
 
@@ -34,6 +38,8 @@
 
 #include <dynamic_reconfigure/server.h>
 #include <mrs_uav_trackers/mpc_trackerConfig.h>
+#include <mrs_uav_trackers/MpcTrackerSolverDiagnostics.h>
+#include <mrs_uav_trackers/MpcTrackerSolverTelemetry.h>
 
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -175,8 +181,21 @@ private:
   std::atomic<bool> trajectory_tracking_in_progress_ = false;
   int               trajectory_tracking_sub_idx_     = 0;  // increases with every iteration of the simulated model
   int               trajectory_tracking_idx_         = 0;  // while tracking, this is the current index in the des_*_whole trajectory
+  ros::Time         trajectory_start_time_;                // the time of the first sample of the des_*_whole trajectory
+  double            trajectory_tracking_progress_    = 0;  // the fraction of a sample carried over when the time is scaled
   std::mutex        mutex_trajectory_tracking_states_;
 
+  // the trajectory is flown faster (> 1) or slower (< 1) than sampled
+  double trajectory_time_scale_           = 1.0;  // the applied one, follows the target smoothly
+  double trajectory_time_scale_target_    = 1.0;  // the requested one bounded by the constraints
+  double trajectory_time_scale_requested_ = 1.0;
+  double _trajectory_time_scaling_min_;
+  double _trajectory_time_scaling_max_;
+  double _trajectory_time_scaling_rate_;
+
+  ros::ServiceServer service_server_trajectory_time_scale_;
+  bool               callbackTrajectoryTimeScale(mrs_msgs::Float64Srv::Request& req, mrs_msgs::Float64Srv::Response& res);
+
   // params of the loaded trajectory
   int    trajectory_size_          = 0;
   double trajectory_dt_            = 0.2;
@@ -185,6 +204,47 @@ private:
   bool   trajectory_set_           = false;
   int    trajectory_count_         = 0;  // counts how many trajectories we have received
 
+  // sparse trajectories are upsampled by splines when loaded
+  bool   _trajectory_upsampling_enabled_;
+  double _trajectory_upsampling_dt_;
+
+  // the parts of the trajectories violating the constraints are slowed down when loaded
+  bool   _trajectory_retiming_enabled_;
+  double _trajectory_retiming_blend_time_;
+  double _trajectory_retiming_max_time_scale_;
+  double _trajectory_retiming_noise_;
+
+  // a preprocessed trajectory, ready to be swapped in as the active one
+  struct PreparedTrajectory_t
+  {
+    std::shared_ptr<VectorXd> x;
+    std::shared_ptr<VectorXd> y;
+    std::shared_ptr<VectorXd> z;
+    std::shared_ptr<VectorXd> heading;
+
+    int       size;
+    double    dt;
+    int       subsample_offset;
+    bool      loop;
+    bool      use_heading;
+    bool      fly_now;
+    int       input_id;
+    ros::Time switch_time;
+    ros::Time start_time;  // the time of the first sample
+    double    time_scale;
+  };
+
+  // trajectories stamped in the future are kept in standby and handed over by the mpc timer at their stamp
+  bool                                  _trajectory_handover_enabled_;
+  double                                _trajectory_handover_max_jump_;
+  std::shared_ptr<PreparedTrajectory_t> standby_trajectory_;
+  std::mutex                            mutex_standby_trajectory_;
+
+  // trajectories overlapping the tracked one in time are spliced into it, keeping the in-flight horizon
+  bool   _trajectory_merging_enabled_;
+  double _trajectory_merging_tolerance_;
+  double _trajectory_merging_max_jump_;
+
   // mpc output
   VectorXd   mpc_u_;
   double     mpc_u_heading_;
@@ -202,6 +262,8 @@ private:
   // predicting the future
   MatrixXd   predicted_trajectory_;
   MatrixXd   predicted_heading_trajectory_;
+  ros::Time  predicted_trajectory_stamp_;
+  int        predicted_trajectory_id_ = 0;
   std::mutex mutex_predicted_trajectory_;
 
   mrs_lib::PublisherHandler<geometry_msgs::PoseArray>         ph_predicted_trajectory_debugging_;
@@ -211,6 +273,19 @@ private:
 
   std::atomic<bool> mpc_computed_ = false;
 
+  // the predictions are published by their own timers, so the MPC timer does not spend time on them
+  ros::Timer timer_prediction_poses_;
+  double     _prediction_poses_rate_;
+  void       timerPredictionPoses(const ros::TimerEvent& event);
+
+  ros::Timer timer_prediction_full_state_;
+  double     _prediction_full_state_rate_;
+  void       timerPredictionFullState(const ros::TimerEvent& event);
+
+  // the MPC reference is only at hand in the MPC timer, it is published from there when subscribed, at most at this rate
+  double    _mpc_reference_rate_;
+  ros::Time mpc_reference_last_publish_time_ = ros::Time(0);
+
   bool brake_ = false;
 
   // | ----------------------- MPC solver ----------------------- |
@@ -224,11 +299,59 @@ private:
   int _max_iters_z_;
   int _max_iters_heading_;
 
+  // the horizontal speed limit is split between the x and y solvers by the direction of the motion
+  bool   _coupled_xy_enabled_;
+  double _coupled_xy_min_axis_ratio_;
+  double _coupled_xy_lookahead_;
+  double _coupled_xy_max_rotation_rate_;
+  double coupled_xy_angle_ = M_PI / 4.0;  // [rad] the applied direction of the split, folded to [0, pi/2]
+
   // | ----------- measuring the "MPC realtime factor" ---------- |
 
   ros::Time mpc_start_time_;
   double    mpc_total_delay_ = 0;
 
+  // | ------------ skipping the solvers when settled ----------- |
+
+  bool   _settled_fast_path_enabled_;
+  double _settled_position_tolerance_;
+  double _settled_heading_tolerance_;
+  double _settled_derivative_tolerance_;
+
+  // the stationary reference and the limits of the last solved iteration
+  bool     settled_setpoint_valid_ = false;
+  VectorXd settled_setpoint_;
+  VectorXd settled_limits_;
+
+  // | ------------------- solver diagnostics ------------------- |
+
+  mrs_lib::PublisherHandler<mrs_uav_trackers::MpcTrackerSolverDiagnostics> pub_solver_diagnostics_;
+  mrs_lib::PublisherHandler<mrs_uav_trackers::MpcTrackerSolverTelemetry>   pub_solver_telemetry_;
+
+  // accumulated between the diagnostics messages, per solver: x, y, z, heading
+  struct SolverStatistics_t
+  {
+    int                solves          = 0;
+    int                skips           = 0;
+    double             solver_time     = 0;
+    double             max_solver_time = 0;
+    std::array<int, 4> iterations{};
+    std::array<int, 4> max_iterations{};
+    std::array<int, 4> iteration_limit_hits{};
+    std::array<int, 4> saturations{};
+  };
+
+  SolverStatistics_t solver_statistics_;
+  std::mutex         mutex_solver_statistics_;
+
+  // all the solves so far, the time saved by the skips is estimated by their mean even in the windows without any solve
+  unsigned long total_solves_      = 0;
+  double        total_solver_time_ = 0;
+
+  ros::Timer timer_solver_diagnostics_;
+  double     _solver_diagnostics_rate_;
+  void       timerSolverDiagnostics(const ros::TimerEvent& event);
+
   // | ------------------- collision avoidance ------------------ |
 
   // configurable params
@@ -353,7 +476,22 @@ private:
   void setRelativeGoal(const double pos_x, const double pos_y, const double pos_z, const double heading, const bool use_heading);
   void setSinglePointReference(const double x, const double y, const double z, const double heading);
 
-  std::tuple<bool, std::string, bool> loadTrajectory(const mrs_msgs::TrajectoryReference msg);
+  std::tuple<bool, std::string, bool> loadTrajectory(mrs_msgs::TrajectoryReference msg);
+  std::tuple<bool, std::string>       mergeTrajectory(const mrs_msgs::TrajectoryReference& msg, const double trajectory_dt);
+  void                                applyTrajectory(const PreparedTrajectory_t& trajectory);
+  void                                dropStandbyTrajectory(void);
+  std::vector<mrs_msgs::Reference>    upsampleTrajectory(const std::vector<mrs_msgs::Reference>& keyframes, const double keyframe_dt, const double dt,
+                                                          const bool loop);
+
+  void publishProcessedTrajectory(const std::string& frame_id, const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading,
+                                  const int size);
+
+  VectorXd trajectoryTimeScale(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading, const double dt,
+                               const mrs_msgs::DynamicsConstraints& constraints, const bool use_heading);
+  std::tuple<VectorXd, VectorXd, VectorXd, VectorXd> retimeTrajectory(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading,
+                                                                      const double dt, const VectorXd& time_scale);
+  double boundTrajectoryTimeScale(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading, const double dt, const bool use_heading,
+                                  const double time_scale);
 
   MatrixXd                       filterReferenceZ(const VectorXd& des_z_trajectory, const double max_ascending_speed, const double max_descending_speed);
   std::tuple<MatrixXd, MatrixXd> filterReferenceXY(const VectorXd& des_x_trajectory, const VectorXd& des_y_trajectory, double max_speed_x, double max_speed_y);
@@ -364,6 +502,10 @@ private:
   void calculateMPC(void);
   void iterateModel(void);
 
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
+
   // | ------------------------ profiler ------------------------ |
 
   mrs_lib::Profiler profiler;
@@ -450,9 +592,48 @@ void MpcTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused]] c
 
   param_loader.loadParam("mpc_solver/dt2", _dt2_);
 
+  param_loader.loadParam("trajectory_upsampling/enabled", _trajectory_upsampling_enabled_);
+  param_loader.loadParam("trajectory_upsampling/dt", _trajectory_upsampling_dt_);
+
+  if (_trajectory_upsampling_dt_ < _dt1_) {
+    ROS_ERROR("[MpcTracker]: trajectory_upsampling/dt should be >= 1/mpc_rate");
+    ros::shutdown();
+  }
+
+  param_loader.loadParam("trajectory_retiming/enabled", _trajectory_retiming_enabled_);
+  param_loader.loadParam("trajectory_retiming/blend_time", _trajectory_retiming_blend_time_);
+  param_loader.loadParam("trajectory_retiming/max_time_scale", _trajectory_retiming_max_time_scale_);
+  param_loader.loadParam("trajectory_retiming/noise", _trajectory_retiming_noise_);
+
+  if (_trajectory_retiming_max_time_scale_ < 1.0) {
+    ROS_ERROR("[MpcTracker]: trajectory_retiming/max_time_scale should be >= 1.0");
+    ros::shutdown();
+  }
+
+  param_loader.loadParam("trajectory_handover/enabled", _trajectory_handover_enabled_);
+  param_loader.loadParam("trajectory_handover/max_jump", _trajectory_handover_max_jump_);
+
+  param_loader.loadParam("trajectory_merging/enabled", _trajectory_merging_enabled_);
+  param_loader.loadParam("trajectory_merging/tolerance", _trajectory_merging_tolerance_);
+  param_loader.loadParam("trajectory_merging/max_jump", _trajectory_merging_max_jump_);
+
+  param_loader.loadParam("trajectory_time_scaling/min", _trajectory_time_scaling_min_);
+  param_loader.loadParam("trajectory_time_scaling/max", _trajectory_time_scaling_max_);
+  param_loader.loadParam("trajectory_time_scaling/rate", _trajectory_time_scaling_rate_);
+
+  if (_trajectory_time_scaling_min_ <= 0 || _trajectory_time_scaling_max_ < _trajectory_time_scaling_min_) {
+    ROS_ERROR("[MpcTracker]: trajectory_time_scaling/min should be > 0 and <= trajectory_time_scaling/max");
+    ros::shutdown();
+  }
+
   param_loader.loadParam("diagnostics/rate", _diagnostics_rate_);
   param_loader.loadParam("diagnostics/position_tracking_threshold", _diag_pos_tracking_thr_);
   param_loader.loadParam("diagnostics/orientation_tracking_threshold", _diag_heading_tracking_thr_);
+  param_loader.loadParam("diagnostics/solver_rate", _solver_diagnostics_rate_);
+
+  param_loader.loadParam("prediction_publishing/poses_rate", _prediction_poses_rate_);
+  param_loader.loadParam("prediction_publishing/full_state_rate", _prediction_full_state_rate_);
+  param_loader.loadParam("prediction_publishing/reference_rate", _mpc_reference_rate_);
 
   bool verbose_xy      = false;
   bool verbose_z       = false;
@@ -474,6 +655,16 @@ void MpcTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused]] c
   param_loader.loadParam("mpc_solver/heading/max_n_iterations", _max_iters_heading_);
   param_loader.loadParam("mpc_solver/heading/Q", heading_Q);
 
+  param_loader.loadParam("mpc_solver/coupled_xy/enabled", _coupled_xy_enabled_);
+  param_loader.loadParam("mpc_solver/coupled_xy/min_axis_ratio", _coupled_xy_min_axis_ratio_);
+  param_loader.loadParam("mpc_solver/coupled_xy/lookahead", _coupled_xy_lookahead_);
+  param_loader.loadParam("mpc_solver/coupled_xy/max_rotation_rate", _coupled_xy_max_rotation_rate_);
+
+  param_loader.loadParam("settled_fast_path/enabled", _settled_fast_path_enabled_);
+  param_loader.loadParam("settled_fast_path/position_tolerance", _settled_position_tolerance_);
+  param_loader.loadParam("settled_fast_path/heading_tolerance", _settled_heading_tolerance_);
+  param_loader.loadParam("settled_fast_path/derivative_tolerance", _settled_derivative_tolerance_);
+
   param_loader.loadParam("wiggle/enabled", drs_params_.wiggle_enabled);
   param_loader.loadParam("wiggle/amplitude", drs_params_.wiggle_amplitude);
   param_loader.loadParam("wiggle/frequency", drs_params_.wiggle_frequency);
@@ -521,6 +712,9 @@ void MpcTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused]] c
   pub_diagnostics_   = mrs_lib::PublisherHandler<mrs_msgs::MpcTrackerDiagnostics>(nh_, "diagnostics_out", 1);
   pub_status_string_ = mrs_lib::PublisherHandler<std_msgs::String>(nh_, "string_out", 1);
 
+  pub_solver_diagnostics_ = mrs_lib::PublisherHandler<mrs_uav_trackers::MpcTrackerSolverDiagnostics>(nh_, "solver_diagnostics_out", 1);
+  pub_solver_telemetry_   = mrs_lib::PublisherHandler<mrs_uav_trackers::MpcTrackerSolverTelemetry>(nh_, "solver_telemetry_out", 1);
+
   // extract the numerical name
   sscanf(_uav_name_.c_str(), "uav%d", &avoidance_this_uav_number_);
   ROS_INFO("[MpcTracker]: Numerical ID of this UAV is %d", avoidance_this_uav_number_);
@@ -568,6 +762,9 @@ void MpcTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused]] c
   // collision avoidance toggle service
   service_server_toggle_avoidance_ = nh_.advertiseService("collision_avoidance_in", &MpcTracker::callbackToggleCollisionAvoidance, this);
 
+  // trajectory time scale service
+  service_server_trajectory_time_scale_ = nh_.advertiseService("trajectory_time_scale_in", &MpcTracker::callbackTrajectoryTimeScale, this);
+
   mrs_lib::SubscribeHandlerOptions shopts;
   shopts.nh                 = nh_;
   shopts.node_name          = "MpcTracker";
@@ -609,12 +806,15 @@ void MpcTracker::initialize(const ros::NodeHandle& parent_nh, [[maybe_unused]] c
 
   // | ------------------------- timers ------------------------- |
 
-  timer_avoidance_trajectory_ = nh_.createTimer(ros::Rate(_avoidance_trajectory_rate_), &MpcTracker::timerAvoidanceTrajectory, this);
-  timer_diagnostics_          = nh_.createTimer(ros::Rate(_diagnostics_rate_), &MpcTracker::timerDiagnostics, this);
-  timer_mpc_iteration_        = nh_.createTimer(ros::Rate(_mpc_rate_), &MpcTracker::timerMPC, this);
-  timer_trajectory_tracking_  = nh_.createTimer(ros::Rate(1.0), &MpcTracker::timerTrajectoryTracking, this, false, false);
-  timer_velocity_tracking_    = nh_.createTimer(ros::Rate(30.0), &MpcTracker::timerVelocityTracking, this, false, false);
-  timer_hover_                = nh_.createTimer(ros::Rate(10.0), &MpcTracker::timerHover, this, false, false);
+  timer_avoidance_trajectory_  = nh_.createTimer(ros::Rate(_avoidance_trajectory_rate_), &MpcTracker::timerAvoidanceTrajectory, this);
+  timer_diagnostics_           = nh_.createTimer(ros::Rate(_diagnostics_rate_), &MpcTracker::timerDiagnostics, this);
+  timer_solver_diagnostics_    = nh_.createTimer(ros::Rate(_solver_diagnostics_rate_), &MpcTracker::timerSolverDiagnostics, this);
+  timer_prediction_poses_      = nh_.createTimer(ros::Rate(_prediction_poses_rate_), &MpcTracker::timerPredictionPoses, this);
+  timer_prediction_full_state_ = nh_.createTimer(ros::Rate(_prediction_full_state_rate_), &MpcTracker::timerPredictionFullState, this);
+  timer_mpc_iteration_         = nh_.createTimer(ros::Rate(_mpc_rate_), &MpcTracker::timerMPC, this);
+  timer_trajectory_tracking_   = nh_.createTimer(ros::Rate(1.0), &MpcTracker::timerTrajectoryTracking, this, false, false);
+  timer_velocity_tracking_     = nh_.createTimer(ros::Rate(30.0), &MpcTracker::timerVelocityTracking, this, false, false);
+  timer_hover_                 = nh_.createTimer(ros::Rate(10.0), &MpcTracker::timerHover, this, false, false);
 
   // | ----------------------- finish init ---------------------- |
 
@@ -798,6 +998,8 @@ void MpcTracker::deactivate(void) {
 
   toggleHover(false);
 
+  dropStandbyTrajectory();
+
   is_active_                       = false;
   trajectory_tracking_in_progress_ = false;
   model_first_iteration_           = true;
@@ -807,8 +1009,9 @@ void MpcTracker::deactivate(void) {
   {
     std::scoped_lock lock(mutex_trajectory_tracking_states_);
 
-    trajectory_tracking_idx_     = 0;
-    trajectory_tracking_sub_idx_ = 0;
+    trajectory_tracking_idx_      = 0;
+    trajectory_tracking_sub_idx_  = 0;
+    trajectory_tracking_progress_ = 0;
   }
 
   ROS_INFO("[MpcTracker]: deactivated");
@@ -906,60 +1109,60 @@ const mrs_msgs::PositionCommand::ConstPtr MpcTracker::update(const mrs_msgs::Uav
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  mrs_msgs::PositionCommand position_cmd;
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
 
   if (!mpc_computed_ || mpc_result_invalid_) {
 
     ROS_WARN_THROTTLE(0.1, "[MpcTracker]: MPC not ready, returning current odom as the command");
 
     // set the header
-    position_cmd.header.stamp    = uav_state->header.stamp;
-    position_cmd.header.frame_id = uav_state->header.frame_id;
+    position_cmd->header.stamp    = uav_state->header.stamp;
+    position_cmd->header.frame_id = uav_state->header.frame_id;
 
     // set positions from odom
-    position_cmd.position.x              = uav_state->pose.position.x;
-    position_cmd.position.y              = uav_state->pose.position.y;
-    position_cmd.position.z              = uav_state->pose.position.z;
-    position_cmd.use_position_vertical   = 1;
-    position_cmd.use_position_horizontal = 1;
+    position_cmd->position.x              = uav_state->pose.position.x;
+    position_cmd->position.y              = uav_state->pose.position.y;
+    position_cmd->position.z              = uav_state->pose.position.z;
+    position_cmd->use_position_vertical   = 1;
+    position_cmd->use_position_horizontal = 1;
 
     // set velocities from odom
-    position_cmd.velocity.x              = uav_state->velocity.linear.x;
-    position_cmd.velocity.y              = uav_state->velocity.linear.y;
-    position_cmd.velocity.z              = uav_state->velocity.linear.z;
-    position_cmd.use_velocity_vertical   = 1;
-    position_cmd.use_velocity_horizontal = 1;
+    position_cmd->velocity.x              = uav_state->velocity.linear.x;
+    position_cmd->velocity.y              = uav_state->velocity.linear.y;
+    position_cmd->velocity.z              = uav_state->velocity.linear.z;
+    position_cmd->use_velocity_vertical   = 1;
+    position_cmd->use_velocity_horizontal = 1;
 
     // set zero accelerations
-    position_cmd.acceleration.x   = 0;
-    position_cmd.acceleration.y   = 0;
-    position_cmd.acceleration.z   = 0;
-    position_cmd.use_acceleration = 1;
+    position_cmd->acceleration.x   = 0;
+    position_cmd->acceleration.y   = 0;
+    position_cmd->acceleration.z   = 0;
+    position_cmd->use_acceleration = 1;
 
     try {
-      position_cmd.heading     = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeading();
-      position_cmd.use_heading = 1;
+      position_cmd->heading     = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeading();
+      position_cmd->use_heading = 1;
     }
     catch (...) {
-      position_cmd.use_heading = 0;
+      position_cmd->use_heading = 0;
       ROS_WARN_THROTTLE(1.0, "[MpcTracker]: could not calculate the current UAV heading");
     }
 
     // set zero jerk
-    position_cmd.jerk.x = 0;
-    position_cmd.jerk.y = 0;
-    position_cmd.jerk.z = 0;
+    position_cmd->jerk.x = 0;
+    position_cmd->jerk.y = 0;
+    position_cmd->jerk.z = 0;
 
     try {
-      position_cmd.heading_rate     = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeadingRate(uav_state->velocity.angular);
-      position_cmd.use_heading_rate = 1;
+      position_cmd->heading_rate     = mrs_lib::AttitudeConverter(uav_state->pose.orientation).getHeadingRate(uav_state->velocity.angular);
+      position_cmd->use_heading_rate = 1;
     }
     catch (...) {
-      position_cmd.use_heading_rate = 0;
+      position_cmd->use_heading_rate = 0;
       ROS_WARN_THROTTLE(1.0, "[MpcTracker]: could not calculate the current UAV heading rate");
     }
 
-    return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+    return position_cmd;
   }
 
   iterateModel();
@@ -977,27 +1180,27 @@ const mrs_msgs::PositionCommand::ConstPtr MpcTracker::update(const mrs_msgs::Uav
   if (arefinite) {
 
     // set the desired states base on the result of the mpc
-    position_cmd.position.x     = mpc_x(0, 0);
-    position_cmd.velocity.x     = mpc_x(1, 0);
-    position_cmd.acceleration.x = mpc_x(2, 0);
-    position_cmd.jerk.x         = mpc_x(3, 0);
-
-    position_cmd.position.y     = mpc_x(4, 0);
-    position_cmd.velocity.y     = mpc_x(5, 0);
-    position_cmd.acceleration.y = mpc_x(6, 0);
-    position_cmd.jerk.y         = mpc_x(7, 0);
-
-    position_cmd.position.z     = mpc_x(8, 0);
-    position_cmd.velocity.z     = mpc_x(9, 0);
-    position_cmd.acceleration.z = mpc_x(10, 0);
-    position_cmd.jerk.z         = mpc_x(11, 0);
-
-    position_cmd.use_position_vertical   = 1;
-    position_cmd.use_position_horizontal = 1;
-    position_cmd.use_velocity_vertical   = 1;
-    position_cmd.use_velocity_horizontal = 1;
-    position_cmd.use_acceleration        = 1;
-    position_cmd.use_jerk                = 1;
+    position_cmd->position.x     = mpc_x(0, 0);
+    position_cmd->velocity.x     = mpc_x(1, 0);
+    position_cmd->acceleration.x = mpc_x(2, 0);
+    position_cmd->jerk.x         = mpc_x(3, 0);
+
+    position_cmd->position.y     = mpc_x(4, 0);
+    position_cmd->velocity.y     = mpc_x(5, 0);
+    position_cmd->acceleration.y = mpc_x(6, 0);
+    position_cmd->jerk.y         = mpc_x(7, 0);
+
+    position_cmd->position.z     = mpc_x(8, 0);
+    position_cmd->velocity.z     = mpc_x(9, 0);
+    position_cmd->acceleration.z = mpc_x(10, 0);
+    position_cmd->jerk.z         = mpc_x(11, 0);
+
+    position_cmd->use_position_vertical   = 1;
+    position_cmd->use_position_horizontal = 1;
+    position_cmd->use_velocity_vertical   = 1;
+    position_cmd->use_velocity_horizontal = 1;
+    position_cmd->use_acceleration        = 1;
+    position_cmd->use_jerk                = 1;
 
   } else {
 
@@ -1015,15 +1218,15 @@ const mrs_msgs::PositionCommand::ConstPtr MpcTracker::update(const mrs_msgs::Uav
 
   if (heading_finite) {
 
-    position_cmd.heading              = mpc_x_heading(0, 0);
-    position_cmd.heading_rate         = mpc_x_heading(1, 0);
-    position_cmd.heading_acceleration = mpc_x_heading(2, 0);
-    position_cmd.heading_jerk         = mpc_x_heading(3, 0);
+    position_cmd->heading              = mpc_x_heading(0, 0);
+    position_cmd->heading_rate         = mpc_x_heading(1, 0);
+    position_cmd->heading_acceleration = mpc_x_heading(2, 0);
+    position_cmd->heading_jerk         = mpc_x_heading(3, 0);
 
-    position_cmd.use_heading              = 1;
-    position_cmd.use_heading_rate         = 1;
-    position_cmd.use_heading_acceleration = 1;
-    position_cmd.use_heading_jerk         = 1;
+    position_cmd->use_heading              = 1;
+    position_cmd->use_heading_rate         = 1;
+    position_cmd->use_heading_acceleration = 1;
+    position_cmd->use_heading_jerk         = 1;
 
   } else {
 
@@ -1033,12 +1236,12 @@ const mrs_msgs::PositionCommand::ConstPtr MpcTracker::update(const mrs_msgs::Uav
   }
 
   // set the header
-  position_cmd.header.stamp    = uav_state->header.stamp;
-  position_cmd.header.frame_id = uav_state->header.frame_id;
+  position_cmd->header.stamp    = uav_state->header.stamp;
+  position_cmd->header.frame_id = uav_state->header.frame_id;
 
   // u have to return a position command
   // can set the jerk to 0
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  return position_cmd;
 }
 
 //}
@@ -1143,6 +1346,9 @@ const std_srvs::TriggerResponse::ConstPtr MpcTracker::switchOdometrySource(const
   odometry_reset_in_progress_ = true;
   mpc_result_invalid_         = true;
 
+  // the preloaded trajectory is in the old frame
+  dropStandbyTrajectory();
+
   auto x         = mrs_lib::get_mutexed(mutex_mpc_x_, mpc_x_);
   auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
@@ -1582,6 +1788,74 @@ bool MpcTracker::callbackToggleCollisionAvoidance(std_srvs::SetBool::Request& re
 
 //}
 
+/* //{ callbackTrajectoryTimeScale() */
+
+bool MpcTracker::callbackTrajectoryTimeScale(mrs_msgs::Float64Srv::Request& req, mrs_msgs::Float64Srv::Response& res) {
+
+  if (!is_initialized_) {
+
+    res.success = false;
+    res.message = "tracker not initialized";
+    return true;
+  }
+
+  if (req.value <= 0) {
+
+    res.success = false;
+    res.message = "the time scale has to be positive";
+    return true;
+  }
+
+  // the rest of the active trajectory
+  VectorXd x, y, z, heading;
+  double   trajectory_dt;
+  bool     use_heading;
+
+  {
+    std::scoped_lock lock(mutex_des_whole_trajectory_, mutex_des_trajectory_, mutex_trajectory_tracking_states_);
+
+    if (trajectory_set_) {
+
+      const int remaining = trajectory_tracking_loop_ ? trajectory_size_ : trajectory_size_ - trajectory_tracking_idx_;
+      const int first     = trajectory_tracking_loop_ ? 0 : trajectory_tracking_idx_;
+
+      x       = des_x_whole_trajectory_->segment(first, remaining);
+      y       = des_y_whole_trajectory_->segment(first, remaining);
+      z       = des_z_whole_trajectory_->segment(first, remaining);
+      heading = des_heading_whole_trajectory_->segment(first, remaining);
+    }
+
+    trajectory_dt = trajectory_dt_;
+    use_heading   = trajectory_track_heading_;
+  }
+
+  const double time_scale = boundTrajectoryTimeScale(x, y, z, heading, trajectory_dt, use_heading, req.value);
+
+  {
+    std::scoped_lock lock(mutex_trajectory_tracking_states_);
+
+    trajectory_time_scale_requested_ = req.value;
+    trajectory_time_scale_target_    = time_scale;
+  }
+
+  std::stringstream ss;
+
+  ss << std::fixed << std::setprecision(2) << "trajectory time scale set to " << time_scale;
+
+  if (fabs(time_scale - req.value) > 1e-3) {
+    ss << " (limited from " << req.value << ")";
+  }
+
+  ROS_INFO_STREAM("[MpcTracker]: " << ss.str());
+
+  res.success = true;
+  res.message = ss.str();
+
+  return true;
+}
+
+//}
+
 /* callbackWiggle() //{ */
 
 bool MpcTracker::callbackWiggle(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res) {
@@ -2042,6 +2316,54 @@ void MpcTracker::calculateMPC() {
     max_speed_y = constraints.horizontal_speed * (_avoidance_collision_horizontal_speed_coef_);
   }
 
+  // | ----- skip the solvers when settled at a stationary reference ----- |
+
+  VectorXd limits(17);
+  limits << max_speed_x, max_speed_y, max_speed_z, min_speed_z, max_acc_x, max_acc_y, max_acc_z, min_acc_z, max_jerk_x, max_jerk_y, max_jerk_z, min_jerk_z,
+      constraints.heading_speed, constraints.heading_acceleration, constraints.heading_jerk, max_snap_x, max_snap_z;
+
+  VectorXd setpoint(4);
+  setpoint << des_x_trajectory(0, 0), des_y_trajectory(0, 0), std::max(des_z_trajectory(0, 0), minimum_collison_free_altitude_), des_heading_trajectory(0, 0);
+
+  bool stationary = !trajectory_tracking_in_progress_ && !velocity_tracking_active_ && !hovering_in_progress_ && !drs_params.wiggle_enabled &&
+                    first_collision_index >= _mpc_horizon_len_ && collision_free_altitude_ <= lowest_z &&
+                    (des_x_trajectory.array() == des_x_trajectory(0, 0)).all() && (des_y_trajectory.array() == des_y_trajectory(0, 0)).all() &&
+                    (des_z_trajectory.array() == des_z_trajectory(0, 0)).all() && (des_heading_trajectory.array() == des_heading_trajectory(0, 0)).all();
+
+  if (_settled_fast_path_enabled_ && stationary && settled_setpoint_valid_ && setpoint == settled_setpoint_ && limits == settled_limits_) {
+
+    bool settled = fabs(sradians::diff(mpc_x_heading(0, 0), setpoint(3))) < _settled_heading_tolerance_ &&
+                   mpc_x_heading.block(1, 0, 3, 1).cwiseAbs().maxCoeff() < _settled_derivative_tolerance_;
+
+    for (int axis = 0; axis < 3; axis++) {
+      settled = settled && fabs(mpc_x(4 * axis, 0) - setpoint(axis)) < _settled_position_tolerance_ &&
+                mpc_x.block(4 * axis + 1, 0, 3, 1).cwiseAbs().maxCoeff() < _settled_derivative_tolerance_;
+    }
+
+    // the solution would be a zero input, the cached prediction stays valid
+    if (settled) {
+
+      {
+        std::scoped_lock lock(mutex_mpc_u_);
+
+        mpc_u_         = VectorXd::Zero(_mpc_m_states_);
+        mpc_u_heading_ = 0;
+      }
+
+      {
+        std::scoped_lock lock(mutex_solver_statistics_);
+
+        solver_statistics_.skips++;
+      }
+
+      return;
+    }
+  }
+
+  settled_setpoint_valid_ = stationary;
+  settled_setpoint_       = setpoint;
+  settled_limits_         = limits;
+
   // first control input generated by MPC
   VectorXd mpc_u         = VectorXd::Zero(_mpc_m_states_);
   double   mpc_u_heading = 0;
@@ -2108,6 +2430,40 @@ void MpcTracker::calculateMPC() {
 
   auto [des_x_filtered, des_y_filtered] = filterReferenceXY(des_x_trajectory, des_y_trajectory, max_speed_x, max_speed_y);
 
+  // | ---------- couple the horizontal limits of x and y ---------- |
+
+  // the box of the per-axis speed limits is aligned so its corner lies on the circle of the horizontal limit in the direction of the motion,
+  // thus the norm of the speed respects the constraints in any direction; the acceleration is left per axis, to keep the authority for turning
+  if (_coupled_xy_enabled_) {
+
+    // the current motion, or the near-term reference when hovering, without any the square inscribed in the circle is used
+    double target_angle = M_PI / 4.0;
+
+    const int near_idx = std::clamp(int(round((_coupled_xy_lookahead_ - _dt1_) / _dt2_)), 0, _mpc_horizon_len_ - 1);
+
+    vec2_t direction(mpc_x(1, 0), mpc_x(5, 0));
+
+    if (direction.norm() < 0.1) {
+      direction = vec2_t(des_x_filtered(near_idx, 0) - mpc_x(0, 0), des_y_filtered(near_idx, 0) - mpc_x(4, 0));
+    }
+
+    if (direction.norm() > 0.01) {
+      target_angle = atan2(fabs(direction(1)), fabs(direction(0)));
+    }
+
+    // a step in the limits would be a step in the solution
+    const double max_change = _coupled_xy_max_rotation_rate_ * _dt1_;
+
+    coupled_xy_angle_ += std::clamp(target_angle - coupled_xy_angle_, -max_change, max_change);
+
+    const double ratio_x = std::max(cos(coupled_xy_angle_), _coupled_xy_min_axis_ratio_);
+    const double ratio_y = std::max(sin(coupled_xy_angle_), _coupled_xy_min_axis_ratio_);
+
+    // the limit never drops below the current speed, the solver would start from an infeasible state
+    max_speed_x = std::max(max_speed_x * ratio_x, std::min(fabs(mpc_x(1, 0)), max_speed_x));
+    max_speed_y = std::max(max_speed_y * ratio_y, std::min(fabs(mpc_x(5, 0)), max_speed_y));
+  }
+
   // unwrap the heading reference
 
   des_heading_trajectory(0, 0) = sradians::unwrap(des_heading_trajectory(0, 0), mpc_x_heading_(0));
@@ -2190,41 +2546,46 @@ void MpcTracker::calculateMPC() {
   }
   mpc_u_heading = mpc_solver_heading_->getFirstControlInput();
 
+  // per solver: x, y, z, heading
+  std::array<bool, 4> saturated = {false, false, false, false};
+
   {
-    bool saturating = false;
 
     if (mpc_u(0) > max_snap_x * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap X: " << mpc_u(0));
-      mpc_u(0)   = max_snap_x;
-      saturating = true;
+      mpc_u(0)     = max_snap_x;
+      saturated[0] = true;
     }
     if (mpc_u(0) < -max_snap_x * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap X: " << mpc_u(0));
-      mpc_u(0)   = -max_snap_x;
-      saturating = true;
+      mpc_u(0)     = -max_snap_x;
+      saturated[0] = true;
     }
     if (mpc_u(1) > max_snap_y * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap Y: " << mpc_u(1));
-      mpc_u(1)   = max_snap_y;
-      saturating = true;
+      mpc_u(1)     = max_snap_y;
+      saturated[1] = true;
     }
     if (mpc_u(1) < -max_snap_y * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap Y: " << mpc_u(1));
-      mpc_u(1)   = -max_snap_y;
-      saturating = true;
+      mpc_u(1)     = -max_snap_y;
+      saturated[1] = true;
     }
     if (mpc_u(2) > max_snap_z * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap Z: " << mpc_u(2));
-      mpc_u(2)   = max_snap_z;
-      saturating = true;
+      mpc_u(2)     = max_snap_z;
+      saturated[2] = true;
     }
     if (mpc_u(2) < -min_snap_z * 1.01) {
       ROS_WARN_STREAM_THROTTLE(0.1, "[MpcTracker]: saturating snap Z: " << mpc_u(2));
-      mpc_u(2)   = -min_snap_z;
-      saturating = true;
+      mpc_u(2)     = -min_snap_z;
+      saturated[2] = true;
     }
 
-    if (saturating) {
+    // the heading input is not clipped, only reported
+    saturated[3] = fabs(mpc_u_heading) > constraints.heading_snap * 1.01;
+
+    if (saturated[0] || saturated[1] || saturated[2]) {
       debugPrintState(0.1);
       debugPrintMPCResult(0.1);
     }
@@ -2238,6 +2599,83 @@ void MpcTracker::calculateMPC() {
   }
 
   double mpc_solver_time = (ros::Time::now() - time_begin).toSec();
+
+  /* solver telemetry //{ */
+
+  const std::array<int, 4> iterations     = {int(iters_x), int(iters_y), int(iters_z), int(iters_heading)};
+  const std::array<int, 4> max_iterations = {_max_iters_xy_, _max_iters_xy_, _max_iters_z_, _max_iters_heading_};
+
+  {
+    std::scoped_lock lock(mutex_solver_statistics_);
+
+    solver_statistics_.solves++;
+    solver_statistics_.solver_time += mpc_solver_time;
+    solver_statistics_.max_solver_time = std::max(solver_statistics_.max_solver_time, mpc_solver_time);
+
+    for (int i = 0; i < 4; i++) {
+
+      solver_statistics_.iterations[i] += iterations[i];
+      solver_statistics_.max_iterations[i] = std::max(solver_statistics_.max_iterations[i], iterations[i]);
+
+      if (iterations[i] >= max_iterations[i]) {
+        solver_statistics_.iteration_limit_hits[i]++;
+      }
+
+      if (saturated[i]) {
+        solver_statistics_.saturations[i]++;
+      }
+    }
+  }
+
+  if (pub_solver_telemetry_.getNumSubscribers() > 0) {
+
+    mrs_uav_trackers::MpcTrackerSolverTelemetry telemetry;
+
+    telemetry.header.stamp = ros::Time::now();
+    telemetry.solver_time  = mpc_solver_time;
+
+    for (int i = 0; i < 4; i++) {
+      telemetry.iterations[i]              = iterations[i];
+      telemetry.iteration_limit_reached[i] = iterations[i] >= max_iterations[i];
+      telemetry.input_saturated[i]         = saturated[i];
+    }
+
+    // counts the predicted samples lying on the speed, acceleration or jerk limits
+    auto activeConstraints = [&](const MatrixXd& states, const int offset, const double max_speed, const double min_speed, const double max_acc,
+                                 const double min_acc, const double max_jerk, const double min_jerk) {
+      int count = 0;
+
+      for (int i = 0; i < _mpc_horizon_len_; i++) {
+
+        const double speed = states(i * _mpc_n_states_ + offset + 1);
+        const double acc   = states(i * _mpc_n_states_ + offset + 2);
+        const double jerk  = states(i * _mpc_n_states_ + offset + 3);
+
+        if (speed >= 0.99 * max_speed || speed <= -0.99 * min_speed || acc >= 0.99 * max_acc || acc <= -0.99 * min_acc || jerk >= 0.99 * max_jerk ||
+            jerk <= -0.99 * min_jerk) {
+          count++;
+        }
+      }
+
+      return count;
+    };
+
+    {
+      std::scoped_lock lock(mutex_predicted_trajectory_);
+
+      telemetry.active_constraints[0] = activeConstraints(predicted_trajectory_, 0, max_speed_x, max_speed_x, max_acc_x, max_acc_x, max_jerk_x, max_jerk_x);
+      telemetry.active_constraints[1] = activeConstraints(predicted_trajectory_, 4, max_speed_y, max_speed_y, max_acc_y, max_acc_y, max_jerk_y, max_jerk_y);
+      telemetry.active_constraints[2] = activeConstraints(predicted_trajectory_, 8, max_speed_z, min_speed_z, max_acc_z, min_acc_z, max_jerk_z, min_jerk_z);
+      telemetry.active_constraints[3] =
+          activeConstraints(predicted_heading_trajectory_, 0, constraints.heading_speed, constraints.heading_speed, constraints.heading_acceleration,
+                            constraints.heading_acceleration, constraints.heading_jerk, constraints.heading_jerk);
+    }
+
+    pub_solver_telemetry_.publish(telemetry);
+  }
+
+  //}
+
   if (mpc_solver_time > _dt1_ || iters_x > _max_iters_xy_ || iters_y > _max_iters_xy_ || iters_z > _max_iters_z_ || iters_heading > _max_iters_heading_) {
     ROS_DEBUG_STREAM_THROTTLE(1.0, "[MpcTracker]: Total MPC solver time: " << mpc_solver_time << " iters X: " << iters_x << "/" << _max_iters_xy_
                                                                            << " iters Y:  " << iters_y << "/" << _max_iters_xy_ << " iters Z: " << iters_z
@@ -2263,26 +2701,25 @@ void MpcTracker::calculateMPC() {
 
   /* publish mpc reference //{ */
 
-  {
+  if (ph_mpc_reference_debugging_.getNumSubscribers() > 0 && (ros::Time::now() - mpc_reference_last_publish_time_).toSec() >= 1.0 / _mpc_reference_rate_) {
+
+    mpc_reference_last_publish_time_ = ros::Time::now();
+
     geometry_msgs::PoseArray debug_trajectory_out;
-    debug_trajectory_out.header.stamp    = ros::Time::now();
+    debug_trajectory_out.header.stamp    = mpc_reference_last_publish_time_;
     debug_trajectory_out.header.frame_id = uav_state_.header.frame_id;
 
-    {
-      std::scoped_lock lock(mutex_predicted_trajectory_);
-
-      for (int i = 0; i < _mpc_horizon_len_; i++) {
+    debug_trajectory_out.poses.resize(_mpc_horizon_len_);
 
-        geometry_msgs::Pose new_pose;
+    for (int i = 0; i < _mpc_horizon_len_; i++) {
 
-        new_pose.position.x = des_x_filtered(i, 0);
-        new_pose.position.y = des_y_filtered(i, 0);
-        new_pose.position.z = des_z_filtered(i, 0);
+      geometry_msgs::Pose& pose = debug_trajectory_out.poses[i];
 
-        new_pose.orientation = mrs_lib::AttitudeConverter(0, 0, des_heading_trajectory(i));
+      pose.position.x = des_x_filtered(i, 0);
+      pose.position.y = des_y_filtered(i, 0);
+      pose.position.z = des_z_filtered(i, 0);
 
-        debug_trajectory_out.poses.push_back(new_pose);
-      }
+      pose.orientation = mrs_lib::AttitudeConverter(0, 0, des_heading_trajectory(i));
     }
 
     ph_mpc_reference_debugging_.publish(debug_trajectory_out);
@@ -2513,7 +2950,7 @@ void MpcTracker::iterateModel(void) {
 /* //{ loadTrajectory() */
 
 // method for setting desired trajectory
-std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::TrajectoryReference msg) {
+std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(mrs_msgs::TrajectoryReference msg) {
 
   // copy the member variables
   auto x         = mrs_lib::get_mutexed(mutex_mpc_x_, mpc_x_);
@@ -2538,10 +2975,39 @@ std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::T
 
   //}
 
+  /* upsample the sparse trajectory //{ */
+
+  if (_trajectory_upsampling_enabled_ && trajectory_dt > _trajectory_upsampling_dt_ + 1e-6 && msg.points.size() > 1) {
+
+    msg.points = upsampleTrajectory(msg.points, trajectory_dt, _trajectory_upsampling_dt_, msg.loop);
+
+    ROS_DEBUG("[MpcTracker]: trajectory upsampled from dt %.3f s to %.3f s, %d samples", trajectory_dt, _trajectory_upsampling_dt_, int(msg.points.size()));
+
+    trajectory_dt = _trajectory_upsampling_dt_;
+  }
+
+  //}
+
+  /* splice the trajectory into the tracked one //{ */
+
+  {
+    auto [merged, message] = mergeTrajectory(msg, trajectory_dt);
+
+    if (merged) {
+      return std::tuple(true, message, false);
+    }
+  }
+
+  //}
+
   int trajectory_size = msg.points.size();
 
   /* sanitize the time-ness of the trajectory //{ */
 
+  bool      staged = false;  // the trajectory will be handed over in the future
+  ros::Time switch_time;
+  ros::Time start_time = ros::Time::now();
+
   int    trajectory_sample_offset    = 0;  // how many samples in past is the trajectory
   int    trajectory_subsample_offset = 0;  // how many simulation inner loops ahead of the first valid sample
   double trajectory_time_offset      = 0;  // how much time in past in [s]
@@ -2563,10 +3029,19 @@ std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::T
       trajectory_time_offset = (ros::Time::now() - trajectory_time).toSec();
 
       // when the time offset is negative, thus in the future
-      // just say it, but use it like its from the current time
       if (trajectory_time_offset < 0.0) {
 
-        ROS_WARN_THROTTLE(1.0, "[MpcTracker]: received trajectory with timestamp in the future by %.3f s", -trajectory_time_offset);
+        if (_trajectory_handover_enabled_ && trajectory_tracking_in_progress_) {
+
+          // keep flying the current trajectory and hand over to the new one at its stamp
+          staged      = true;
+          switch_time = trajectory_time;
+
+        } else {
+
+          // just say it, but use it like its from the current time
+          ROS_WARN_THROTTLE(1.0, "[MpcTracker]: received trajectory with timestamp in the future by %.3f s", -trajectory_time_offset);
+        }
 
         trajectory_time_offset = 0.0;
       }
@@ -2578,6 +3053,8 @@ std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::T
       // calculate the offset in samples
       trajectory_sample_offset = int(floor(trajectory_time_offset / trajectory_dt));
 
+      start_time = msg.header.stamp + ros::Duration(trajectory_dt * trajectory_sample_offset);
+
       // and get the subsample offset, which will be used to initialize the interpolator
       trajectory_subsample_offset = int(floor(fmod(trajectory_time_offset, trajectory_dt) / _dt1_));
 
@@ -2640,6 +3117,49 @@ std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::T
 
   //}
 
+  /* re-time the parts of the trajectory violating the constraints //{ */
+
+  const double original_duration = (trajectory_size - 1) * trajectory_dt;
+  bool         retimed           = false;
+
+  if (_trajectory_retiming_enabled_ && got_constraints_ && trajectory_size > 3) {
+
+    auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
+
+    VectorXd time_scale = trajectoryTimeScale(des_x_whole_trajectory.topRows(trajectory_size), des_y_whole_trajectory.topRows(trajectory_size),
+                                              des_z_whole_trajectory.topRows(trajectory_size), des_heading_whole_trajectory.topRows(trajectory_size),
+                                              trajectory_dt, constraints, msg.use_heading);
+
+    if ((time_scale.array() > 1.0 + 1e-3).any()) {
+
+      auto [x, y, z, heading] =
+          retimeTrajectory(des_x_whole_trajectory.topRows(trajectory_size), des_y_whole_trajectory.topRows(trajectory_size),
+                           des_z_whole_trajectory.topRows(trajectory_size), des_heading_whole_trajectory.topRows(trajectory_size), trajectory_dt, time_scale);
+
+      trajectory_size = int(x.size());
+
+      des_x_whole_trajectory       = VectorXd::Zero(trajectory_size + _mpc_horizon_len_, 1);
+      des_y_whole_trajectory       = VectorXd::Zero(trajectory_size + _mpc_horizon_len_, 1);
+      des_z_whole_trajectory       = VectorXd::Zero(trajectory_size + _mpc_horizon_len_, 1);
+      des_heading_whole_trajectory = VectorXd::Zero(trajectory_size + _mpc_horizon_len_, 1);
+
+      des_x_whole_trajectory.topRows(trajectory_size)       = x;
+      des_y_whole_trajectory.topRows(trajectory_size)       = y;
+      des_z_whole_trajectory.topRows(trajectory_size)       = z;
+      des_heading_whole_trajectory.topRows(trajectory_size) = heading;
+
+      retimed = true;
+
+      ROS_INFO("[MpcTracker]: trajectory re-timed to satisfy the constraints, %.2f s -> %.2f s", original_duration, (trajectory_size - 1) * trajectory_dt);
+
+      if ((time_scale.array() > _trajectory_retiming_max_time_scale_ - 1e-3).any()) {
+        ROS_WARN("[MpcTracker]: the re-timing is capped at %.2fx, parts of the trajectory still violate the constraints", _trajectory_retiming_max_time_scale_);
+      }
+    }
+  }
+
+  //}
+
   /* set looping //{ */
 
   bool loop = false;
@@ -2701,176 +3221,648 @@ std::tuple<bool, std::string, bool> MpcTracker::loadTrajectory(const mrs_msgs::T
   // * des_z_whole_trajectory
   // * des_heading_whole_trajectory
 
-  /* update the global variables //{ */
+  PreparedTrajectory_t trajectory;
+
+  trajectory.x                = std::make_shared<VectorXd>(des_x_whole_trajectory);
+  trajectory.y                = std::make_shared<VectorXd>(des_y_whole_trajectory);
+  trajectory.z                = std::make_shared<VectorXd>(des_z_whole_trajectory);
+  trajectory.heading          = std::make_shared<VectorXd>(des_heading_whole_trajectory);
+  trajectory.size             = trajectory_size;
+  trajectory.dt               = trajectory_dt;
+  trajectory.subsample_offset = trajectory_subsample_offset;
+  trajectory.loop             = loop;
+  trajectory.use_heading      = msg.use_heading;
+  trajectory.fly_now          = msg.fly_now;
+  trajectory.input_id         = msg.input_id;
+  trajectory.switch_time      = switch_time;
+  trajectory.start_time       = staged ? switch_time : start_time;
+  trajectory.time_scale =
+      boundTrajectoryTimeScale(des_x_whole_trajectory.topRows(trajectory_size), des_y_whole_trajectory.topRows(trajectory_size),
+                               des_z_whole_trajectory.topRows(trajectory_size), des_heading_whole_trajectory.topRows(trajectory_size), trajectory_dt,
+                               msg.use_heading, mrs_lib::get_mutexed(mutex_trajectory_tracking_states_, trajectory_time_scale_requested_));
+
+  /* check the continuity with the current trajectory at the switch time //{ */
+
+  if (staged) {
 
-  {
-    std::scoped_lock lock(mutex_des_whole_trajectory_, mutex_des_trajectory_, mutex_trajectory_tracking_states_);
+    {
+      std::scoped_lock lock(mutex_des_whole_trajectory_, mutex_trajectory_tracking_states_);
 
-    des_whole_trajectory_id_ = msg.input_id;
+      // the current trajectory at the switch time, advanced the same way the MPC horizon is sampled from it
+      const double time_ahead = trajectory_tracking_progress_ * trajectory_dt_ +
+                                trajectory_time_scale_ * (trajectory_tracking_sub_idx_ * _dt1_ + (switch_time - ros::Time::now()).toSec());
 
-    auto mpc_x_heading = mrs_lib::get_mutexed(mutex_mpc_x_, mpc_x_heading_);
+      int first_idx  = trajectory_tracking_idx_ + int(floor(time_ahead / trajectory_dt_));
+      int second_idx = first_idx + 1;
 
-    trajectory_tracking_in_progress_ = msg.fly_now;
-    trajectory_track_heading_        = msg.use_heading;
+      const double interp_coeff = std::fmod(time_ahead / trajectory_dt_, 1.0);
 
-    // allocate the vectors
-    des_x_whole_trajectory_       = std::make_shared<VectorXd>(trajectory_size + _mpc_horizon_len_, 1);
-    des_y_whole_trajectory_       = std::make_shared<VectorXd>(trajectory_size + _mpc_horizon_len_, 1);
-    des_z_whole_trajectory_       = std::make_shared<VectorXd>(trajectory_size + _mpc_horizon_len_, 1);
-    des_heading_whole_trajectory_ = std::make_shared<VectorXd>(trajectory_size + _mpc_horizon_len_, 1);
+      if (trajectory_tracking_loop_) {
+        first_idx  = first_idx % trajectory_size_;
+        second_idx = second_idx % trajectory_size_;
+      } else {
+        first_idx  = std::min(first_idx, trajectory_size_ - 1);
+        second_idx = std::min(second_idx, trajectory_size_ - 1);
+      }
 
-    for (int i = 0; i < trajectory_size + _mpc_horizon_len_; i++) {
+      const vec3_t first((*des_x_whole_trajectory_)(first_idx), (*des_y_whole_trajectory_)(first_idx), (*des_z_whole_trajectory_)(first_idx));
+      const vec3_t second((*des_x_whole_trajectory_)(second_idx), (*des_y_whole_trajectory_)(second_idx), (*des_z_whole_trajectory_)(second_idx));
 
-      (*des_x_whole_trajectory_)(i) = des_x_whole_trajectory(i);
-      (*des_y_whole_trajectory_)(i) = des_y_whole_trajectory(i);
-      (*des_z_whole_trajectory_)(i) = des_z_whole_trajectory(i);
+      double jump = mrs_lib::geometry::dist(vec3_t(des_x_whole_trajectory(0), des_y_whole_trajectory(0), des_z_whole_trajectory(0)),
+                                            vec3_t((1 - interp_coeff) * first + interp_coeff * second));
 
-      if (trajectory_track_heading_) {
-        (*des_heading_whole_trajectory_)(i) = des_heading_whole_trajectory(i);
-      } else {
-        (*des_heading_whole_trajectory_).fill(mpc_x_heading(0, 0));
+      if (jump > _trajectory_handover_max_jump_) {
+        ss << std::fixed << std::setprecision(2) << "can not preload the trajectory, it starts " << jump
+           << " m away from the current one at the switch time (max " << _trajectory_handover_max_jump_ << " m)";
+        ROS_WARN_STREAM_THROTTLE(1.0, "[MpcTracker]: " << ss.str());
+        return std::tuple(false, ss.str(), false);
       }
     }
 
-    // if we are tracking trajectory, copy the setpoint
-    if (trajectory_tracking_in_progress_) {
+    mrs_lib::set_mutexed(mutex_standby_trajectory_, std::make_shared<PreparedTrajectory_t>(trajectory), standby_trajectory_);
 
-      toggleHover(false);  // TODO check for deadlock through mutex_des_trajectory_
+    ROS_INFO_THROTTLE(1.0, "[MpcTracker]: trajectory with length %d preloaded, switching in %.3f s", trajectory_size, (switch_time - ros::Time::now()).toSec());
 
-      /* interpolate the trajectory points and fill in the desired_trajectory vector //{ */
+  } else {
 
-      for (int i = 0; i < _mpc_horizon_len_; i++) {
+    dropStandbyTrajectory();
 
-        double first_time = _dt1_ + i * _dt2_ + trajectory_subsample_offset * _dt1_;
+    applyTrajectory(trajectory);
 
-        int first_idx  = floor(first_time / trajectory_dt);
-        int second_idx = first_idx + 1;
+    ROS_INFO_THROTTLE(1, "[MpcTracker]: finished setting trajectory with length %d", trajectory_size);
+  }
 
-        double interp_coeff = std::fmod(first_time / trajectory_dt, 1.0);
+  //}
 
-        if (trajectory_tracking_loop_) {
+  publishProcessedTrajectory(msg.header.frame_id, des_x_whole_trajectory, des_y_whole_trajectory, des_z_whole_trajectory, des_heading_whole_trajectory,
+                             trajectory_size);
 
-          if (second_idx >= trajectory_size) {
-            second_idx -= trajectory_size;
-          }
+  publishDiagnostics();
 
-          if (first_idx >= trajectory_size) {
-            first_idx -= trajectory_size;
-          }
-        } else {
+  if (staged) {
+    ss << std::fixed << std::setprecision(3) << "trajectory preloaded, switching in " << (switch_time - ros::Time::now()).toSec() << " s";
 
-          if (second_idx >= trajectory_size) {
-            second_idx = trajectory_size - 1;
-          }
+    if (retimed) {
+      ss << std::setprecision(2) << ", re-timed from " << original_duration << " s to " << (trajectory_size - 1) * trajectory_dt
+         << " s to satisfy the constraints";
+    }
 
-          if (first_idx >= trajectory_size) {
-            first_idx = trajectory_size - 1;
-          }
-        }
+    return std::tuple(true, ss.str(), retimed);
+  }
 
-        des_x_trajectory_(i, 0) = (1 - interp_coeff) * des_x_whole_trajectory(first_idx) + interp_coeff * des_x_whole_trajectory(second_idx);
-        des_y_trajectory_(i, 0) = (1 - interp_coeff) * des_y_whole_trajectory(first_idx) + interp_coeff * des_y_whole_trajectory(second_idx);
-        des_z_trajectory_(i, 0) = (1 - interp_coeff) * des_z_whole_trajectory(first_idx) + interp_coeff * des_z_whole_trajectory(second_idx);
+  if (retimed) {
+    ss << std::fixed << std::setprecision(2) << "trajectory loaded, re-timed from " << original_duration << " s to " << (trajectory_size - 1) * trajectory_dt
+       << " s to satisfy the constraints";
+    return std::tuple(true, ss.str(), true);
+  }
 
-        des_heading_trajectory_(i, 0) = sradians::interp(des_heading_whole_trajectory(first_idx), des_heading_whole_trajectory(second_idx), interp_coeff);
-      }
+  return std::tuple(true, "trajectory loaded", false);
+}
 
-      //}
-    }
+//}
 
-    trajectory_size_             = trajectory_size;
-    trajectory_tracking_idx_     = 0;
-    trajectory_tracking_sub_idx_ = trajectory_subsample_offset;
-    trajectory_set_              = true;
-    trajectory_tracking_loop_    = loop;
-    trajectory_dt_               = trajectory_dt;
-    trajectory_count_++;
+/* //{ mergeTrajectory() */
 
-    timer_trajectory_tracking_.setPeriod(ros::Duration(trajectory_dt));
-  }
+// splices the changed suffix of a trajectory overlapping the tracked one, returns false when the trajectory has to be loaded normally
+std::tuple<bool, std::string> MpcTracker::mergeTrajectory(const mrs_msgs::TrajectoryReference& msg, const double trajectory_dt) {
 
-  //}
+  if (!_trajectory_merging_enabled_ || !msg.fly_now || msg.loop || msg.header.stamp == ros::Time(0) || msg.points.size() < 2) {
+    return std::tuple(false, "");
+  }
 
-  if (trajectory_tracking_in_progress_) {
-    timer_trajectory_tracking_.start();
+  if (!trajectory_tracking_in_progress_ || mrs_lib::get_mutexed(mutex_standby_trajectory_, standby_trajectory_)) {
+    return std::tuple(false, "");
   }
 
-  ROS_INFO_THROTTLE(1, "[MpcTracker]: finished setting trajectory with length %d", trajectory_size);
+  const int new_size = msg.points.size();
 
-  /* publish the debugging topics of the post-processed trajectory //{ */
+  VectorXd new_x(new_size), new_y(new_size), new_z(new_size), new_heading(new_size);
 
-  {
+  for (int i = 0; i < new_size; i++) {
+    new_x(i)       = msg.points[i].position.x;
+    new_y(i)       = msg.points[i].position.y;
+    new_z(i)       = msg.points[i].position.z;
+    new_heading(i) = msg.points[i].heading;
+  }
 
-    geometry_msgs::PoseArray debug_trajectory_out;
-    debug_trajectory_out.header.stamp    = ros::Time::now();
-    debug_trajectory_out.header.frame_id = common_handlers_->transformer->resolveFrame(msg.header.frame_id);
+  // re-timing would break the time alignment with the tracked trajectory
+  if (_trajectory_retiming_enabled_ && got_constraints_ && new_size > 3) {
 
-    {
-      std::scoped_lock lock(mutex_des_whole_trajectory_);
+    auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
 
-      for (int i = 0; i < trajectory_size; i++) {
+    if ((trajectoryTimeScale(new_x, new_y, new_z, new_heading, trajectory_dt, constraints, msg.use_heading).array() > 1.0 + 1e-3).any()) {
+      return std::tuple(false, "");
+    }
+  }
 
-        geometry_msgs::Pose new_pose;
+  std::stringstream ss;
 
-        new_pose.position.x = (*des_x_whole_trajectory_)(i);
-        new_pose.position.y = (*des_y_whole_trajectory_)(i);
-        new_pose.position.z = (*des_z_whole_trajectory_)(i);
+  int merged_size;
 
-        new_pose.orientation = mrs_lib::AttitudeConverter(0, 0, (*des_heading_whole_trajectory_)(i));
+  {
+    std::scoped_lock lock(mutex_des_whole_trajectory_, mutex_des_trajectory_, mutex_trajectory_tracking_states_);
+
+    if (!trajectory_tracking_in_progress_ || trajectory_tracking_loop_ || fabs(trajectory_dt - trajectory_dt_) > 1e-6 ||
+        msg.use_heading != trajectory_track_heading_) {
+      return std::tuple(false, "");
+    }
 
-        debug_trajectory_out.poses.push_back(new_pose);
+    // the planners stamp the samples in real time, which holds only when the time is not scaled
+    if (fabs(trajectory_time_scale_ - 1.0) > 1e-6 || fabs(trajectory_time_scale_target_ - 1.0) > 1e-6) {
+      return std::tuple(false, "");
+    }
+
+    // the index of the first new sample in the tracked trajectory
+    const double offset = (msg.header.stamp - trajectory_start_time_).toSec() / trajectory_dt;
+    const int    m      = int(round(offset));
+
+    if (fabs(offset - m) * trajectory_dt > _dt1_ / 2.0) {
+      return std::tuple(false, "");
+    }
+
+    const int idx = trajectory_tracking_idx_;
+
+    // the samples used by the current prediction horizon are kept
+    const double horizon_time = trajectory_tracking_progress_ * trajectory_dt + _dt1_ + (_mpc_horizon_len_ - 1) * _dt2_ + trajectory_tracking_sub_idx_ * _dt1_;
+    const int    keep_end     = std::min(idx + int(floor(horizon_time / trajectory_dt)) + 2, trajectory_size_);
+
+    if (m > keep_end || m + new_size <= keep_end) {
+      return std::tuple(false, "");
+    }
+
+    // the distance between the j-th tracked sample and the k-th new sample
+    auto distance = [&](const int j, const int k) {
+      return mrs_lib::geometry::dist(vec3_t((*des_x_whole_trajectory_)(j), (*des_y_whole_trajectory_)(j), (*des_z_whole_trajectory_)(j)),
+                                     vec3_t(new_x(k), new_y(k), new_z(k)));
+    };
+
+    // whether the j-th tracked sample is unchanged by the new trajectory
+    auto unchanged = [&](const int j) {
+      return distance(j, j - m) < _trajectory_merging_tolerance_ &&
+             (!msg.use_heading || fabs(sradians::diff((*des_heading_whole_trajectory_)(j), new_heading(j - m))) < _trajectory_merging_tolerance_);
+    };
+
+    // a change within the kept part (e.g., an avoidance maneuver) can not be merged, the trajectory has to be loaded normally
+    for (int j = std::max(m, idx); j < keep_end; j++) {
+      if (!unchanged(j)) {
+        ROS_DEBUG("[MpcTracker]: can not merge the trajectory, it changes within the prediction horizon");
+        return std::tuple(false, "");
       }
     }
 
-    pub_debug_processed_trajectory_poses_.publish(debug_trajectory_out);
+    // find where the new trajectory starts to differ
+    int splice = keep_end;
+
+    while (splice < trajectory_size_ && splice - m < new_size && unchanged(splice)) {
+      splice++;
+    }
+
+    if (splice == trajectory_size_ && splice - m == new_size) {
+      return std::tuple(true, "trajectory merged, no change");
+    }
 
-    visualization_msgs::MarkerArray msg_out;
+    // the new trajectory has to continue from the kept part
+    const int    junction = std::max(splice - 1, m);
+    const double jump     = distance(std::min(junction, trajectory_size_ - 1), junction - m);
 
-    visualization_msgs::Marker marker;
+    if (jump > _trajectory_merging_max_jump_) {
+      ROS_DEBUG("[MpcTracker]: can not merge the trajectory, %.2f m jump at the junction", jump);
+      return std::tuple(false, "");
+    }
 
-    marker.header.stamp     = ros::Time::now();
-    marker.header.frame_id  = common_handlers_->transformer->resolveFrame(msg.header.frame_id);
-    marker.type             = visualization_msgs::Marker::LINE_LIST;
-    marker.color.a          = 1;
-    marker.scale.x          = 0.05;
-    marker.color.r          = 1;
-    marker.color.g          = 0;
-    marker.color.b          = 0;
-    marker.pose.orientation = mrs_lib::AttitudeConverter(0, 0, 0);
+    // the already flown samples are dropped
+    merged_size = m + new_size - idx;
 
-    {
-      std::scoped_lock lock(mutex_des_whole_trajectory_);
+    auto x       = std::make_shared<VectorXd>(merged_size + _mpc_horizon_len_);
+    auto y       = std::make_shared<VectorXd>(merged_size + _mpc_horizon_len_);
+    auto z       = std::make_shared<VectorXd>(merged_size + _mpc_horizon_len_);
+    auto heading = std::make_shared<VectorXd>(merged_size + _mpc_horizon_len_);
 
-      for (int i = 0; i < trajectory_size - 1; i++) {
+    const int kept = splice - idx;
 
-        geometry_msgs::Point point1;
+    x->head(kept)       = des_x_whole_trajectory_->segment(idx, kept);
+    y->head(kept)       = des_y_whole_trajectory_->segment(idx, kept);
+    z->head(kept)       = des_z_whole_trajectory_->segment(idx, kept);
+    heading->head(kept) = des_heading_whole_trajectory_->segment(idx, kept);
 
-        point1.x = des_x_whole_trajectory(i);
-        point1.y = des_y_whole_trajectory(i);
-        point1.z = des_z_whole_trajectory(i);
+    x->segment(kept, merged_size - kept) = new_x.tail(merged_size - kept);
+    y->segment(kept, merged_size - kept) = new_y.tail(merged_size - kept);
+    z->segment(kept, merged_size - kept) = new_z.tail(merged_size - kept);
 
-        marker.points.push_back(point1);
+    if (msg.use_heading) {
+      heading->segment(kept, merged_size - kept) = new_heading.tail(merged_size - kept);
+    } else {
+      heading->segment(kept, merged_size - kept).setConstant((*des_heading_whole_trajectory_)(idx));
+    }
 
-        geometry_msgs::Point point2;
+    // the tail
+    x->tail(_mpc_horizon_len_).setConstant((*x)(merged_size - 1));
+    y->tail(_mpc_horizon_len_).setConstant((*y)(merged_size - 1));
+    z->tail(_mpc_horizon_len_).setConstant((*z)(merged_size - 1));
+    heading->tail(_mpc_horizon_len_).setConstant((*heading)(merged_size - 1));
+
+    des_x_whole_trajectory_       = x;
+    des_y_whole_trajectory_       = y;
+    des_z_whole_trajectory_       = z;
+    des_heading_whole_trajectory_ = heading;
+    des_whole_trajectory_id_      = msg.input_id;
+
+    trajectory_size_         = merged_size;
+    trajectory_tracking_idx_ = 0;
+    trajectory_start_time_ += ros::Duration(idx * trajectory_dt);
+    trajectory_count_++;
+
+    ss << "trajectory merged, " << merged_size - kept << " samples replaced";
+  }
+
+  ROS_DEBUG_STREAM_THROTTLE(1.0, "[MpcTracker]: " << ss.str());
+
+  if (pub_debug_processed_trajectory_poses_.getNumSubscribers() > 0 || pub_debug_processed_trajectory_markers_.getNumSubscribers() > 0) {
+
+    auto [x, y, z, heading] = mrs_lib::get_mutexed(mutex_des_whole_trajectory_, des_x_whole_trajectory_, des_y_whole_trajectory_, des_z_whole_trajectory_,
+                                                   des_heading_whole_trajectory_);
+
+    publishProcessedTrajectory(msg.header.frame_id, *x, *y, *z, *heading, merged_size);
+  }
+
+  return std::tuple(true, ss.str());
+}
+
+//}
 
-        point2.x = des_x_whole_trajectory(i + 1);
-        point2.y = des_y_whole_trajectory(i + 1);
-        point2.z = des_z_whole_trajectory(i + 1);
+/* //{ applyTrajectory() */
 
-        marker.points.push_back(point2);
+// makes the prepared trajectory the active one, only swaps the buffers and refills the horizon
+void MpcTracker::applyTrajectory(const PreparedTrajectory_t& trajectory) {
+
+  auto mpc_x_heading = mrs_lib::get_mutexed(mutex_mpc_x_, mpc_x_heading_);
+
+  {
+    std::scoped_lock lock(mutex_des_whole_trajectory_, mutex_des_trajectory_, mutex_trajectory_tracking_states_);
+
+    des_whole_trajectory_id_ = trajectory.input_id;
+
+    trajectory_tracking_in_progress_ = trajectory.fly_now;
+    trajectory_track_heading_        = trajectory.use_heading;
+
+    des_x_whole_trajectory_ = trajectory.x;
+    des_y_whole_trajectory_ = trajectory.y;
+    des_z_whole_trajectory_ = trajectory.z;
+
+    if (trajectory_track_heading_) {
+      des_heading_whole_trajectory_ = trajectory.heading;
+    } else {
+      des_heading_whole_trajectory_ = std::make_shared<VectorXd>(VectorXd::Constant(trajectory.heading->size(), mpc_x_heading(0, 0)));
+    }
+
+    // if we are tracking trajectory, copy the setpoint
+    if (trajectory_tracking_in_progress_) {
+
+      toggleHover(false);  // TODO check for deadlock through mutex_des_trajectory_
+
+      /* interpolate the trajectory points and fill in the desired_trajectory vector //{ */
+
+      for (int i = 0; i < _mpc_horizon_len_; i++) {
+
+        double first_time = _dt1_ + i * _dt2_ + trajectory.subsample_offset * _dt1_;
+
+        int first_idx  = floor(first_time / trajectory.dt);
+        int second_idx = first_idx + 1;
+
+        double interp_coeff = std::fmod(first_time / trajectory.dt, 1.0);
+
+        if (trajectory.loop) {
+
+          if (second_idx >= trajectory.size) {
+            second_idx -= trajectory.size;
+          }
+
+          if (first_idx >= trajectory.size) {
+            first_idx -= trajectory.size;
+          }
+        } else {
+
+          if (second_idx >= trajectory.size) {
+            second_idx = trajectory.size - 1;
+          }
+
+          if (first_idx >= trajectory.size) {
+            first_idx = trajectory.size - 1;
+          }
+        }
+
+        des_x_trajectory_(i, 0) = (1 - interp_coeff) * (*des_x_whole_trajectory_)(first_idx) + interp_coeff * (*des_x_whole_trajectory_)(second_idx);
+        des_y_trajectory_(i, 0) = (1 - interp_coeff) * (*des_y_whole_trajectory_)(first_idx) + interp_coeff * (*des_y_whole_trajectory_)(second_idx);
+        des_z_trajectory_(i, 0) = (1 - interp_coeff) * (*des_z_whole_trajectory_)(first_idx) + interp_coeff * (*des_z_whole_trajectory_)(second_idx);
+
+        des_heading_trajectory_(i, 0) =
+            sradians::interp((*des_heading_whole_trajectory_)(first_idx), (*des_heading_whole_trajectory_)(second_idx), interp_coeff);
       }
+
+      //}
+    }
+
+    trajectory_size_             = trajectory.size;
+    trajectory_tracking_idx_     = 0;
+    trajectory_tracking_sub_idx_  = trajectory.subsample_offset;
+    trajectory_tracking_progress_ = 0;
+    trajectory_start_time_        = trajectory.start_time;
+    trajectory_set_               = true;
+    trajectory_tracking_loop_     = trajectory.loop;
+    trajectory_dt_                = trajectory.dt;
+    trajectory_time_scale_target_ = trajectory.time_scale;
+    trajectory_count_++;
+
+    timer_trajectory_tracking_.setPeriod(ros::Duration(trajectory.dt));
+  }
+
+  if (trajectory_tracking_in_progress_) {
+    timer_trajectory_tracking_.start();
+  }
+}
+
+//}
+
+/* //{ dropStandbyTrajectory() */
+
+void MpcTracker::dropStandbyTrajectory(void) {
+
+  std::scoped_lock lock(mutex_standby_trajectory_);
+
+  if (standby_trajectory_) {
+
+    standby_trajectory_.reset();
+
+    ROS_INFO("[MpcTracker]: the preloaded trajectory was dropped");
+  }
+}
+
+//}
+
+/* //{ publishProcessedTrajectory() */
+
+void MpcTracker::publishProcessedTrajectory(const std::string& frame_id, const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading,
+                                            const int size) {
+
+  geometry_msgs::PoseArray debug_trajectory_out;
+  debug_trajectory_out.header.stamp    = ros::Time::now();
+  debug_trajectory_out.header.frame_id = common_handlers_->transformer->resolveFrame(frame_id);
+
+  for (int i = 0; i < size; i++) {
+
+    geometry_msgs::Pose new_pose;
+
+    new_pose.position.x = x(i);
+    new_pose.position.y = y(i);
+    new_pose.position.z = z(i);
+
+    new_pose.orientation = mrs_lib::AttitudeConverter(0, 0, heading(i));
+
+    debug_trajectory_out.poses.push_back(new_pose);
+  }
+
+  pub_debug_processed_trajectory_poses_.publish(debug_trajectory_out);
+
+  visualization_msgs::MarkerArray msg_out;
+
+  visualization_msgs::Marker marker;
+
+  marker.header.stamp     = ros::Time::now();
+  marker.header.frame_id  = common_handlers_->transformer->resolveFrame(frame_id);
+  marker.type             = visualization_msgs::Marker::LINE_LIST;
+  marker.color.a          = 1;
+  marker.scale.x          = 0.05;
+  marker.color.r          = 1;
+  marker.color.g          = 0;
+  marker.color.b          = 0;
+  marker.pose.orientation = mrs_lib::AttitudeConverter(0, 0, 0);
+
+  for (int i = 0; i < size - 1; i++) {
+
+    geometry_msgs::Point point1;
+
+    point1.x = x(i);
+    point1.y = y(i);
+    point1.z = z(i);
+
+    marker.points.push_back(point1);
+
+    geometry_msgs::Point point2;
+
+    point2.x = x(i + 1);
+    point2.y = y(i + 1);
+    point2.z = z(i + 1);
+
+    marker.points.push_back(point2);
+  }
+
+  msg_out.markers.push_back(marker);
+
+  pub_debug_processed_trajectory_markers_.publish(msg_out);
+}
+
+//}
+
+/* //{ upsampleTrajectory() */
+
+// resamples the keyframes by cubic splines, which keeps the velocity and the acceleration continuous, periodic ones for a looped trajectory;
+// the keyframes are stretched by less than one dt in total, so that all the samples are spaced by a full dt
+std::vector<mrs_msgs::Reference> MpcTracker::upsampleTrajectory(const std::vector<mrs_msgs::Reference>& keyframes, const double keyframe_dt, const double dt,
+                                                                const bool loop) {
+
+  std::vector<mrs_msgs::Reference> knots = keyframes;
+
+  // the looped trajectory continues from the last keyframe to the first one, a repeated first keyframe would stop it there
+  if (loop && knots.size() > 2) {
+
+    const vec3_t first(knots.front().position.x, knots.front().position.y, knots.front().position.z);
+    const vec3_t last(knots.back().position.x, knots.back().position.y, knots.back().position.z);
+
+    if (mrs_lib::geometry::dist(first, last) < 1e-3) {
+      knots.pop_back();
     }
+  }
+
+  std::vector<double> x, y, z, heading;
+
+  x.reserve(knots.size());
+  y.reserve(knots.size());
+  z.reserve(knots.size());
+  heading.reserve(knots.size());
 
-    msg_out.markers.push_back(marker);
+  for (auto& knot : knots) {
 
-    pub_debug_processed_trajectory_markers_.publish(msg_out);
+    x.push_back(knot.position.x);
+    y.push_back(knot.position.y);
+    z.push_back(knot.position.z);
+
+    // the spline needs a continuous heading
+    heading.push_back(heading.empty() ? knot.heading : radians::unwrap(knot.heading, heading.back()));
   }
 
-  //}
+  // the heading of a loop may wind by multiples of 2*pi, the periodic spline interpolates it without the winding
+  double heading_winding = 0;
 
-  publishDiagnostics();
+  if (loop) {
 
-  return std::tuple(true, "trajectory loaded", false);
+    heading_winding = radians::unwrap(heading.front(), heading.back()) - heading.front();
+
+    for (size_t i = 0; i < heading.size(); i++) {
+      heading[i] -= heading_winding * i / double(heading.size());
+    }
+  }
+
+  CubicSpline spline_x(x, keyframe_dt, loop);
+  CubicSpline spline_y(y, keyframe_dt, loop);
+  CubicSpline spline_z(z, keyframe_dt, loop);
+  CubicSpline spline_heading(heading, keyframe_dt, loop);
+
+  const double duration    = spline_x.duration();
+  const int    n_intervals = std::max(int(ceil(duration / dt - 1e-6)), 1);
+  const double step        = duration / n_intervals;
+
+  // the last sample lands on the last keyframe, the loop closes by the last interval instead
+  const int n_samples = loop ? n_intervals : n_intervals + 1;
+
+  std::vector<mrs_msgs::Reference> samples(n_samples);
+
+  for (int i = 0; i < n_samples; i++) {
+
+    const double t = i * step;
+
+    samples[i].position.x = spline_x.sample(t).position;
+    samples[i].position.y = spline_y.sample(t).position;
+    samples[i].position.z = spline_z.sample(t).position;
+    samples[i].heading    = spline_heading.sample(t).position + heading_winding * t / duration;
+  }
+
+  return samples;
+}
+
+//}
+
+/* //{ trajectoryTimeScale() */
+
+// how many times each segment of the trajectory has to be slowed down to satisfy the constraints
+// the speed scales with 1/s, the acceleration with 1/s^2 and the jerk with 1/s^3
+// the finite differences amplify the noise in the samples by 2/dt, 4/dt^2 and 8/dt^3, so that much of each estimate is disregarded
+VectorXd MpcTracker::trajectoryTimeScale(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading, const double dt,
+                                         const mrs_msgs::DynamicsConstraints& constraints, const bool use_heading) {
+
+  const int n_segments = int(x.size()) - 1;
+
+  VectorXd time_scale = VectorXd::Ones(n_segments);
+
+  // the n-th finite difference spans n consecutive segments
+  auto limit = [&](const VectorXd& derivative, const int order, const double max_positive, const double max_negative) {
+
+    if (max_positive <= 0 || max_negative <= 0) {
+      return;
+    }
+
+    const double noise = _trajectory_retiming_noise_ * pow(2.0 / dt, order);
+
+    const VectorXd positive = (derivative.array() - noise).max(0.0);
+    const VectorXd negative = (-derivative.array() - noise).max(0.0);
+
+    const VectorXd ratio = (positive.array() / max_positive).max(negative.array() / max_negative).pow(1.0 / order);
+
+    for (int k = 0; k < order; k++) {
+      time_scale.segment(k, ratio.size()) = time_scale.segment(k, ratio.size()).cwiseMax(ratio);
+    }
+  };
+
+  auto limitAxis = [&](const VectorXd& velocity, const double max_speed_pos, const double max_speed_neg, const double max_acc_pos, const double max_acc_neg,
+                       const double max_jerk_pos, const double max_jerk_neg) {
+
+    const VectorXd acceleration = (velocity.tail(n_segments - 1) - velocity.head(n_segments - 1)) / dt;
+    const VectorXd jerk         = (acceleration.tail(n_segments - 2) - acceleration.head(n_segments - 2)) / dt;
+
+    limit(velocity, 1, max_speed_pos, max_speed_neg);
+    limit(acceleration, 2, max_acc_pos, max_acc_neg);
+    limit(jerk, 3, max_jerk_pos, max_jerk_neg);
+  };
+
+  const double h_speed = constraints.horizontal_speed;
+  const double h_acc   = constraints.horizontal_acceleration;
+  const double h_jerk  = constraints.horizontal_jerk;
+
+  limitAxis((x.tail(n_segments) - x.head(n_segments)) / dt, h_speed, h_speed, h_acc, h_acc, h_jerk, h_jerk);
+  limitAxis((y.tail(n_segments) - y.head(n_segments)) / dt, h_speed, h_speed, h_acc, h_acc, h_jerk, h_jerk);
+  limitAxis((z.tail(n_segments) - z.head(n_segments)) / dt, constraints.vertical_ascending_speed, constraints.vertical_descending_speed,
+            constraints.vertical_ascending_acceleration, constraints.vertical_descending_acceleration, constraints.vertical_ascending_jerk,
+            constraints.vertical_descending_jerk);
+
+  if (use_heading) {
+
+    VectorXd heading_rate(n_segments);
+
+    for (int i = 0; i < n_segments; i++) {
+      heading_rate(i) = sradians::diff(heading(i + 1), heading(i)) / dt;
+    }
+
+    limitAxis(heading_rate, constraints.heading_speed, constraints.heading_speed, constraints.heading_acceleration, constraints.heading_acceleration,
+              constraints.heading_jerk, constraints.heading_jerk);
+  }
+
+  time_scale = time_scale.cwiseMin(_trajectory_retiming_max_time_scale_);
+
+  // a step in the time scale would be a step in the velocity, so blend it in over the neighbouring segments
+  const double max_step = dt / std::max(_trajectory_retiming_blend_time_, dt);
+
+  for (int i = 1; i < n_segments; i++) {
+    time_scale(i) = std::max(time_scale(i), time_scale(i - 1) - max_step);
+  }
+
+  for (int i = n_segments - 2; i >= 0; i--) {
+    time_scale(i) = std::max(time_scale(i), time_scale(i + 1) - max_step);
+  }
+
+  return time_scale;
+}
+
+//}
+
+/* //{ retimeTrajectory() */
+
+// stretches the segments by the time scale and resamples the trajectory with the original dt
+std::tuple<VectorXd, VectorXd, VectorXd, VectorXd> MpcTracker::retimeTrajectory(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading,
+                                                                                const double dt, const VectorXd& time_scale) {
+
+  const int n_segments = int(time_scale.size());
+
+  // the new time of each of the original samples
+  VectorXd sample_time(n_segments + 1);
+
+  sample_time(0) = 0;
+
+  for (int i = 0; i < n_segments; i++) {
+    sample_time(i + 1) = sample_time(i) + dt * time_scale(i);
+  }
+
+  const int n_samples = int(ceil(sample_time(n_segments) / dt - 1e-6)) + 1;
+
+  VectorXd new_x(n_samples), new_y(n_samples), new_z(n_samples), new_heading(n_samples);
+
+  int segment = 0;
+
+  for (int i = 0; i < n_samples; i++) {
+
+    const double t = std::min(i * dt, sample_time(n_segments));
+
+    while (segment < n_segments - 1 && t > sample_time(segment + 1)) {
+      segment++;
+    }
+
+    const double interp_coeff = std::clamp((t - sample_time(segment)) / (sample_time(segment + 1) - sample_time(segment)), 0.0, 1.0);
+
+    new_x(i)       = (1 - interp_coeff) * x(segment) + interp_coeff * x(segment + 1);
+    new_y(i)       = (1 - interp_coeff) * y(segment) + interp_coeff * y(segment + 1);
+    new_z(i)       = (1 - interp_coeff) * z(segment) + interp_coeff * z(segment + 1);
+    new_heading(i) = sradians::interp(heading(segment), heading(segment + 1), interp_coeff);
+  }
+
+  return std::tuple(new_x, new_y, new_z, new_heading);
 }
 
 //}
@@ -2890,6 +3882,37 @@ void MpcTracker::setSinglePointReference(const double x, const double y, const d
 
 //}
 
+/* //{ boundTrajectoryTimeScale() */
+
+// limits the time scale so the scaled trajectory satisfies the constraints
+double MpcTracker::boundTrajectoryTimeScale(const VectorXd& x, const VectorXd& y, const VectorXd& z, const VectorXd& heading, const double dt,
+                                            const bool use_heading, const double time_scale) {
+
+  // the trajectory is flown as sampled by default
+  if (fabs(time_scale - 1.0) < 1e-6) {
+    return 1.0;
+  }
+
+  double bounded = std::clamp(time_scale, _trajectory_time_scaling_min_, _trajectory_time_scaling_max_);
+
+  if (!got_constraints_ || x.size() <= 3) {
+    return bounded;
+  }
+
+  auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
+
+  // the n-th derivative grows with the n-th power of the time scale, the needed slow down only linearly
+  const double excess = trajectoryTimeScale(x, y, z, heading, dt / bounded, constraints, use_heading).maxCoeff();
+
+  if (excess > 1.0) {
+    bounded /= excess;
+  }
+
+  return bounded;
+}
+
+//}
+
 /* //{ setGoal() */
 
 // set absolute goal
@@ -2903,6 +3926,8 @@ void MpcTracker::setGoal(const double pos_x, const double pos_y, const double po
     desired_heading = mpc_x_heading(0, 0);
   }
 
+  dropStandbyTrajectory();
+
   trajectory_tracking_in_progress_ = false;
   timer_trajectory_tracking_.stop();
 
@@ -2929,6 +3954,8 @@ void MpcTracker::setRelativeGoal(const double pos_x, const double pos_y, const d
     abs_heading += heading;
   }
 
+  dropStandbyTrajectory();
+
   trajectory_tracking_in_progress_ = false;
   timer_trajectory_tracking_.stop();
 
@@ -2981,6 +4008,8 @@ std::tuple<bool, std::string> MpcTracker::startTrajectoryTrackingImpl(void) {
       trajectory_tracking_in_progress_ = true;
       trajectory_tracking_idx_         = 0;
       trajectory_tracking_sub_idx_     = 0;
+      trajectory_tracking_progress_    = 0;
+      trajectory_start_time_           = ros::Time::now();
     }
 
     timer_trajectory_tracking_.setPeriod(ros::Duration(trajectory_dt_));
@@ -3059,6 +4088,8 @@ std::tuple<bool, std::string> MpcTracker::stopTrajectoryTrackingImpl(void) {
 
   std::stringstream ss;
 
+  dropStandbyTrajectory();
+
   if (trajectory_tracking_in_progress_) {
 
     trajectory_tracking_in_progress_ = false;
@@ -3265,6 +4296,52 @@ void MpcTracker::timerDiagnostics(const ros::TimerEvent& event) {
 
 //}
 
+/* //{ timerSolverDiagnostics() */
+
+void MpcTracker::timerSolverDiagnostics(const ros::TimerEvent& event) {
+
+  if (!is_initialized_) {
+    return;
+  }
+
+  mrs_lib::Routine    profiler_routine = profiler.createRoutine("timerSolverDiagnostics", _solver_diagnostics_rate_, 0.1, event);
+  mrs_lib::ScopeTimer timer =
+      mrs_lib::ScopeTimer("MpcTracker::timerSolverDiagnostics", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
+
+  // swapped out under a single lock, so no solve counted in between is lost
+  SolverStatistics_t statistics;
+
+  {
+    std::scoped_lock lock(mutex_solver_statistics_);
+
+    std::swap(statistics, solver_statistics_);
+  }
+
+  total_solves_ += statistics.solves;
+  total_solver_time_ += statistics.solver_time;
+
+  mrs_uav_trackers::MpcTrackerSolverDiagnostics solver_diagnostics;
+
+  solver_diagnostics.header.stamp = ros::Time::now();
+
+  solver_diagnostics.solves          = statistics.solves;
+  solver_diagnostics.skips           = statistics.skips;
+  solver_diagnostics.solver_time     = statistics.solver_time;
+  solver_diagnostics.max_solver_time = statistics.max_solver_time;
+  solver_diagnostics.saved_time      = total_solves_ > 0 ? statistics.skips * total_solver_time_ / total_solves_ : 0.0;
+
+  for (int i = 0; i < 4; i++) {
+    solver_diagnostics.mean_iterations[i]      = statistics.solves > 0 ? double(statistics.iterations[i]) / statistics.solves : 0.0;
+    solver_diagnostics.max_iterations[i]       = statistics.max_iterations[i];
+    solver_diagnostics.iteration_limit_hits[i] = statistics.iteration_limit_hits[i];
+    solver_diagnostics.saturations[i]          = statistics.saturations[i];
+  }
+
+  pub_solver_diagnostics_.publish(solver_diagnostics);
+}
+
+//}
+
 /* //{ timerMPC() */
 
 void MpcTracker::timerMPC(const ros::TimerEvent& event) {
@@ -3294,6 +4371,34 @@ void MpcTracker::timerMPC(const ros::TimerEvent& event) {
   ros::Duration interval;
   int           trajectory_id;
 
+  /* hand over to the preloaded trajectory //{ */
+
+  {
+    std::shared_ptr<PreparedTrajectory_t> standby_trajectory;
+
+    {
+      std::scoped_lock lock(mutex_standby_trajectory_);
+
+      if (standby_trajectory_ && begin >= standby_trajectory_->switch_time) {
+        standby_trajectory = std::move(standby_trajectory_);
+      }
+    }
+
+    if (standby_trajectory) {
+
+      // start from the sample matching the current time
+      int late = int(floor((begin - standby_trajectory->switch_time).toSec() / _dt1_));
+
+      standby_trajectory->subsample_offset = std::min(late, std::max(int(round(standby_trajectory->dt / _dt1_)) - 1, 0));
+
+      applyTrajectory(*standby_trajectory);
+
+      ROS_INFO("[MpcTracker]: switched to the preloaded trajectory with length %d", standby_trajectory->size);
+    }
+  }
+
+  //}
+
   // if we are tracking trajectory, copy the setpoint
   if (trajectory_tracking_in_progress_) {
 
@@ -3301,8 +4406,12 @@ void MpcTracker::timerMPC(const ros::TimerEvent& event) {
     VectorXd des_x_whole_trajectory, des_y_whole_trajectory, des_z_whole_trajectory, des_heading_whole_trajectory;
     double   trajectory_dt;
     int      trajectory_size;
+    int      trajectory_tracking_sub_idx;
+    int      trajectory_tracking_idx;
+    double   trajectory_tracking_progress;
+    double   time_scale;
     {
-      std::scoped_lock lock(mutex_des_trajectory_, mutex_des_whole_trajectory_);
+      std::scoped_lock lock(mutex_des_trajectory_, mutex_des_whole_trajectory_, mutex_trajectory_tracking_states_);
 
       des_x_trajectory       = des_x_trajectory_;
       des_y_trajectory       = des_y_trajectory_;
@@ -3318,16 +4427,25 @@ void MpcTracker::timerMPC(const ros::TimerEvent& event) {
       trajectory_dt   = trajectory_dt_;
 
       trajectory_id = des_whole_trajectory_id_;
+
+      // the indices have to match the copied trajectory, a merge re-bases them
+      trajectory_tracking_sub_idx  = trajectory_tracking_sub_idx_;
+      trajectory_tracking_idx      = trajectory_tracking_idx_;
+      trajectory_tracking_progress = trajectory_tracking_progress_;
+
+      // follow the target time scale smoothly, a step would be a step in the velocity
+      const double max_change = _trajectory_time_scaling_rate_ * _dt1_;
+
+      trajectory_time_scale_ += std::clamp(trajectory_time_scale_target_ - trajectory_time_scale_, -max_change, max_change);
+
+      time_scale = trajectory_time_scale_;
     }
 
     /* interpolate the trajectory points and fill in the desired_trajectory vector //{ */
 
-    int trajectory_tracking_sub_idx = trajectory_tracking_sub_idx_;
-    int trajectory_tracking_idx     = trajectory_tracking_idx_;
-
     for (int i = 0; i < _mpc_horizon_len_; i++) {
 
-      double first_time = _dt1_ + i * _dt2_ + trajectory_tracking_sub_idx * _dt1_;
+      double first_time = trajectory_tracking_progress * trajectory_dt + time_scale * (_dt1_ + i * _dt2_ + trajectory_tracking_sub_idx * _dt1_);
 
       int first_idx  = trajectory_tracking_idx + int(floor(first_time / trajectory_dt));
       int second_idx = first_idx + 1;
@@ -3406,120 +4524,133 @@ void MpcTracker::timerMPC(const ros::TimerEvent& event) {
 
   mpc_computed_ = true;
 
-  /* publish predicted future //{ */
-
   {
-    geometry_msgs::PoseArray debug_trajectory_out;
-    debug_trajectory_out.header.stamp    = ros::Time::now();
-    debug_trajectory_out.header.frame_id = uav_state_.header.frame_id;
+    std::scoped_lock lock(mutex_predicted_trajectory_);
 
-    {
-      std::scoped_lock lock(mutex_predicted_trajectory_);
+    predicted_trajectory_stamp_ = ros::Time::now();
+    predicted_trajectory_id_    = trajectory_id;
+  }
 
-      for (int i = 0; i < _mpc_horizon_len_; i++) {
+  if (started_with_invalid) {
+    mpc_result_invalid_ = false;
+    ROS_INFO("[MpcTracker]: calculated first MPC result after invalidation, x %.2f, y %.2f, hor1x %.2f, hor1y %.2f", mpc_x_(0, 0), mpc_x_(4, 0),
+             des_x_trajectory_(0, 0), des_y_trajectory_(0, 0));
+  }
+}
 
-        geometry_msgs::Pose newPose;
+//}
 
-        newPose.position.x = predicted_trajectory_(i * _mpc_n_states_);
-        newPose.position.y = predicted_trajectory_(i * _mpc_n_states_ + 4);
-        newPose.position.z = predicted_trajectory_(i * _mpc_n_states_ + 8);
+/* timerPredictionPoses() //{ */
 
-        newPose.orientation = mrs_lib::AttitudeConverter(0, 0, predicted_heading_trajectory_(i * _mpc_n_states_));
+void MpcTracker::timerPredictionPoses(const ros::TimerEvent& event) {
 
-        debug_trajectory_out.poses.push_back(newPose);
-      }
-    }
+  if (!is_initialized_ || !is_active_ || !mpc_computed_) {
+    return;
+  }
 
-    ph_predicted_trajectory_debugging_.publish(debug_trajectory_out);
+  if (ph_predicted_trajectory_debugging_.getNumSubscribers() == 0) {
+    return;
   }
 
-  //}
+  mrs_lib::Routine    profiler_routine = profiler.createRoutine("timerPredictionPoses", _prediction_poses_rate_, 0.01, event);
+  mrs_lib::ScopeTimer timer =
+      mrs_lib::ScopeTimer("MpcTracker::timerPredictionPoses", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
 
-  /* publish full state prediction //{ */
+  auto [predicted_trajectory, predicted_heading_trajectory, stamp] =
+      mrs_lib::get_mutexed(mutex_predicted_trajectory_, predicted_trajectory_, predicted_heading_trajectory_, predicted_trajectory_stamp_);
 
-  {
-    mrs_msgs::MpcPredictionFullState prediction_fs_out;
-    prediction_fs_out.header.stamp    = ros::Time::now();
-    prediction_fs_out.header.frame_id = uav_state_.header.frame_id;
+  geometry_msgs::PoseArray debug_trajectory_out;
+  debug_trajectory_out.header.stamp    = stamp;
+  debug_trajectory_out.header.frame_id = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_).header.frame_id;
 
-    ros::Time stamp = prediction_fs_out.header.stamp;
+  debug_trajectory_out.poses.resize(_mpc_horizon_len_);
 
-    prediction_fs_out.input_id = trajectory_id;
+  for (int i = 0; i < _mpc_horizon_len_; i++) {
 
-    {
-      std::scoped_lock lock(mutex_predicted_trajectory_);
+    geometry_msgs::Pose& pose = debug_trajectory_out.poses[i];
 
-      for (int i = 0; i < _mpc_horizon_len_; i++) {
+    pose.position.x = predicted_trajectory(i * _mpc_n_states_);
+    pose.position.y = predicted_trajectory(i * _mpc_n_states_ + 4);
+    pose.position.z = predicted_trajectory(i * _mpc_n_states_ + 8);
 
-        if (i == 0) {
-          stamp += ros::Duration(0.01);
-        } else {
-          stamp += ros::Duration(0.2);
-        }
+    pose.orientation = mrs_lib::AttitudeConverter(0, 0, predicted_heading_trajectory(i * _mpc_n_states_));
+  }
 
-        prediction_fs_out.stamps.push_back(stamp);
+  ph_predicted_trajectory_debugging_.publish(debug_trajectory_out);
+}
 
-        {  // position
-          geometry_msgs::Point point;
+//}
 
-          point.x = predicted_trajectory_(i * _mpc_n_states_);
-          point.y = predicted_trajectory_(i * _mpc_n_states_ + 4);
-          point.z = predicted_trajectory_(i * _mpc_n_states_ + 8);
+/* timerPredictionFullState() //{ */
 
-          prediction_fs_out.position.push_back(point);
-        }
+void MpcTracker::timerPredictionFullState(const ros::TimerEvent& event) {
 
-        {  // velocity
-          geometry_msgs::Vector3 vector;
+  if (!is_initialized_ || !is_active_ || !mpc_computed_) {
+    return;
+  }
 
-          vector.x = predicted_trajectory_(i * _mpc_n_states_ + 1);
-          vector.y = predicted_trajectory_(i * _mpc_n_states_ + 5);
-          vector.z = predicted_trajectory_(i * _mpc_n_states_ + 9);
+  if (ph_prediction_full_state_.getNumSubscribers() == 0) {
+    return;
+  }
 
-          prediction_fs_out.velocity.push_back(vector);
-        }
+  mrs_lib::Routine    profiler_routine = profiler.createRoutine("timerPredictionFullState", _prediction_full_state_rate_, 0.01, event);
+  mrs_lib::ScopeTimer timer =
+      mrs_lib::ScopeTimer("MpcTracker::timerPredictionFullState", common_handlers_->scope_timer.logger, common_handlers_->scope_timer.enabled);
 
-        {  // acceleration
-          geometry_msgs::Vector3 vector3;
+  // copy of the contiguous prediction buffers, the message is assembled outside of the lock
+  auto [predicted_trajectory, predicted_heading_trajectory, stamp, trajectory_id] = mrs_lib::get_mutexed(
+      mutex_predicted_trajectory_, predicted_trajectory_, predicted_heading_trajectory_, predicted_trajectory_stamp_, predicted_trajectory_id_);
 
-          vector3.x = predicted_trajectory_(i * _mpc_n_states_ + 2);
-          vector3.y = predicted_trajectory_(i * _mpc_n_states_ + 6);
-          vector3.z = predicted_trajectory_(i * _mpc_n_states_ + 10);
+  mrs_msgs::MpcPredictionFullState prediction_fs_out;
+  prediction_fs_out.header.stamp    = stamp;
+  prediction_fs_out.header.frame_id = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_).header.frame_id;
 
-          prediction_fs_out.acceleration.push_back(vector3);
-        }
+  prediction_fs_out.input_id = trajectory_id;
 
-        {  // jerk
-          geometry_msgs::Vector3 vector3;
+  prediction_fs_out.stamps.resize(_mpc_horizon_len_);
+  prediction_fs_out.position.resize(_mpc_horizon_len_);
+  prediction_fs_out.velocity.resize(_mpc_horizon_len_);
+  prediction_fs_out.acceleration.resize(_mpc_horizon_len_);
+  prediction_fs_out.jerk.resize(_mpc_horizon_len_);
+  prediction_fs_out.heading.resize(_mpc_horizon_len_);
+  prediction_fs_out.heading_rate.resize(_mpc_horizon_len_);
+  prediction_fs_out.heading_acceleration.resize(_mpc_horizon_len_);
+  prediction_fs_out.heading_jerk.resize(_mpc_horizon_len_);
 
-          vector3.x = predicted_trajectory_(i * _mpc_n_states_ + 3);
-          vector3.y = predicted_trajectory_(i * _mpc_n_states_ + 7);
-          vector3.z = predicted_trajectory_(i * _mpc_n_states_ + 11);
+  for (int i = 0; i < _mpc_horizon_len_; i++) {
 
-          prediction_fs_out.jerk.push_back(vector3);
-        }
+    // the first sample is one step of the model ahead, the rest are spaced by the horizon step
+    stamp += ros::Duration(i == 0 ? _dt1_ : _dt2_);
 
-        {
-          // heading
+    prediction_fs_out.stamps[i] = stamp;
 
-          prediction_fs_out.heading.push_back(predicted_heading_trajectory_(i * _mpc_n_states_));
-          prediction_fs_out.heading_rate.push_back(predicted_heading_trajectory_(i * _mpc_n_states_ + 1));
-          prediction_fs_out.heading_acceleration.push_back(predicted_heading_trajectory_(i * _mpc_n_states_ + 2));
-          prediction_fs_out.heading_jerk.push_back(predicted_heading_trajectory_(i * _mpc_n_states_ + 3));
-        }
-      }
-    }
+    const double* state = predicted_trajectory.data() + i * _mpc_n_states_;
 
-    ph_prediction_full_state_.publish(prediction_fs_out);
-  }
+    prediction_fs_out.position[i].x = state[0];
+    prediction_fs_out.position[i].y = state[4];
+    prediction_fs_out.position[i].z = state[8];
 
-  //}
+    prediction_fs_out.velocity[i].x = state[1];
+    prediction_fs_out.velocity[i].y = state[5];
+    prediction_fs_out.velocity[i].z = state[9];
 
-  if (started_with_invalid) {
-    mpc_result_invalid_ = false;
-    ROS_INFO("[MpcTracker]: calculated first MPC result after invalidation, x %.2f, y %.2f, hor1x %.2f, hor1y %.2f", mpc_x_(0, 0), mpc_x_(4, 0),
-             des_x_trajectory_(0, 0), des_y_trajectory_(0, 0));
+    prediction_fs_out.acceleration[i].x = state[2];
+    prediction_fs_out.acceleration[i].y = state[6];
+    prediction_fs_out.acceleration[i].z = state[10];
+
+    prediction_fs_out.jerk[i].x = state[3];
+    prediction_fs_out.jerk[i].y = state[7];
+    prediction_fs_out.jerk[i].z = state[11];
+
+    const double* heading_state = predicted_heading_trajectory.data() + i * _mpc_n_states_;
+
+    prediction_fs_out.heading[i]              = heading_state[0];
+    prediction_fs_out.heading_rate[i]         = heading_state[1];
+    prediction_fs_out.heading_acceleration[i] = heading_state[2];
+    prediction_fs_out.heading_jerk[i]         = heading_state[3];
   }
+
+  ph_prediction_full_state_.publish(prediction_fs_out);
 }
 
 //}
@@ -3544,15 +4675,24 @@ void MpcTracker::timerTrajectoryTracking(const ros::TimerEvent& event) {
     trajectory_tracking_sub_idx_ = 0;
 
     // INCREMENT THE TRACKING IDX
-    trajectory_tracking_idx_++;
+    // by the scaled time step, the fraction of a sample is carried over
+    trajectory_tracking_progress_ += trajectory_time_scale_;
+
+    const int steps = int(floor(trajectory_tracking_progress_));
+
+    trajectory_tracking_progress_ -= steps;
+    trajectory_tracking_idx_ += steps;
+
+    // keeps the samples aligned with the real time for merging the trajectories
+    trajectory_start_time_ += ros::Duration((1.0 - trajectory_time_scale_) * trajectory_dt);
 
     // if the tracking idx hits the end of the trajectory
-    if (trajectory_tracking_idx_ == trajectory_size) {
+    if (trajectory_tracking_idx_ >= trajectory_size) {
 
       if (trajectory_tracking_loop_) {
 
-        // reset the idx
-        trajectory_tracking_idx_ = 0;
+        // wrap the idx
+        trajectory_tracking_idx_ = trajectory_tracking_idx_ % trajectory_size;
 
         ROS_INFO("[MpcTracker]: trajectory looped");
 
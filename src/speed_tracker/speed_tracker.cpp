@@ -6,6 +6,9 @@
 
 #include <mrs_uav_managers/tracker.h>
 
+#include <mrs_uav_trackers/position_command_pool.h>
+#include <mrs_uav_trackers/SpeedTrackerTransformCache.h>
+
 #include <mrs_msgs/SpeedTrackerCommand.h>
 #include <mrs_msgs/VelocityReferenceSrv.h>
 
@@ -98,9 +101,8 @@ private:
 
   // | ---------------- the tracker's inner state --------------- |
 
-  bool is_initialized_  = false;
-  bool is_active_       = false;
-  bool first_iteration_ = true;
+  bool is_initialized_ = false;
+  bool is_active_      = false;
 
   double _external_command_timeout_;
 
@@ -110,8 +112,58 @@ private:
 
   // stores the post-processed and transformed command
   mrs_msgs::SpeedTrackerCommand command_;
+  ros::Time                     command_time_;
+  vec3_t                        command_velocity_rate_ = vec3_t::Zero();  // estimated from the consecutive commands
   std::mutex                    mutex_command_;
-  ros::Time                     last_command_time_;
+
+  // | ------------------- reference generator ------------------ |
+
+  // the reference is advanced in update() and follows the latest command with limited jerk,
+  // the command is extrapolated between its samples
+  vec3_t     ref_velocity_     = vec3_t::Zero();
+  vec3_t     ref_acceleration_ = vec3_t::Zero();
+  double     ref_heading_      = 0;
+  double     ref_height_       = 0;
+  ros::Time  last_update_time_;
+  std::mutex mutex_reference_;
+
+  double _prediction_max_time_;
+
+  vec3_t desiredAcceleration(const vec3_t &velocity_error, const mrs_msgs::DynamicsConstraints &constraints);
+  vec3_t limitJerk(const vec3_t &acceleration_change, const double dt, const mrs_msgs::DynamicsConstraints &constraints);
+
+  // | -------------------- transform cache --------------------- |
+
+  // the transform from the command frame is looked up once and reused for all the vectors
+  // within the command and for the commands received shortly after
+  std::optional<geometry_msgs::TransformStamped> commandTransform(const std_msgs::Header &header, const std::string &target_frame, const ros::Time &time);
+
+  geometry_msgs::TransformStamped tf_cache_;
+  std::string                     tf_cache_source_;  // the frames asked for, the transform keeps the resolved ones
+  std::string                     tf_cache_target_;
+  ros::Time                       tf_cache_time_;  // when the cached transform was looked up
+  bool                            tf_cache_valid_  = false;
+  unsigned long                   tf_cache_hits_   = 0;
+  unsigned long                   tf_cache_misses_ = 0;
+  std::mutex                      mutex_tf_cache_;
+
+  double _tf_cache_window_;
+
+  mrs_lib::PublisherHandler<mrs_uav_trackers::SpeedTrackerTransformCache> ph_tf_cache_diagnostics_;
+
+  ros::Timer timer_tf_cache_diagnostics_;
+  double     _tf_cache_diagnostics_rate_;
+  void       timerTfCacheDiagnostics(const ros::TimerEvent &event);
+
+  // | ----------------------- visualization ---------------------- |
+
+  ros::Timer timer_rviz_markers_;
+  void       timerRvizMarkers(const ros::TimerEvent &event);
+  double     _rviz_markers_rate_;
+
+  // | ------------------------- output ------------------------- |
+
+  PositionCommandPool position_cmd_pool_;
 
   // | ------------------------ profiler ------------------------ |
 
@@ -148,6 +200,10 @@ void SpeedTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
   }
 
   param_loader.loadParam("command_timeout", _external_command_timeout_);
+  param_loader.loadParam("prediction/max_time", _prediction_max_time_);
+  param_loader.loadParam("transform_cache/window", _tf_cache_window_);
+  param_loader.loadParam("transform_cache/diagnostics_rate", _tf_cache_diagnostics_rate_);
+  param_loader.loadParam("rviz_markers/rate", _rviz_markers_rate_);
 
   param_loader.loadParam("enable_profiler", _profiler_enabled_);
 
@@ -175,6 +231,14 @@ void SpeedTracker::initialize(const ros::NodeHandle &parent_nh, [[maybe_unused]]
 
   ph_rviz_marker_ = mrs_lib::PublisherHandler<visualization_msgs::MarkerArray>(nh_, "rviz_marker_out", 1);
 
+  ph_tf_cache_diagnostics_ = mrs_lib::PublisherHandler<mrs_uav_trackers::SpeedTrackerTransformCache>(nh_, "transform_cache_out", 1);
+
+  // | ------------------------- timers ------------------------- |
+
+  timer_rviz_markers_ = nh_.createTimer(ros::Rate(_rviz_markers_rate_), &SpeedTracker::timerRvizMarkers, this);
+
+  timer_tf_cache_diagnostics_ = nh_.createTimer(ros::Rate(_tf_cache_diagnostics_rate_), &SpeedTracker::timerTfCacheDiagnostics, this);
+
   // | --------------------- finish the init -------------------- |
 
   is_initialized_ = true;
@@ -211,6 +275,53 @@ std::tuple<bool, std::string> SpeedTracker::activate([[maybe_unused]] const mrs_
     return std::tuple(false, ss.str());
   }
 
+  // | ------- initialize the reference from the last command ------- |
+
+  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
+
+  {
+    std::scoped_lock lock(mutex_reference_);
+
+    ref_velocity_     = vec3_t(uav_state.velocity.linear.x, uav_state.velocity.linear.y, uav_state.velocity.linear.z);
+    ref_acceleration_ = vec3_t::Zero();
+    ref_height_       = uav_state.pose.position.z;
+
+    try {
+      ref_heading_ = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getHeading();
+    }
+    catch (...) {
+      ss << "could not calculate the UAV heading";
+      ROS_ERROR_STREAM("[SpeedTracker]: " << ss.str());
+      return std::tuple(false, ss.str());
+    }
+
+    if (last_position_cmd) {
+
+      if (last_position_cmd->use_velocity_horizontal) {
+        ref_velocity_(0) = last_position_cmd->velocity.x;
+        ref_velocity_(1) = last_position_cmd->velocity.y;
+      }
+
+      if (last_position_cmd->use_velocity_vertical) {
+        ref_velocity_(2) = last_position_cmd->velocity.z;
+      }
+
+      if (last_position_cmd->use_acceleration) {
+        ref_acceleration_ = vec3_t(last_position_cmd->acceleration.x, last_position_cmd->acceleration.y, last_position_cmd->acceleration.z);
+      }
+
+      if (last_position_cmd->use_position_vertical) {
+        ref_height_ = last_position_cmd->position.z;
+      }
+
+      if (last_position_cmd->use_heading) {
+        ref_heading_ = last_position_cmd->heading;
+      }
+    }
+
+    last_update_time_ = ros::Time::now();
+  }
+
   is_active_ = true;
 
   ss << "activated";
@@ -227,7 +338,11 @@ void SpeedTracker::deactivate(void) {
 
   is_active_ = false;
 
-  ROS_INFO("[SpeedTracker]: deactivated");
+  {
+    std::scoped_lock lock(mutex_tf_cache_);
+
+    ROS_INFO("[SpeedTracker]: deactivated, command transform cache: %lu hits, %lu misses", tf_cache_hits_, tf_cache_misses_);
+  }
 }
 
 //}
@@ -273,81 +388,162 @@ const mrs_msgs::PositionCommand::ConstPtr SpeedTracker::update(const mrs_msgs::U
     return mrs_msgs::PositionCommand::Ptr();
   }
 
+  ros::Time now = ros::Time::now();
+
   ros::Time external_command_time = sh_command_.lastMsgTime();
 
   // timeout the external command
-  if (sh_command_.hasMsg() && (ros::Time::now() - external_command_time).toSec() > _external_command_timeout_) {
+  if (sh_command_.hasMsg() && (now - external_command_time).toSec() > _external_command_timeout_) {
+
     ROS_ERROR("[SpeedTracker]: command timeouted, returning nil");
-    first_iteration_ = true;
+
+    // the reference is not advanced in the meantime, start from the UAV's motion once the commands come back
+    {
+      std::scoped_lock lock(mutex_reference_);
+
+      ref_velocity_     = vec3_t(uav_state->velocity.linear.x, uav_state->velocity.linear.y, uav_state->velocity.linear.z);
+      ref_acceleration_ = vec3_t::Zero();
+      last_update_time_ = now;
+    }
+
     return mrs_msgs::PositionCommand::Ptr();
   }
 
-  auto command = mrs_lib::get_mutexed(mutex_command_, command_);
+  auto [command, command_time, command_velocity_rate] = mrs_lib::get_mutexed(mutex_command_, command_, command_time_, command_velocity_rate_);
 
-  mrs_msgs::PositionCommand position_cmd;
+  auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
 
-  position_cmd.header.stamp    = ros::Time::now();
-  position_cmd.header.frame_id = uav_state->header.frame_id;
+  vec3_t uav_velocity(uav_state->velocity.linear.x, uav_state->velocity.linear.y, uav_state->velocity.linear.z);
 
-  position_cmd.position.x = uav_state->pose.position.x;
-  position_cmd.position.y = uav_state->pose.position.y;
+  // the commanded acceleration, if any
+  vec3_t command_acceleration = vec3_t::Zero();
 
-  if (command.use_velocity) {
-    position_cmd.velocity.x              = command.velocity.x;
-    position_cmd.velocity.y              = command.velocity.y;
-    position_cmd.velocity.z              = command.velocity.z;
-    position_cmd.use_velocity_horizontal = true;
-    position_cmd.use_velocity_vertical   = true;
-  } else {
-    position_cmd.velocity.x              = uav_state->velocity.linear.x;
-    position_cmd.velocity.y              = uav_state->velocity.linear.y;
-    position_cmd.velocity.z              = uav_state->velocity.linear.z;
-    position_cmd.use_velocity_horizontal = false;
-    position_cmd.use_velocity_vertical   = false;
+  if (command.use_acceleration) {
+    command_acceleration = vec3_t(command.acceleration.x, command.acceleration.y, command.acceleration.z);
+  } else if (command.use_force && last_attitude_cmd) {
+    command_acceleration = vec3_t(command.force.x, command.force.y, command.force.z) / last_attitude_cmd->total_mass;
   }
 
-  if (command.use_height) {
-    position_cmd.position.z            = command.height;
-    position_cmd.use_position_vertical = true;
-  } else {
-    position_cmd.position.z            = uav_state->pose.position.z;
-    position_cmd.use_position_vertical = false;
-  }
+  mrs_msgs::PositionCommand::Ptr position_cmd = position_cmd_pool_.acquire();
 
-  if (command.use_acceleration) {
-    position_cmd.acceleration.x   = command.acceleration.x;
-    position_cmd.acceleration.y   = command.acceleration.y;
-    position_cmd.acceleration.z   = command.acceleration.z;
-    position_cmd.use_acceleration = true;
-  } else if (command.use_force) {
-    position_cmd.acceleration.x   = command.force.x / last_attitude_cmd->total_mass;
-    position_cmd.acceleration.y   = command.force.y / last_attitude_cmd->total_mass;
-    position_cmd.acceleration.z   = command.force.z / last_attitude_cmd->total_mass;
-    position_cmd.use_acceleration = true;
-  } else {
-    position_cmd.acceleration.x   = 0;
-    position_cmd.acceleration.y   = 0;
-    position_cmd.acceleration.z   = 0;
-    position_cmd.use_acceleration = false;
-  }
+  {
+    std::scoped_lock lock(mutex_reference_);
 
-  if (command.use_heading) {
-    position_cmd.heading     = command.heading;
-    position_cmd.use_heading = true;
-  } else {
-    position_cmd.heading     = uav_heading;
-    position_cmd.use_heading = false;
+    double dt         = std::max((now - last_update_time_).toSec(), 0.0);
+    last_update_time_ = now;
+
+    // for how long is the command extrapolated
+    double prediction_time = std::min(std::max((now - command_time).toSec(), 0.0), _prediction_max_time_);
+
+    // | ------------------- velocity, acceleration ------------------ |
+
+    vec3_t desired_acceleration = command_acceleration;
+
+    if (command.use_velocity) {
+
+      vec3_t target_velocity(command.velocity.x, command.velocity.y, command.velocity.z);
+
+      if (command.use_acceleration) {
+        target_velocity += command_acceleration * prediction_time;
+      } else {
+        target_velocity += command_velocity_rate * prediction_time;
+      }
+
+      // saturate the extrapolated velocity
+      double horizontal_speed = target_velocity.head<2>().norm();
+
+      if (horizontal_speed > constraints.horizontal_speed) {
+        target_velocity.head<2>() *= constraints.horizontal_speed / horizontal_speed;
+      }
+
+      target_velocity(2) = std::clamp(target_velocity(2), -constraints.vertical_descending_speed, constraints.vertical_ascending_speed);
+
+      desired_acceleration += desiredAcceleration(target_velocity - ref_velocity_, constraints);
+
+    } else {
+
+      // the velocity is not controlled, follow the UAV
+      ref_velocity_ = uav_velocity;
+    }
+
+    // saturate the desired acceleration
+    double horizontal_acceleration = desired_acceleration.head<2>().norm();
+
+    if (horizontal_acceleration > constraints.horizontal_acceleration) {
+      desired_acceleration.head<2>() *= constraints.horizontal_acceleration / horizontal_acceleration;
+    }
+
+    desired_acceleration(2) =
+        std::clamp(desired_acceleration(2), -constraints.vertical_descending_acceleration, constraints.vertical_ascending_acceleration);
+
+    ref_acceleration_ += limitJerk(desired_acceleration - ref_acceleration_, dt, constraints);
+
+    if (command.use_velocity) {
+      ref_velocity_ += ref_acceleration_ * dt;
+    }
+
+    // | ------------------------- height ------------------------- |
+
+    if (command.use_height) {
+      ref_height_ += std::clamp(command.height - ref_height_, -constraints.vertical_descending_speed * dt, constraints.vertical_ascending_speed * dt);
+    } else {
+      ref_height_ = uav_state->pose.position.z;
+    }
+
+    // | ------------------------- heading ------------------------ |
+
+    if (command.use_heading) {
+
+      double target_heading = command.heading;
+
+      if (command.use_heading_rate) {
+        target_heading += command.heading_rate * prediction_time;
+      }
+
+      double max_change = constraints.heading_speed * dt;
+
+      ref_heading_ += std::clamp(sradians::diff(target_heading, ref_heading_), -max_change, max_change);
+
+    } else {
+
+      ref_heading_ = uav_heading;
+    }
+
+    // | ------------------- fill in the command ------------------ |
+
+    position_cmd->velocity.x = ref_velocity_(0);
+    position_cmd->velocity.y = ref_velocity_(1);
+    position_cmd->velocity.z = ref_velocity_(2);
+
+    position_cmd->acceleration.x = ref_acceleration_(0);
+    position_cmd->acceleration.y = ref_acceleration_(1);
+    position_cmd->acceleration.z = ref_acceleration_(2);
+
+    position_cmd->position.z = ref_height_;
+    position_cmd->heading    = radians::wrap(ref_heading_);
   }
 
+  position_cmd->header.stamp    = now;
+  position_cmd->header.frame_id = uav_state->header.frame_id;
+
+  position_cmd->position.x = uav_state->pose.position.x;
+  position_cmd->position.y = uav_state->pose.position.y;
+
+  position_cmd->use_velocity_horizontal = command.use_velocity;
+  position_cmd->use_velocity_vertical   = command.use_velocity;
+  position_cmd->use_position_vertical   = command.use_height;
+  position_cmd->use_acceleration        = command.use_velocity || command.use_acceleration || command.use_force;
+  position_cmd->use_heading             = command.use_heading;
+
   if (command.use_heading_rate) {
-    position_cmd.heading_rate     = command.heading_rate;
-    position_cmd.use_heading_rate = true;
+    position_cmd->heading_rate     = command.heading_rate;
+    position_cmd->use_heading_rate = true;
   } else {
-    position_cmd.heading_rate     = uav_state->velocity.angular.z;
-    position_cmd.use_heading_rate = false;
+    position_cmd->heading_rate     = uav_state->velocity.angular.z;
+    position_cmd->use_heading_rate = false;
   }
 
-  return mrs_msgs::PositionCommand::ConstPtr(new mrs_msgs::PositionCommand(position_cmd));
+  return position_cmd;
 }
 
 //}
@@ -398,6 +594,13 @@ const std_srvs::SetBoolResponse::ConstPtr SpeedTracker::enableCallbacks(const st
 
 const std_srvs::TriggerResponse::ConstPtr SpeedTracker::switchOdometrySource([[maybe_unused]] const mrs_msgs::UavState::ConstPtr &new_uav_state) {
 
+  // the frames are about to change
+  {
+    std::scoped_lock lock(mutex_tf_cache_);
+
+    tf_cache_valid_ = false;
+  }
+
   return std_srvs::TriggerResponse::Ptr();
 }
 
@@ -494,6 +697,89 @@ const mrs_msgs::TrajectoryReferenceSrvResponse::ConstPtr SpeedTracker::setTrajec
 
 // | --------------------- custom methods --------------------- |
 
+/* desiredAcceleration() //{ */
+
+// the acceleration which reduces the velocity error as fast as possible, while it can still
+// be brought to zero with the limited jerk without overshooting the desired velocity
+vec3_t SpeedTracker::desiredAcceleration(const vec3_t &velocity_error, const mrs_msgs::DynamicsConstraints &constraints) {
+
+  vec3_t acceleration = vec3_t::Zero();
+
+  double horizontal_error = velocity_error.head<2>().norm();
+
+  if (horizontal_error > STOP_THR) {
+    acceleration.head<2>() = velocity_error.head<2>() / horizontal_error *
+                             std::min(constraints.horizontal_acceleration, sqrt(2.0 * constraints.horizontal_jerk * horizontal_error));
+  }
+
+  double vertical_error = velocity_error(2);
+
+  if (vertical_error > STOP_THR) {
+    acceleration(2) = std::min(constraints.vertical_ascending_acceleration, sqrt(2.0 * constraints.vertical_ascending_jerk * vertical_error));
+  } else if (vertical_error < -STOP_THR) {
+    acceleration(2) = -std::min(constraints.vertical_descending_acceleration, sqrt(-2.0 * constraints.vertical_descending_jerk * vertical_error));
+  }
+
+  return acceleration;
+}
+
+//}
+
+/* limitJerk() //{ */
+
+vec3_t SpeedTracker::limitJerk(const vec3_t &acceleration_change, const double dt, const mrs_msgs::DynamicsConstraints &constraints) {
+
+  vec3_t change = acceleration_change;
+
+  double horizontal_change = change.head<2>().norm();
+
+  if (horizontal_change > constraints.horizontal_jerk * dt) {
+    change.head<2>() *= constraints.horizontal_jerk * dt / horizontal_change;
+  }
+
+  change(2) = std::clamp(change(2), -constraints.vertical_descending_jerk * dt, constraints.vertical_ascending_jerk * dt);
+
+  return change;
+}
+
+//}
+
+/* commandTransform() //{ */
+
+std::optional<geometry_msgs::TransformStamped> SpeedTracker::commandTransform(const std_msgs::Header &header, const std::string &target_frame,
+                                                                              const ros::Time &time) {
+
+  std::scoped_lock lock(mutex_tf_cache_);
+
+  // the cache expires with the time since the lookup, the stamp of the command (which may be zero) is not used as the key
+  if (tf_cache_valid_ && tf_cache_source_ == header.frame_id && tf_cache_target_ == target_frame && (time - tf_cache_time_).toSec() < _tf_cache_window_) {
+
+    tf_cache_hits_++;
+
+    return tf_cache_;
+  }
+
+  tf_cache_misses_++;
+
+  auto ret = common_handlers_->transformer->getTransform(header.frame_id, target_frame, header.stamp);
+
+  if (!ret) {
+    ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: could not find transform from '%s' to '%s'", header.frame_id.c_str(), target_frame.c_str());
+    return {};
+  }
+
+  // remember the frames we asked for, they are used as the cache key
+  tf_cache_        = ret.value();
+  tf_cache_source_ = header.frame_id;
+  tf_cache_target_ = target_frame;
+  tf_cache_time_   = time;
+  tf_cache_valid_  = true;
+
+  return tf_cache_;
+}
+
+//}
+
 /* callbackCommand() //{ */
 
 void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrackerCommand> &sh_ptr) {
@@ -506,46 +792,36 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
   mrs_msgs::SpeedTrackerCommandConstPtr external_command = sh_ptr.getMsg();
 
-  double dt;
-  if (first_iteration_) {
-
-    last_command_time_ = ros::Time::now();
-    first_iteration_   = false;
-
-    {
-      std::scoped_lock lock(mutex_command_);
-
-      command_ = *external_command;
-    }
-
-    return;
-  } else {
-    dt                 = (ros::Time::now() - last_command_time_).toSec();
-    last_command_time_ = ros::Time::now();
-
-    if (dt <= 1e-4) {
-      ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: the command dt is %.5f, returning", dt);
-      return;
-    }
-  }
+  ros::Time now = ros::Time::now();
 
   mrs_msgs::SpeedTrackerCommand transformed_command = *external_command;
 
-  auto old_command = mrs_lib::get_mutexed(mutex_command_, command_);
-  auto constraints = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
-  auto uav_state   = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
+  auto [old_command, old_command_time] = mrs_lib::get_mutexed(mutex_command_, command_, command_time_);
+  auto constraints                     = mrs_lib::get_mutexed(mutex_constraints_, constraints_);
+  auto uav_state                       = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
   double uav_heading;
 
   try {
-    uav_heading = mrs_lib::AttitudeConverter(uav_state_.pose.orientation).getHeading();
+    uav_heading = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getHeading();
   }
   catch (...) {
     ROS_ERROR_THROTTLE(1.0, "[SpeedTracker]: could not calculate UAV heading");
     return;
   }
 
-  // transform the command
+  // transform the command, the transform is shared by all its parts
+
+  std::optional<geometry_msgs::TransformStamped> tf;
+
+  if (transformed_command.use_velocity || transformed_command.use_heading || transformed_command.use_acceleration || transformed_command.use_force) {
+
+    tf = commandTransform(transformed_command.header, uav_state.header.frame_id, now);
+
+    if (!tf) {
+      return;
+    }
+  }
 
   // transform velocity
 
@@ -558,7 +834,7 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     vector3.vector.y = transformed_command.velocity.y;
     vector3.vector.z = transformed_command.velocity.z;
 
-    auto ret = common_handlers_->transformer->transformSingle(vector3, "");
+    auto ret = common_handlers_->transformer->transform(vector3, tf.value());
 
     if (ret) {
       transformed_command.velocity.x = ret.value().vector.x;
@@ -584,25 +860,6 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     //}
 
-    /* horizontal speed change rate limit //{ */
-
-    {
-      Eigen::Vector2d hor_speed_derivative =
-          Eigen::Vector2d(transformed_command.velocity.x - old_command.velocity.x, transformed_command.velocity.y - old_command.velocity.y) / dt;
-
-      // exceeding the maximum acceleration
-      if (hor_speed_derivative.norm() > constraints.horizontal_acceleration) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting speed change rate");
-        double direction = atan2(hor_speed_derivative[1], hor_speed_derivative[0]);
-
-        transformed_command.velocity.x = old_command.velocity.x + cos(direction) * constraints.horizontal_acceleration * dt;
-        transformed_command.velocity.y = old_command.velocity.y + sin(direction) * constraints.horizontal_acceleration * dt;
-      }
-    }
-
-    //}
-
     /* vertical speed limit //{ */
 
     {
@@ -621,25 +878,6 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     //}
 
-    /* vertical speed change rate //{ */
-
-    {
-
-      double vert_speed_derivative = (transformed_command.velocity.z - old_command.velocity.z) / dt;
-
-      if (vert_speed_derivative > constraints.vertical_ascending_acceleration) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting vertical ascending speed change rate");
-        transformed_command.velocity.z = old_command.velocity.z + constraints.vertical_ascending_acceleration * dt;
-
-      } else if (vert_speed_derivative < -constraints.vertical_descending_acceleration) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting vertical descending speed change rate");
-        transformed_command.velocity.z = old_command.velocity.z - constraints.vertical_descending_acceleration * dt;
-      }
-    }
-
-    //}
   }
 
   /* transform and constrain heading //{ */
@@ -651,29 +889,11 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     temp_ref.reference.heading = transformed_command.heading;
 
-    auto ret = common_handlers_->transformer->transformSingle(temp_ref, "");
+    auto ret = common_handlers_->transformer->transform(temp_ref, tf.value());
 
+    // the rate of change is limited by the reference generator
     if (ret) {
-
-      // calculate the produced heading rate
-      double des_hdg_rate = sradians::diff(ret.value().reference.heading, old_command.heading) / dt;
-
-      // saturate the change in the desired heading
-      if (des_hdg_rate > constraints.heading_speed) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting change of the desired heading using constraints");
-        transformed_command.heading = old_command.heading + constraints.heading_speed * dt;
-
-      } else if (des_hdg_rate < -constraints.heading_speed) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting change of the desired heading using constraints");
-        transformed_command.heading = old_command.heading - constraints.heading_speed * dt;
-
-      } else {
-
-        transformed_command.heading = ret.value().reference.heading;
-      }
-
+      transformed_command.heading = ret.value().reference.heading;
     } else {
       return;
     }
@@ -702,7 +922,7 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     vector3.vector.y = transformed_command.acceleration.y;
     vector3.vector.z = transformed_command.acceleration.z;
 
-    auto ret = common_handlers_->transformer->transformSingle(vector3, "");
+    auto ret = common_handlers_->transformer->transform(vector3, tf.value());
 
     if (ret) {
       transformed_command.acceleration.x = ret.value().vector.x;
@@ -728,26 +948,6 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     //}
 
-    /* horizontal acceleration change rate limit //{ */
-
-    {
-      Eigen::Vector2d hor_acc_derivative =
-          Eigen::Vector2d(transformed_command.acceleration.x - old_command.acceleration.x, transformed_command.acceleration.y - old_command.acceleration.y) /
-          (dt);
-
-      // exceeding the maximum acceleration
-      if (hor_acc_derivative.norm() > constraints.horizontal_jerk) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting acceleration change rate");
-        double direction = atan2(hor_acc_derivative[1], hor_acc_derivative[0]);
-
-        transformed_command.acceleration.x = old_command.acceleration.x + cos(direction) * constraints.horizontal_jerk * dt;
-        transformed_command.acceleration.y = old_command.acceleration.y + sin(direction) * constraints.horizontal_jerk * dt;
-      }
-    }
-
-    //}
-
     /* vertical acceleration limit //{ */
 
     {
@@ -766,25 +966,6 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     //}
 
-    /* vertical acceleration change rate //{ */
-
-    {
-
-      double vert_acc_derivative = (transformed_command.acceleration.z - old_command.acceleration.z) / dt;
-
-      if (vert_acc_derivative > constraints.vertical_ascending_jerk) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting vertical ascending acceleration change rate");
-        transformed_command.acceleration.z = old_command.acceleration.z + constraints.vertical_ascending_jerk * dt;
-
-      } else if (vert_acc_derivative < -constraints.vertical_descending_jerk) {
-
-        ROS_WARN_THROTTLE(1.0, "[SpeedTracker]: limitting vertical descending acceleration change rate");
-        transformed_command.acceleration.z = old_command.acceleration.z - constraints.vertical_descending_jerk * dt;
-      }
-    }
-
-    //}
   }
 
   // transform force
@@ -798,30 +979,19 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     vector3.vector.y = transformed_command.force.y;
     vector3.vector.z = transformed_command.force.z;
 
-    auto ret = common_handlers_->transformer->transformSingle(vector3, "");
+    auto ret = common_handlers_->transformer->transform(vector3, tf.value());
 
     if (ret) {
-      transformed_command.force.x = vector3.vector.x;
-      transformed_command.force.y = vector3.vector.y;
-      transformed_command.force.z = vector3.vector.z;
+      transformed_command.force.x = ret.value().vector.x;
+      transformed_command.force.y = ret.value().vector.y;
+      transformed_command.force.z = ret.value().vector.z;
     } else {
       return;
     }
   }
 
-  // check the feasibility of the height
+  // the rate of change of the height is limited by the reference generator
   {
-    double height_derivative = (transformed_command.height - old_command.height) / dt;
-
-    if (height_derivative > constraints.vertical_ascending_speed) {
-
-      transformed_command.height = old_command.height + constraints.vertical_ascending_speed * dt;
-
-    } else if (height_derivative < -constraints.vertical_ascending_speed) {
-
-      transformed_command.height = old_command.height - constraints.vertical_descending_speed * dt;
-    }
-
     // saturate the desired height using the safety area
     if (common_handlers_->safety_area.use_safety_area) {
 
@@ -836,34 +1006,24 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     }
   }
 
-  // if not active, nullify the desired speeds and accelerations
-  // this will produce a rumpum (using the constraints) after the activation
-  if (!is_active_) {
-
-    auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
+  // the rate of change of the commanded velocity, used for extrapolating between the commands
+  vec3_t velocity_rate = vec3_t::Zero();
 
-    transformed_command.velocity.x = 0;
-    transformed_command.velocity.y = 0;
-    transformed_command.velocity.z = 0;
+  double command_dt = (now - old_command_time).toSec();
 
-    transformed_command.acceleration.x = 0;
-    transformed_command.acceleration.y = 0;
-    transformed_command.acceleration.z = 0;
-
-    try {
-      transformed_command.heading = mrs_lib::AttitudeConverter(uav_state.pose.orientation).getHeading();
-    }
-    catch (...) {
-      return;
-    }
+  if (transformed_command.use_velocity && old_command.use_velocity && command_dt > 1e-3 && command_dt < _external_command_timeout_) {
 
-    transformed_command.height = uav_state_.pose.position.z;
+    velocity_rate = vec3_t(transformed_command.velocity.x - old_command.velocity.x, transformed_command.velocity.y - old_command.velocity.y,
+                           transformed_command.velocity.z - old_command.velocity.z) /
+                    command_dt;
   }
 
   {
     std::scoped_lock lock(mutex_command_);
 
-    command_ = transformed_command;
+    command_               = transformed_command;
+    command_time_          = now;
+    command_velocity_rate_ = velocity_rate;
   }
 
   if (!is_active_) {
@@ -871,10 +1031,60 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
   } else {
     ROS_INFO_THROTTLE(5.0, "[SpeedTracker]: getting command");
   }
+}
+
+//}
+
+// --------------------------------------------------------------
+// |                           timers                           |
+// --------------------------------------------------------------
+
+/* timerTfCacheDiagnostics() //{ */
 
-  // --------------------------------------------------------------
-  // |                     publish rviz markers                   |
-  // --------------------------------------------------------------
+void SpeedTracker::timerTfCacheDiagnostics([[maybe_unused]] const ros::TimerEvent &event) {
+
+  if (!is_initialized_) {
+    return;
+  }
+
+  if (ph_tf_cache_diagnostics_.getNumSubscribers() == 0) {
+    return;
+  }
+
+  mrs_uav_trackers::SpeedTrackerTransformCache diagnostics;
+
+  diagnostics.header.stamp = ros::Time::now();
+
+  {
+    std::scoped_lock lock(mutex_tf_cache_);
+
+    diagnostics.hits   = tf_cache_hits_;
+    diagnostics.misses = tf_cache_misses_;
+  }
+
+  ph_tf_cache_diagnostics_.publish(diagnostics);
+}
+
+//}
+
+/* timerRvizMarkers() //{ */
+
+void SpeedTracker::timerRvizMarkers([[maybe_unused]] const ros::TimerEvent &event) {
+
+  if (!is_initialized_) {
+    return;
+  }
+
+  if (ph_rviz_marker_.getNumSubscribers() == 0) {
+    return;
+  }
+
+  if (!sh_command_.hasMsg() || !got_uav_state_) {
+    return;
+  }
+
+  auto command   = mrs_lib::get_mutexed(mutex_command_, command_);
+  auto uav_state = mrs_lib::get_mutexed(mutex_uav_state_, uav_state_);
 
   visualization_msgs::MarkerArray msg_out;
 
@@ -884,13 +1094,11 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
   /* desired speed //{ */
 
-  if (transformed_command.use_velocity) {
-
-    std::scoped_lock lock(mutex_uav_state_);
+  if (command.use_velocity) {
 
     visualization_msgs::Marker marker;
 
-    marker.header.frame_id = uav_state_.header.frame_id;
+    marker.header.frame_id = uav_state.header.frame_id;
     marker.header.stamp    = ros::Time::now();
     marker.ns              = "speed_tracker";
     marker.id              = id++;
@@ -912,9 +1120,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     //}
 
     /* origin //{ */
-    point.x = uav_state_.pose.position.x;
-    point.y = uav_state_.pose.position.y;
-    point.z = uav_state_.pose.position.z;
+    point.x = uav_state.pose.position.x;
+    point.y = uav_state.pose.position.y;
+    point.z = uav_state.pose.position.z;
 
     marker.points.push_back(point);
 
@@ -922,9 +1130,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     /* tip //{ */
 
-    point.x = uav_state_.pose.position.x + transformed_command.velocity.x;
-    point.y = uav_state_.pose.position.y + transformed_command.velocity.y;
-    point.z = uav_state_.pose.position.z + transformed_command.velocity.z;
+    point.x = uav_state.pose.position.x + command.velocity.x;
+    point.y = uav_state.pose.position.y + command.velocity.y;
+    point.z = uav_state.pose.position.z + command.velocity.z;
 
     marker.points.push_back(point);
 
@@ -947,13 +1155,11 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
   //}
 
   /* desired acceleration //{ */
-  if (transformed_command.use_acceleration) {
-
-    std::scoped_lock lock(mutex_uav_state_);
+  if (command.use_acceleration) {
 
     visualization_msgs::Marker marker;
 
-    marker.header.frame_id = uav_state_.header.frame_id;
+    marker.header.frame_id = uav_state.header.frame_id;
     marker.header.stamp    = ros::Time::now();
     marker.ns              = "speed_tracker";
     marker.id              = id++;
@@ -975,9 +1181,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     //}
 
     /* origin //{ */
-    point.x = uav_state_.pose.position.x;
-    point.y = uav_state_.pose.position.y;
-    point.z = uav_state_.pose.position.z;
+    point.x = uav_state.pose.position.x;
+    point.y = uav_state.pose.position.y;
+    point.z = uav_state.pose.position.z;
 
     marker.points.push_back(point);
 
@@ -985,9 +1191,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     /* tip //{ */
 
-    point.x = uav_state_.pose.position.x + transformed_command.acceleration.x;
-    point.y = uav_state_.pose.position.y + transformed_command.acceleration.y;
-    point.z = uav_state_.pose.position.z + transformed_command.acceleration.z;
+    point.x = uav_state.pose.position.x + command.acceleration.x;
+    point.y = uav_state.pose.position.y + command.acceleration.y;
+    point.z = uav_state.pose.position.z + command.acceleration.z;
 
     marker.points.push_back(point);
 
@@ -1010,13 +1216,11 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
   //}
 
   /* desired force //{ */
-  if (transformed_command.use_force) {
-
-    std::scoped_lock lock(mutex_uav_state_);
+  if (command.use_force) {
 
     visualization_msgs::Marker marker;
 
-    marker.header.frame_id = uav_state_.header.frame_id;
+    marker.header.frame_id = uav_state.header.frame_id;
     marker.header.stamp    = ros::Time::now();
     marker.ns              = "speed_tracker";
     marker.id              = id++;
@@ -1038,9 +1242,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
     //}
 
     /* origin //{ */
-    point.x = uav_state_.pose.position.x;
-    point.y = uav_state_.pose.position.y;
-    point.z = uav_state_.pose.position.z;
+    point.x = uav_state.pose.position.x;
+    point.y = uav_state.pose.position.y;
+    point.z = uav_state.pose.position.z;
 
     marker.points.push_back(point);
 
@@ -1048,9 +1252,9 @@ void SpeedTracker::callbackCommand(mrs_lib::SubscribeHandler<mrs_msgs::SpeedTrac
 
     /* tip //{ */
 
-    point.x = uav_state_.pose.position.x + transformed_command.force.x;
-    point.y = uav_state_.pose.position.y + transformed_command.force.y;
-    point.z = uav_state_.pose.position.z + transformed_command.force.z;
+    point.x = uav_state.pose.position.x + command.force.x;
+    point.y = uav_state.pose.position.y + command.force.y;
+    point.z = uav_state.pose.position.z + command.force.z;
 
     marker.points.push_back(point);
 